@@ -0,0 +1,58 @@
+package com.soundvision.audio_encoder
+
+import android.media.MediaExtractor
+import android.media.MediaFormat
+import androidx.test.core.app.ActivityScenario
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Assume.assumeTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+import java.io.File
+
+/**
+ * libfdk_aac profiles on the FFmpeg backend, on a build made with -PffmpegSource and -PfdkAac.
+ */
+@RunWith(AndroidJUnit4::class)
+class AacProfileTest {
+
+    // encodes the bundled input into `name` and returns the object type of its AudioSpecificConfig.
+    private fun encodeObjectType(name: String, options: String): Int {
+        lateinit var activity: MainActivity
+        ActivityScenario.launch(MainActivity::class.java).use { scenario ->
+            scenario.onActivity { activity = it }
+            val file = File(activity.cacheDir, name)
+            file.delete()
+            assertEquals(0, activity.nativeEncode(activity.assets, file.path, options))
+
+            val extractor = MediaExtractor()
+            try {
+                extractor.setDataSource(file.path)
+                assertEquals(1, extractor.trackCount)
+                val format = extractor.getTrackFormat(0)
+                assertEquals(MediaFormat.MIMETYPE_AUDIO_AAC, format.getString(MediaFormat.KEY_MIME))
+                val asc = format.getByteBuffer("csd-0")!!
+                // 5 bits, 31 escapes to 32 + the next 6.
+                val bits = ((asc.get(0).toInt() and 0xFF) shl 8) or (asc.get(1).toInt() and 0xFF)
+                val type = bits shr 11
+                return if (type == 31) 32 + ((bits shr 5) and 0x3F) else type
+            } finally {
+                extractor.release()
+                file.delete()
+            }
+        }
+    }
+
+    @Test
+    fun eldOpensIntoM4a() {
+        assumeTrue(BuildConfig.FDK_AAC)
+        // ELD (39) can only be signalled out of band, the encoder has to be opened with a global header.
+        assertEquals(39, encodeObjectType("eld.m4a", "profile=eld:bitrate=64000"))
+    }
+
+    @Test
+    fun autoPicksEldForLowLatencyM4a() {
+        assumeTrue(BuildConfig.FDK_AAC)
+        assertEquals(39, encodeObjectType("auto.m4a", "latency=20:bitrate=64000"))
+    }
+}
@@ -0,0 +1,101 @@
+#include "aac_profile.h"
+#include "base.h"
+
+#include <string.h>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/error.h"
+}
+
+// algorithmic delay of each object type, rounded up (ms).
+#define LC_DELAY_MS 50
+#define SBR_DELAY_MS 130
+
+// auto thresholds in b/s.
+#define HE_V2_MAX_BIT_RATE 40000
+#define HE_MAX_BIT_RATE_PER_CHANNEL 32000
+
+static const struct {
+  const char *option;
+  const char *name;
+  int profile;
+} profiles[] = {
+    {"lc", "LC", FF_PROFILE_AAC_LOW},
+    {"he", "HE-AAC", FF_PROFILE_AAC_HE},
+    {"hev2", "HE-AAC v2", FF_PROFILE_AAC_HE_V2},
+    {"ld", "AAC-LD", FF_PROFILE_AAC_LD},
+    {"eld", "AAC-ELD", FF_PROFILE_AAC_ELD},
+};
+
+const char *aac_profile_name(int profile) {
+  for (const auto &p : profiles) {
+    if (p.profile == profile) {
+      return p.name;
+    }
+  }
+  return "unknown";
+}
+
+static bool low_delay(int profile) {
+  return profile == FF_PROFILE_AAC_LD || profile == FF_PROFILE_AAC_ELD;
+}
+
+static int auto_profile(int64_t bit_rate, int channels, int latency_ms, bool adts, bool have_fdk) {
+  if (!have_fdk) {
+    if (latency_ms > 0 && latency_ms < LC_DELAY_MS) {
+      LOGW("aac: no libfdk_aac for a %d ms latency budget, LC it is (~%d ms).", latency_ms, LC_DELAY_MS);
+    }
+    return FF_PROFILE_AAC_LOW;
+  }
+  if (latency_ms > 0 && latency_ms < LC_DELAY_MS) {
+    if (!adts) {
+      return FF_PROFILE_AAC_ELD;
+    }
+    LOGW("aac: ADTS can't carry AAC-ELD, LC it is (~%d ms), use an .m4a output for low delay.", LC_DELAY_MS);
+    return FF_PROFILE_AAC_LOW;
+  }
+  int profile = FF_PROFILE_AAC_LOW;
+  if (channels == 2 && bit_rate <= HE_V2_MAX_BIT_RATE) {
+    profile = FF_PROFILE_AAC_HE_V2;
+  } else if (bit_rate <= HE_MAX_BIT_RATE_PER_CHANNEL * (int64_t)channels) {
+    profile = FF_PROFILE_AAC_HE;
+  }
+  if (profile != FF_PROFILE_AAC_LOW && latency_ms > 0 && latency_ms < SBR_DELAY_MS) {
+    profile = FF_PROFILE_AAC_LOW;
+  }
+  return profile;
+}
+
+int select_aac_profile(const char *requested, int64_t bit_rate, int channels, int latency_ms, bool adts,
+                       bool have_fdk) {
+  int profile = -1;
+  if (!strcmp(requested, "auto")) {
+    profile = auto_profile(bit_rate, channels, latency_ms, adts, have_fdk);
+    LOGI("aac: %s for %lld b/s, %d channel(s), latency budget %d ms", aac_profile_name(profile),
+         (long long)bit_rate, channels, latency_ms);
+    return profile;
+  }
+  for (const auto &p : profiles) {
+    if (!strcmp(p.option, requested)) {
+      profile = p.profile;
+    }
+  }
+  if (profile < 0) {
+    LOGE("aac profile must be auto, lc, he, hev2, ld or eld, got %s", requested);
+    return AVERROR(EINVAL);
+  }
+  if (profile != FF_PROFILE_AAC_LOW && !have_fdk) {
+    LOGE("aac: %s needs libfdk_aac, this FFmpeg build only has the LC encoder", aac_profile_name(profile));
+    return AVERROR_ENCODER_NOT_FOUND;
+  }
+  if (profile == FF_PROFILE_AAC_HE_V2 && channels != 2) {
+    LOGE("aac: HE-AAC v2 is parametric stereo, it needs a stereo input");
+    return AVERROR(EINVAL);
+  }
+  if (low_delay(profile) && adts) {
+    LOGE("aac: ADTS can't carry %s, write an .m4a instead", aac_profile_name(profile));
+    return AVERROR(EINVAL);
+  }
+  return profile;
+}
@@ -0,0 +1,28 @@
+#ifndef AUDIO_ENCODER_AAC_PROFILE_H
+#define AUDIO_ENCODER_AAC_PROFILE_H
+
+#include <stdint.h>
+
+/**
+ * Picks the AAC object type for an encode, returns an FF_PROFILE_AAC_* value or
+ * a negative AVERROR when the requested profile can't be produced.
+ *
+ * `requested` is the "profile" option: lc, he, hev2, ld, eld or auto. auto goes
+ * by the budget, roughly where each tool stops paying for itself:
+ *   - a latency budget under the LC delay (~50 ms): ELD, the only profile
+ *     with a low delay filterbank that still scales down in bitrate;
+ *   - stereo up to 40 kb/s: HE-AAC v2, parametric stereo on an HE-AAC core;
+ *   - up to 32 kb/s per channel: HE-AAC, SBR on a half rate LC core;
+ *   - LC otherwise, and for SBR profiles whose ~130 ms delay is over budget.
+ *
+ * Everything but LC needs libfdk_aac or MediaCodec (`have_fdk`), auto falls
+ * back to LC without them. ADTS can't signal the low delay object types, LD / ELD need an
+ * MP4 container (`adts` false).
+ */
+int select_aac_profile(const char *requested, int64_t bit_rate, int channels, int latency_ms, bool adts,
+                       bool have_fdk);
+
+/** "LC", "HE-AAC v2", ... for logs. */
+const char *aac_profile_name(int profile);
+
+#endif //AUDIO_ENCODER_AAC_PROFILE_H
@@ -0,0 +1,251 @@
+#include "adts.h"
+#include "base.h"
+
+#include <string.h>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// sampling_frequency_index, ISO 14496-3 table 1.18.
+static const int sample_rates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350,
+};
+
+#define AOT_AAC_MAIN 1
+#define AOT_AAC_LTP 4
+#define AOT_SBR 5
+#define AOT_PS 29
+
+namespace {
+
+// MSB first reader over the config bytes, reads past the end return zeros and set `overrun`.
+struct BitReader {
+  const uint8_t *data;
+  int size;
+  int pos = 0;
+  bool overrun = false;
+
+  BitReader(const uint8_t *d, int s) : data(d), size(s) {}
+
+  uint32_t read(int bits) {
+    uint32_t v = 0;
+    for (int i = 0; i < bits; i++, pos++) {
+      int byte = pos >> 3;
+      if (byte >= size) {
+        overrun = true;
+        v <<= 1;
+        continue;
+      }
+      v = (v << 1) | ((data[byte] >> (7 - (pos & 7))) & 1);
+    }
+    return v;
+  }
+};
+
+}
+
+static int read_object_type(BitReader &br) {
+  int aot = (int)br.read(5);
+  return aot == 31 ? 32 + (int)br.read(6) : aot;
+}
+
+// an explicit frequency (index 15) is mapped back to its index when it has one.
+static int read_sample_rate_index(BitReader &br) {
+  int index = (int)br.read(4);
+  if (index != 15) {
+    return index;
+  }
+  int rate = (int)br.read(24);
+  for (int i = 0; i < (int)(sizeof(sample_rates) / sizeof(sample_rates[0])); i++) {
+    if (sample_rates[i] == rate) {
+      return i;
+    }
+  }
+  LOGE("adts: sample rate %d has no ADTS code", rate);
+  return -1;
+}
+
+int adts_config_from_asc(const uint8_t *asc, int size, AdtsConfig *out) {
+  BitReader br(asc, size);
+  int aot = read_object_type(br);
+  int index = read_sample_rate_index(br);
+  int channel_config = (int)br.read(4);
+  if (aot == AOT_SBR || aot == AOT_PS) {
+    // the extension (output) rate, then the core object type; `index` already is the core rate.
+    read_sample_rate_index(br);
+    aot = read_object_type(br);
+  }
+  if (br.overrun || size < 2) {
+    LOGE("adts: truncated AudioSpecificConfig (%d bytes)", size);
+    return -1;
+  }
+  if (index < 0 || index >= (int)(sizeof(sample_rates) / sizeof(sample_rates[0]))) {
+    LOGE("adts: bad sampling frequency index %d", index);
+    return -1;
+  }
+  if (aot < AOT_AAC_MAIN || aot > AOT_AAC_LTP) {
+    LOGE("adts: object type %d can't be carried in ADTS", aot);
+    return -1;
+  }
+  if (channel_config < 1 || channel_config > 7) {
+    LOGE("adts: channel configuration %d isn't supported", channel_config);
+    return -1;
+  }
+  out->object_type = aot;
+  out->sample_rate_index = index;
+  out->channel_config = channel_config;
+  return 0;
+}
+
+int adts_config_make(int object_type, int sample_rate, int channels, AdtsConfig *out) {
+  if (object_type < AOT_AAC_MAIN || object_type > AOT_AAC_LTP) {
+    LOGE("adts: object type %d can't be carried in ADTS", object_type);
+    return -1;
+  }
+  int index = -1;
+  for (int i = 0; i < (int)(sizeof(sample_rates) / sizeof(sample_rates[0])); i++) {
+    if (sample_rates[i] == sample_rate) {
+      index = i;
+    }
+  }
+  if (index < 0) {
+    LOGE("adts: sample rate %d has no ADTS code", sample_rate);
+    return -1;
+  }
+  // configurations 1..6 are 1..6 channels, 7 is 7.1.
+  if (channels < 1 || channels > 8 || channels == 7) {
+    LOGE("adts: %d channels have no channel configuration", channels);
+    return -1;
+  }
+  out->object_type = object_type;
+  out->sample_rate_index = index;
+  out->channel_config = channels == 8 ? 7 : channels;
+  return 0;
+}
+
+// 0xFF then 0xF0 / 0xF1 / 0xF8 / 0xF9: 12 bit sync, any ID, layer 0, either protection.
+static inline bool is_sync(const uint8_t *p) {
+  return p[0] == 0xFF && (p[1] & 0xF6) == 0xF0;
+}
+
+int adts_parse_header(const uint8_t *data, int64_t size, AdtsHeader *out) {
+  if (size < ADTS_HEADER_SIZE || !is_sync(data)) {
+    return -1;
+  }
+  const int index = (data[2] >> 2) & 0xF;
+  if (index >= (int)(sizeof(sample_rates) / sizeof(sample_rates[0]))) {
+    return -1;
+  }
+  const int header_size = (data[1] & 1) ? ADTS_HEADER_SIZE : ADTS_HEADER_SIZE + 2;
+  const int frame_length = ((data[3] & 3) << 11) | (data[4] << 3) | (data[5] >> 5);
+  if (frame_length <= header_size || frame_length > size) {
+    return -1;
+  }
+  out->object_type = (data[2] >> 6) + 1;
+  out->sample_rate = sample_rates[index];
+  out->channel_config = ((data[2] & 1) << 2) | (data[3] >> 6);
+  out->frame_length = frame_length;
+  out->header_size = header_size;
+  out->blocks = (data[6] & 3) + 1;
+  return frame_length;
+}
+
+int64_t adts_find_sync(const uint8_t *data, int64_t size) {
+  int64_t i = 0;
+  // 16 candidate positions at a time, the second byte of each comes from the load one further.
+#if defined(__aarch64__)
+  const uint8x16_t ff = vdupq_n_u8(0xFF);
+  const uint8x16_t sync_mask = vdupq_n_u8(0xF6);
+  const uint8x16_t sync = vdupq_n_u8(0xF0);
+  for (; i + 17 <= size; i += 16) {
+    uint8x16_t hit = vandq_u8(vceqq_u8(vld1q_u8(data + i), ff),
+                              vceqq_u8(vandq_u8(vld1q_u8(data + i + 1), sync_mask), sync));
+    if (vmaxvq_u8(hit)) {
+      break;
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i ff = _mm_set1_epi8((char)0xFF);
+  const __m128i sync_mask = _mm_set1_epi8((char)0xF6);
+  const __m128i sync = _mm_set1_epi8((char)0xF0);
+  for (; i + 17 <= size; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(data + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(data + i + 1));
+    int hit = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, ff),
+                                              _mm_cmpeq_epi8(_mm_and_si128(b, sync_mask), sync)));
+    if (hit) {
+      return i + __builtin_ctz((unsigned)hit);
+    }
+  }
+#endif
+  for (; i + 1 < size; i++) {
+    if (is_sync(data + i)) {
+      return i;
+    }
+  }
+  return size;
+}
+
+int64_t id3v2_tag_size(const uint8_t *data, int64_t size) {
+  if (size < ID3V2_HEADER_SIZE || memcmp(data, "ID3", 3) != 0) {
+    return 0;
+  }
+  // 28 bit syncsafe size of what follows the header, a footer (flag 0x10) repeats the header.
+  int64_t tag = ((int64_t)(data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) | ((data[8] & 0x7F) << 7) |
+      (data[9] & 0x7F);
+  return ID3V2_HEADER_SIZE + tag + ((data[5] & 0x10) ? ID3V2_HEADER_SIZE : 0);
+}
+
+int64_t adts_index_frames(const uint8_t *data, int64_t size, std::vector<AdtsFrame> *frames) {
+  frames->clear();
+  AdtsHeader header;
+  int64_t pos = 0;
+  while (pos < size) {
+    int length = adts_parse_header(data + pos, size - pos, &header);
+    AdtsHeader next;
+    if (length < 0 || (pos + length < size && adts_parse_header(data + pos + length, size - pos - length, &next) < 0 &&
+                       (frames->empty() || frames->back().offset + frames->back().size != pos))) {
+      // not a frame, or one nothing follows and nothing precedes: resync.
+      pos += 1 + adts_find_sync(data + pos + 1, size - pos - 1);
+      continue;
+    }
+    frames->push_back({pos, length});
+    pos += length;
+  }
+  return (int64_t)frames->size();
+}
+
+void adts_write_header(const AdtsConfig &config, int payload_size, uint8_t *dst) {
+  const int frame_length = payload_size + ADTS_HEADER_SIZE;
+  // syncword, MPEG-4, layer 0, no CRC.
+  dst[0] = 0xFF;
+  dst[1] = 0xF1;
+  dst[2] = (uint8_t)(((config.object_type - 1) << 6) | (config.sample_rate_index << 2) | (config.channel_config >> 2));
+  dst[3] = (uint8_t)(((config.channel_config & 3) << 6) | (frame_length >> 11));
+  dst[4] = (uint8_t)((frame_length >> 3) & 0xFF);
+  // buffer fullness 0x7FF (VBR), one raw data block per frame.
+  dst[5] = (uint8_t)(((frame_length & 7) << 5) | 0x1F);
+  dst[6] = 0xFC;
+}
+
+AdtsPacketizer::AdtsPacketizer(const AdtsConfig &config) : config_(config), buf_(ADTS_MAX_FRAME_SIZE) {}
+
+int AdtsPacketizer::write(const uint8_t *payload, int size, uint8_t *dst, int capacity) const {
+  const int frame_size = size + ADTS_HEADER_SIZE;
+  if (size < 0 || frame_size > ADTS_MAX_FRAME_SIZE || frame_size > capacity) {
+    LOGE("adts: a %d byte frame doesn't fit (max %d, buffer %d)", size, ADTS_MAX_FRAME_SIZE - ADTS_HEADER_SIZE,
+         capacity);
+    return -1;
+  }
+  adts_write_header(config_, size, dst);
+  memcpy(dst + ADTS_HEADER_SIZE, payload, (size_t)size);
+  return frame_size;
+}
+
+const uint8_t *AdtsPacketizer::packetize(const uint8_t *payload, int size, int *frame_size) {
+  *frame_size = write(payload, size, buf_.data(), (int)buf_.size());
+  return *frame_size < 0 ? nullptr : buf_.data();
+}
@@ -0,0 +1,105 @@
+#ifndef AUDIO_ENCODER_ADTS_H
+#define AUDIO_ENCODER_ADTS_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * ADTS framing of raw AAC access units, for the .aac outputs of both encode
+ * paths: MediaCodec hands out raw frames plus an AudioSpecificConfig
+ * (csd-0), the native FFmpeg encoder the same through extradata.
+ *
+ * No FFmpeg in here, the JNI shim links it too so the MediaCodec path doesn't
+ * have to load the codec stack.
+ */
+
+#define ADTS_HEADER_SIZE 7
+// frame_length is 13 bits and counts the header.
+#define ADTS_MAX_FRAME_SIZE 8191
+
+/** The fields an ADTS header carries about the stream, as they go into the header. */
+struct AdtsConfig {
+  // MPEG-4 audio object type, 1..4 (Main, LC, SSR, LTP): the profile field is 2 bits.
+  int object_type;
+  int sample_rate_index;
+  int channel_config;
+};
+
+/**
+ * Reads an AudioSpecificConfig. HE-AAC (v2) configs with explicit SBR / PS
+ * signalling give their core object type and rate, which is what ADTS
+ * carries, the decoder finds SBR / PS implicitly. Returns -1 on a config ADTS
+ * can't describe.
+ */
+int adts_config_from_asc(const uint8_t *asc, int size, AdtsConfig *out);
+
+/** From an object type, sample rate and channel count, -1 when one has no ADTS code. */
+int adts_config_make(int object_type, int sample_rate, int channels, AdtsConfig *out);
+
+/** What an ADTS frame header says about the frame, see adts_parse_header(). */
+struct AdtsHeader {
+  int object_type;
+  int sample_rate;
+  int channel_config;
+  // header included, the header is 9 bytes when it carries a CRC.
+  int frame_length;
+  int header_size;
+  // raw data blocks of 1024 samples (2048 with SBR) in the frame.
+  int blocks;
+};
+
+/**
+ * Parses the header of the frame at `data`, `size` bytes from there to the end
+ * of the input. Returns the frame length, -1 when there is no valid header or
+ * the frame runs past the end.
+ */
+int adts_parse_header(const uint8_t *data, int64_t size, AdtsHeader *out);
+
+/** Offset of the first 0xFFF syncword with layer 0 in `data`, `size` when there is none. */
+int64_t adts_find_sync(const uint8_t *data, int64_t size);
+
+#define ID3V2_HEADER_SIZE 10
+
+/** Size of the ID3v2 tag many .aac files start with, header and footer included, 0 when there is none. */
+int64_t id3v2_tag_size(const uint8_t *data, int64_t size);
+
+/** One frame of an ADTS stream, see adts_index_frames(). */
+struct AdtsFrame {
+  int64_t offset;
+  int size;
+};
+
+/**
+ * The frames of an ADTS stream in `data`. A header only counts when the next
+ * frame (or the end of the input) follows right where it says it ends, so
+ * sync words inside an ID3 tag or garbage between frames are skipped.
+ * Returns the number of frames, 0 when there are none.
+ */
+int64_t adts_index_frames(const uint8_t *data, int64_t size, std::vector<AdtsFrame> *frames);
+
+/** Writes the ADTS_HEADER_SIZE byte header of a frame with `payload_size` bytes of raw AAC. */
+void adts_write_header(const AdtsConfig &config, int payload_size, uint8_t *dst);
+
+/**
+ * Frames raw AAC packets into ADTS: header and payload land back to back in
+ * one buffer, so each frame is a single write.
+ */
+class AdtsPacketizer {
+ public:
+  explicit AdtsPacketizer(const AdtsConfig &config);
+
+  /**
+   * Header + payload into `dst`, `capacity` bytes. Returns the frame size, -1
+   * when the payload doesn't fit in an ADTS frame or in `dst`.
+   */
+  int write(const uint8_t *payload, int size, uint8_t *dst, int capacity) const;
+
+  /** The same into the packetizer's own buffer, valid until the next call. Null on error. */
+  const uint8_t *packetize(const uint8_t *payload, int size, int *frame_size);
+
+ private:
+  AdtsConfig config_;
+  std::vector<uint8_t> buf_;
+};
+
+#endif //AUDIO_ENCODER_ADTS_H
@@ -0,0 +1,94 @@
+#include "adts_demuxer.h"
+#include "base.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/error.h"
+}
+
+static void unmap(void *opaque, uint8_t *data) {
+  munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+std::unique_ptr<AdtsDemuxer> AdtsDemuxer::open(const char *path) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  const size_t size = (size_t)st.st_size;
+  madvise(addr, size, MADV_SEQUENTIAL);
+
+  std::unique_ptr<AdtsDemuxer> demuxer(new AdtsDemuxer());
+  demuxer->map_ = av_buffer_create((uint8_t *)addr, size, unmap, (void *)(uintptr_t)size, AV_BUFFER_FLAG_READONLY);
+  if (!demuxer->map_) {
+    munmap(addr, size);
+    return nullptr;
+  }
+  const uint8_t *data = demuxer->map_->data;
+  adts_index_frames(data, (int64_t)size, &demuxer->frames_);
+  // anything else that happens to contain sync words is left to libavformat.
+  if (demuxer->frames_.empty() || demuxer->frames_[0].offset != id3v2_tag_size(data, (int64_t)size)) {
+    return nullptr;
+  }
+  return demuxer;
+}
+
+AdtsDemuxer::~AdtsDemuxer() {
+  av_buffer_unref(&map_);
+}
+
+int AdtsDemuxer::parameters(AVCodecParameters *par) const {
+  AdtsHeader header;
+  const AdtsFrame &first = frames_[0];
+  if (adts_parse_header(map_->data + first.offset, first.size, &header) < 0) {
+    return AVERROR_INVALIDDATA;
+  }
+  par->codec_type = AVMEDIA_TYPE_AUDIO;
+  par->codec_id = AV_CODEC_ID_AAC;
+  par->profile = header.object_type - 1;
+  par->sample_rate = header.sample_rate;
+  // configuration 0 is a PCE in the first frame, the decoder finds the layout there.
+  av_channel_layout_uninit(&par->ch_layout);
+  if (header.channel_config > 0) {
+    av_channel_layout_default(&par->ch_layout, header.channel_config == 7 ? 8 : header.channel_config);
+  }
+  return 0;
+}
+
+int AdtsDemuxer::packet(int64_t index, AVPacket *pkt) const {
+  const AdtsFrame &frame = frames_[index];
+  av_packet_unref(pkt);
+  if (frame.offset + frame.size + AV_INPUT_BUFFER_PADDING_SIZE > (int64_t)map_->size) {
+    int ret = av_new_packet(pkt, frame.size);
+    if (ret < 0) {
+      return ret;
+    }
+    memcpy(pkt->data, map_->data + frame.offset, (size_t)frame.size);
+  } else {
+    pkt->buf = av_buffer_ref(map_);
+    if (!pkt->buf) {
+      return AVERROR(ENOMEM);
+    }
+    pkt->data = map_->data + frame.offset;
+    pkt->size = frame.size;
+  }
+  pkt->pts = index;
+  pkt->dts = index;
+  return 0;
+}
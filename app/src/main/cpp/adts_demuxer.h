@@ -0,0 +1,48 @@
+#ifndef AUDIO_ENCODER_ADTS_DEMUXER_H
+#define AUDIO_ENCODER_ADTS_DEMUXER_H
+
+#include "adts.h"
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/packet.h"
+#include "libavcodec/codec_par.h"
+#include "libavutil/buffer.h"
+}
+
+/**
+ * Raw .aac (ADTS) input without libavformat: the file is mmap()ed and its
+ * frames indexed from their headers, nothing is probed or decoded ahead.
+ * Packets are references to the mapping, so the decoder takes them without a
+ * copy; the mapping goes away with the last of them.
+ */
+class AdtsDemuxer {
+ public:
+  /** Null when the file can't be mapped or doesn't start with ADTS frames, after an optional ID3v2 tag. */
+  static std::unique_ptr<AdtsDemuxer> open(const char *path);
+
+  ~AdtsDemuxer();
+
+  int64_t nb_frames() const { return (int64_t)frames_.size(); }
+
+  /** Codec, profile, rate and channels of the first frame header, HE-AAC shows up as its core. */
+  int parameters(AVCodecParameters *par) const;
+
+  /**
+   * Frame `index` into `pkt` with its pts set to the index. Frames too close
+   * to the end of the file for the decoder's read-ahead padding are copied.
+   * May be called from several threads.
+   */
+  int packet(int64_t index, AVPacket *pkt) const;
+
+ private:
+  AdtsDemuxer() = default;
+
+  AVBufferRef *map_ = nullptr;
+  std::vector<AdtsFrame> frames_;
+};
+
+#endif //AUDIO_ENCODER_ADTS_DEMUXER_H
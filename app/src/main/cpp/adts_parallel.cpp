@@ -0,0 +1,180 @@
+#include "adts_parallel.h"
+#include "base.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/error.h"
+}
+
+// frames decoded ahead of each chunk and dropped: 1 settles the MDCT overlap, SBR / PS take a few more.
+#define PREROLL_FRAMES 8
+// chunk length bounds, ~6 and ~24 s of 44.1 kHz LC; a chunk's output is held until its turn.
+#define MIN_CHUNK_FRAMES 256
+#define MAX_CHUNK_FRAMES 1024
+// chunks decoded or queued per thread ahead of the one being written.
+#define CHUNKS_PER_THREAD 2
+// decoded output held at once by the chunks in flight, at the most a frame can decode to.
+#define MAX_HELD_BYTES (32 * 1024 * 1024)
+// samples per channel of a frame: 1024, twice that once SBR doubles the rate.
+#define MAX_FRAME_SAMPLES 2048
+// channels assumed when the header leaves them to a PCE.
+#define MAX_CHANNELS 8
+
+struct AdtsChunk {
+  int64_t first;
+  int64_t end;
+  // planar output of frames [first, end).
+  std::vector<std::vector<float>> planes;
+  AVChannelLayout layout = {};
+  int sample_rate = 0;
+  int ret = 0;
+  bool done = false;
+};
+
+// keeps the frames of the chunk, frames decoded from pre-roll packets carry a pts before `first`.
+static int receive_frames(AVCodecContext *c, AVFrame *frame, AdtsChunk *chunk) {
+  int ret;
+  while ((ret = avcodec_receive_frame(c, frame)) >= 0) {
+    if (frame->pts >= chunk->first) {
+      const int channels = frame->ch_layout.nb_channels;
+      if (frame->format != AV_SAMPLE_FMT_FLTP ||
+          (chunk->sample_rate && (av_channel_layout_compare(&frame->ch_layout, &chunk->layout) != 0 ||
+                                  frame->sample_rate != chunk->sample_rate))) {
+        LOGE("adts: frame %lld changes format, can't be stitched", (long long)frame->pts);
+        av_frame_unref(frame);
+        return AVERROR_PATCHWELCOME;
+      }
+      if (!chunk->sample_rate) {
+        av_channel_layout_copy(&chunk->layout, &frame->ch_layout);
+        chunk->sample_rate = frame->sample_rate;
+        // reserved whole, growth by doubling could hold twice the output.
+        chunk->planes.resize(channels);
+        for (std::vector<float> &plane : chunk->planes) {
+          plane.reserve((size_t)(chunk->end - chunk->first) * frame->nb_samples);
+        }
+      }
+      for (int ch = 0; ch < channels; ch++) {
+        const float *src = (const float *)frame->extended_data[ch];
+        chunk->planes[ch].insert(chunk->planes[ch].end(), src, src + frame->nb_samples);
+      }
+    }
+    av_frame_unref(frame);
+  }
+  return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+static void decode_chunk(const AdtsDemuxer &demuxer, const AVCodecParameters *par, AdtsChunk *chunk) {
+  const AVCodec *codec = avcodec_find_decoder(par->codec_id);
+  AVCodecContext *c = codec ? avcodec_alloc_context3(codec) : nullptr;
+  AVPacket *pkt = av_packet_alloc();
+  AVFrame *frame = av_frame_alloc();
+  int ret = AVERROR(ENOMEM);
+  if (!c || !pkt || !frame || (ret = avcodec_parameters_to_context(c, par)) < 0 ||
+      (ret = avcodec_open2(c, codec, nullptr)) < 0) {
+    chunk->ret = ret;
+    goto end;
+  }
+
+  for (int64_t i = std::max<int64_t>(chunk->first - PREROLL_FRAMES, 0); i < chunk->end; i++) {
+    if ((ret = demuxer.packet(i, pkt)) < 0) {
+      break;
+    }
+    ret = avcodec_send_packet(c, pkt);
+    av_packet_unref(pkt);
+    // a damaged frame costs its samples, as in the serial decode.
+    if (ret < 0 && ret != AVERROR_INVALIDDATA) {
+      break;
+    }
+    if ((ret = receive_frames(c, frame, chunk)) < 0) {
+      break;
+    }
+  }
+  if (ret >= 0 && (ret = avcodec_send_packet(c, nullptr)) >= 0) {
+    ret = receive_frames(c, frame, chunk);
+  }
+  chunk->ret = ret < 0 ? ret : 0;
+
+end:
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+  avcodec_free_context(&c);
+}
+
+int decode_adts_parallel(const AdtsDemuxer &demuxer, const AVCodecParameters *par, int threads, const PcmSink &sink) {
+  int ret = 0;
+  const int64_t nb_frames = demuxer.nb_frames();
+
+  std::vector<AdtsChunk> chunks;
+  std::mutex lock;
+  std::condition_variable done;
+  // declared last: its destructor finishes the queued chunks before anything they use goes away.
+  WorkerPool pool(threads);
+  // shorter chunks before fewer of them, so every thread keeps one while the total stays in MAX_HELD_BYTES.
+  const int channels = par->ch_layout.nb_channels > 0 ? par->ch_layout.nb_channels : MAX_CHANNELS;
+  const int64_t held_frames = MAX_HELD_BYTES / ((int64_t)MAX_FRAME_SAMPLES * channels * sizeof(float));
+  int64_t chunk_frames = std::min<int64_t>(
+      std::max<int64_t>((nb_frames + pool.size() - 1) / pool.size(), MIN_CHUNK_FRAMES), MAX_CHUNK_FRAMES);
+  chunk_frames = std::max<int64_t>(std::min<int64_t>(chunk_frames, held_frames / pool.size()), MIN_CHUNK_FRAMES);
+  for (int64_t first = 0; first < nb_frames; first += chunk_frames) {
+    AdtsChunk chunk;
+    chunk.first = first;
+    chunk.end = std::min(nb_frames, first + chunk_frames);
+    chunks.push_back(std::move(chunk));
+  }
+
+  auto submit = [&](size_t i) {
+    AdtsChunk *chunk = &chunks[i];
+    pool.submit([&, chunk] {
+      decode_chunk(demuxer, par, chunk);
+      std::lock_guard<std::mutex> guard(lock);
+      chunk->done = true;
+      done.notify_all();
+    });
+  };
+  // counts the chunk being written: the next one is submitted once its output is gone.
+  const size_t ahead = (size_t)std::max<int64_t>(
+      std::min<int64_t>(held_frames / chunk_frames, (int64_t)pool.size() * CHUNKS_PER_THREAD), 1);
+  for (size_t i = 0; i < std::min(ahead, chunks.size()); i++) {
+    submit(i);
+  }
+
+  std::vector<float *> planes;
+  for (size_t i = 0; i < chunks.size() && ret >= 0; i++) {
+    AdtsChunk &chunk = chunks[i];
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      done.wait(guard, [&chunk] { return chunk.done; });
+    }
+    if (chunk.ret < 0) {
+      LOGE("adts chunk at frame %lld failed, reason: %s", (long long)chunk.first, av_err2str(chunk.ret));
+      ret = chunk.ret;
+      break;
+    }
+    if (chunk.sample_rate) {
+      planes.clear();
+      for (std::vector<float> &plane : chunk.planes) {
+        planes.push_back(plane.data());
+      }
+      ret = sink(planes.data(), &chunk.layout, (int)chunk.planes[0].size(), chunk.sample_rate);
+    }
+    std::vector<std::vector<float>>().swap(chunk.planes);
+    av_channel_layout_uninit(&chunk.layout);
+    if (i + ahead < chunks.size()) {
+      submit(i + ahead);
+    }
+  }
+  pool.wait();
+  for (AdtsChunk &chunk : chunks) {
+    av_channel_layout_uninit(&chunk.layout);
+  }
+  if (ret >= 0) {
+    LOGI("adts: %lld frames in %zu chunks on %d threads", (long long)nb_frames, chunks.size(), pool.size());
+  }
+  return ret < 0 ? ret : 0;
+}
@@ -0,0 +1,33 @@
+#ifndef AUDIO_ENCODER_ADTS_PARALLEL_H
+#define AUDIO_ENCODER_ADTS_PARALLEL_H
+
+#include "adts_demuxer.h"
+
+#include <functional>
+
+extern "C" {
+#include "libavcodec/codec_par.h"
+#include "libavutil/channel_layout.h"
+}
+
+/** Receives decoded planar float in stream order, < 0 stops the decode. */
+typedef std::function<int(float *const *planes, const AVChannelLayout *layout, int nb_samples, int sample_rate)>
+    PcmSink;
+
+/**
+ * Decodes the frames of `demuxer` on every core.
+ *
+ * ADTS frames are self-delimiting, so the frame index cuts the file into
+ * chunks that a WorkerPool decodes with one decoder each. A chunk's decoder
+ * starts a few frames early so the MDCT overlap and SBR / PS state have
+ * settled by its first frame, the output of that pre-roll is dropped. Chunks
+ * reach `sink` in file order on the calling thread, while later ones are
+ * still being decoded. Chunk length and how many are in flight are sized so
+ * their decoded output stays under MAX_HELD_BYTES at the worst case.
+ *
+ * `par` are the stream's parameters, the decoder must output planar float.
+ * `threads` 0 means one per core. Returns 0 or a negative AVERROR.
+ */
+int decode_adts_parallel(const AdtsDemuxer &demuxer, const AVCodecParameters *par, int threads, const PcmSink &sink);
+
+#endif //AUDIO_ENCODER_ADTS_PARALLEL_H
@@ -0,0 +1,65 @@
+#include "bandwidth.h"
+#include "base.h"
+#include "pcm_dsp.h"
+#include "spectrum.h"
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#define FFT_SIZE 2048
+#define MAX_FRAMES 256
+// frames of the downmix quieter than this (dBFS RMS) say nothing about the bandwidth.
+#define SILENT_DB (-60.0f)
+
+int detect_bandwidth(const int16_t *pcm, int64_t nb_samples, int channels, int sample_rate, float range_db) {
+  if (nb_samples < FFT_SIZE) {
+    return sample_rate / 2;
+  }
+  WindowedFft fft;
+  if (fft.init(FFT_SIZE) < 0) {
+    return sample_rate / 2;
+  }
+
+  const PcmDsp *dsp = pcm_dsp_get();
+  std::vector<float> mono(FFT_SIZE);
+  std::vector<float> scratch((size_t)channels * FFT_SIZE);
+  std::vector<float *> planes(channels);
+  for (int c = 0; c < channels; c++) {
+    planes[c] = scratch.data() + (size_t)c * FFT_SIZE;
+  }
+  const std::vector<float> gains(channels, 1.0f / channels);
+  const float silent = FFT_SIZE * powf(10.0f, SILENT_DB / 10.0f);
+
+  const int64_t nb_frames = std::min<int64_t>(MAX_FRAMES, nb_samples / FFT_SIZE);
+  const int64_t step = nb_frames > 1 ? (nb_samples - FFT_SIZE) / (nb_frames - 1) : 0;
+  const int bins = fft.bins();
+  std::vector<double> power(bins, 0.0);
+  int used = 0;
+  for (int64_t f = 0; f < nb_frames; f++) {
+    dsp->s16_to_float_planar(planes.data(), pcm + f * step * channels, channels, FFT_SIZE);
+    dsp->mix(mono.data(), planes.data(), gains.data(), channels, FFT_SIZE);
+    if (dsp->dot(mono.data(), mono.data(), FFT_SIZE) < silent) {
+      continue;
+    }
+    const AVComplexFloat *out = fft.transform(mono.data());
+    for (int k = 0; k < bins; k++) {
+      power[k] += (double)out[k].re * out[k].re + (double)out[k].im * out[k].im;
+    }
+    used++;
+  }
+  if (used == 0) {
+    return sample_rate / 2;
+  }
+
+  // skip DC, a recording offset isn't content.
+  const double peak = *std::max_element(power.begin() + 1, power.end());
+  const double limit = peak * pow(10.0, -range_db / 10.0);
+  int top = bins - 1;
+  while (top > 1 && power[top] <= limit) {
+    top--;
+  }
+  int bandwidth = (int)((int64_t)(top + 1) * sample_rate / FFT_SIZE);
+  LOGI("bandwidth: %d Hz over %d of %lld frames", bandwidth, used, (long long)nb_frames);
+  return std::min(bandwidth, sample_rate / 2);
+}
@@ -0,0 +1,17 @@
+#ifndef AUDIO_ENCODER_BANDWIDTH_H
+#define AUDIO_ENCODER_BANDWIDTH_H
+
+#include <stdint.h>
+
+/**
+ * Effective audio bandwidth of interleaved S16 input in Hz: the highest
+ * frequency whose long-term power is within `range_db` of the strongest one.
+ *
+ * Averages Hann windowed real FFTs (av_tx) of the mono downmix at up to a few
+ * hundred points spread over the input, silent ones skipped, so it costs a
+ * small fraction of an encode whatever the length. Returns sample_rate / 2
+ * when nothing could be measured.
+ */
+int detect_bandwidth(const int16_t *pcm, int64_t nb_samples, int channels, int sample_rate, float range_db);
+
+#endif //AUDIO_ENCODER_BANDWIDTH_H
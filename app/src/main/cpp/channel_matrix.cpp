@@ -0,0 +1,67 @@
+#include "channel_matrix.h"
+#include "base.h"
+
+#include <math.h>
+
+extern "C" {
+#include "libavutil/error.h"
+#include "libswresample/swresample.h"
+}
+
+std::unique_ptr<ChannelMatrix> ChannelMatrix::create(const AVChannelLayout *in, const AVChannelLayout *out,
+                                                     const std::vector<float> &coeffs) {
+  const int in_ch = in->nb_channels;
+  const int out_ch = out->nb_channels;
+  std::unique_ptr<ChannelMatrix> matrix(new ChannelMatrix());
+  matrix->dsp_ = pcm_dsp_get();
+  av_channel_layout_copy(&matrix->in_, in);
+  av_channel_layout_copy(&matrix->out_, out);
+
+  char in_name[64];
+  char out_name[64];
+  av_channel_layout_describe(in, in_name, sizeof(in_name));
+  av_channel_layout_describe(out, out_name, sizeof(out_name));
+  if (!coeffs.empty()) {
+    if (coeffs.size() != (size_t)in_ch * out_ch) {
+      LOGE("channel matrix %s -> %s needs %d x %d coefficients, got %zu",
+           in_name, out_name, out_ch, in_ch, coeffs.size());
+      return nullptr;
+    }
+    matrix->m_ = coeffs;
+    return matrix;
+  }
+
+  std::vector<double> m((size_t)in_ch * out_ch, 0.0);
+  int ret = swr_build_matrix2(in, out, M_SQRT1_2, M_SQRT1_2, 0.0, 1.0, 1.0, m.data(), in_ch,
+                              AV_MATRIX_ENCODING_NONE, nullptr);
+  if (ret < 0) {
+    LOGE("no channel matrix for %s -> %s: %s", in_name, out_name, av_err2str(ret));
+    return nullptr;
+  }
+  matrix->m_.assign(m.begin(), m.end());
+  LOGI("channel matrix %s -> %s", in_name, out_name);
+  return matrix;
+}
+
+ChannelMatrix::~ChannelMatrix() {
+  av_channel_layout_uninit(&in_);
+  av_channel_layout_uninit(&out_);
+}
+
+bool ChannelMatrix::identity() const {
+  if (in_.nb_channels != out_.nb_channels) {
+    return false;
+  }
+  for (int o = 0; o < out_.nb_channels; o++) {
+    for (int k = 0; k < in_.nb_channels; k++) {
+      if (m_[(size_t)o * in_.nb_channels + k] != (o == k ? 1.0f : 0.0f)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void ChannelMatrix::process(float *const *dst, const float *const *src, int nb_samples) const {
+  dsp_->matrix(dst, src, m_.data(), out_.nb_channels, in_.nb_channels, nb_samples);
+}
@@ -0,0 +1,52 @@
+#ifndef AUDIO_ENCODER_CHANNEL_MATRIX_H
+#define AUDIO_ENCODER_CHANNEL_MATRIX_H
+
+#include <memory>
+#include <vector>
+
+#include "pcm_dsp.h"
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+}
+
+/**
+ * Down / upmix of planar float audio from one channel layout to another (mono,
+ * stereo, 5.1, 7.1, ...) on the PcmDsp matrix kernel. It runs ahead of the
+ * pre-encode stages, so they and the encoder only pay for the output channels
+ * and swresample is left with format / rate conversion.
+ */
+class ChannelMatrix {
+ public:
+  /**
+   * `coeffs` is the out x in matrix, row-major. Empty takes swresample's default
+   * (center and surrounds at -3 dB, no LFE, normalized so nothing clips).
+   * Returns null on a layout or matrix swresample can't handle.
+   */
+  static std::unique_ptr<ChannelMatrix> create(const AVChannelLayout *in, const AVChannelLayout *out,
+                                               const std::vector<float> &coeffs);
+
+  ~ChannelMatrix();
+
+  int in_channels() const { return in_.nb_channels; }
+
+  int out_channels() const { return out_.nb_channels; }
+
+  const AVChannelLayout *out_layout() const { return &out_; }
+
+  /** True when the output is the input unchanged, the caller can skip the matrix then. */
+  bool identity() const;
+
+  /** dst gets out_channels() planes, it must not alias src. */
+  void process(float *const *dst, const float *const *src, int nb_samples) const;
+
+ private:
+  ChannelMatrix() = default;
+
+  const PcmDsp *dsp_ = nullptr;
+  AVChannelLayout in_ = {};
+  AVChannelLayout out_ = {};
+  std::vector<float> m_;
+};
+
+#endif //AUDIO_ENCODER_CHANNEL_MATRIX_H
@@ -0,0 +1,42 @@
+#ifndef AUDIO_ENCODER_CORE_API_H
+#define AUDIO_ENCODER_CORE_API_H
+
+#include <jni.h>
+
+/**
+ * Entry points of libaudio_encoder_core.so, the library that links FFmpeg.
+ *
+ * Java only loads libaudio_encoder.so (jni_shim.cpp), which doesn't depend on
+ * FFmpeg at all and dlopen()s the core the first time a conversion or
+ * nativePrewarm() needs it, so app start doesn't pay for relocating the codec
+ * stack. The JNI methods are forwarded one to one with these signatures.
+ */
+
+#define AUDIO_CORE_LIBRARY "libaudio_encoder_core.so"
+
+extern "C" {
+
+/** Called once right after the core is loaded, starts warming the encoder pool. */
+JNIEXPORT void JNICALL audio_core_init();
+
+JNIEXPORT jint JNICALL audio_core_encode(JNIEnv *env, jobject thiz, jobject mgr, jstring dest, jstring options);
+
+/** One pass over the input, encoded into every entry of `dests` with the options of the matching variant. */
+JNIEXPORT jint JNICALL audio_core_encode_ladder(JNIEnv *env, jobject thiz, jobject mgr, jobjectArray dests,
+                                                jstring options, jobjectArray variants);
+
+JNIEXPORT jint JNICALL audio_core_decode(JNIEnv *env, jobject thiz, jstring input_path, jstring output_path,
+                                         jstring options);
+
+/** Duration (ms), sample rate, channels and bitrate of every path from its headers, 4 values each, -1 on failure. */
+JNIEXPORT jlongArray JNICALL audio_core_scan(JNIEnv *env, jobject thiz, jobjectArray paths);
+
+typedef void (*audio_core_init_fn)();
+typedef jint (*audio_core_encode_fn)(JNIEnv *, jobject, jobject, jstring, jstring);
+typedef jint (*audio_core_encode_ladder_fn)(JNIEnv *, jobject, jobject, jobjectArray, jstring, jobjectArray);
+typedef jint (*audio_core_decode_fn)(JNIEnv *, jobject, jstring, jstring, jstring);
+typedef jlongArray (*audio_core_scan_fn)(JNIEnv *, jobject, jobjectArray);
+
+}
+
+#endif //AUDIO_ENCODER_CORE_API_H
@@ -0,0 +1,76 @@
+#include "dual_mono.h"
+#include "base.h"
+#include "simd.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define WINDOW_MS 100
+// windows whose mid stays under this (dBFS) are too quiet to tell.
+#define SILENCE_FLOOR_DB (-70.0)
+
+// sums of (L + R)^2 and (L - R)^2 over n stereo frames.
+static void mid_side_energy(const int16_t *x, int n, double *mid, double *side) {
+  int i = 0;
+  f32x4 vmid = f32x4_zero();
+  f32x4 vside = f32x4_zero();
+#if defined(__aarch64__)
+  for (; i + 4 <= n; i += 4) {
+    int16x4x2_t v = vld2_s16(x + i * 2);
+    f32x4 m = vcvtq_f32_s32(vaddl_s16(v.val[0], v.val[1]));
+    f32x4 s = vcvtq_f32_s32(vsubl_s16(v.val[0], v.val[1]));
+    vmid = f32x4_mla(vmid, m, m);
+    vside = f32x4_mla(vside, s, s);
+  }
+#elif defined(__SSE2__)
+  // L * 1 + R * 1 and L * 1 + R * -1 of every frame in one madd each.
+  const __m128i sum = _mm_set1_epi16(1);
+  const __m128i diff = _mm_set1_epi32((int)0xffff0001u);
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(x + i * 2));
+    f32x4 m = _mm_cvtepi32_ps(_mm_madd_epi16(v, sum));
+    f32x4 s = _mm_cvtepi32_ps(_mm_madd_epi16(v, diff));
+    vmid = f32x4_mla(vmid, m, m);
+    vside = f32x4_mla(vside, s, s);
+  }
+#endif
+  double m = f32x4_hsum(vmid);
+  double s = f32x4_hsum(vside);
+  for (; i < n; i++) {
+    int l = x[i * 2];
+    int r = x[i * 2 + 1];
+    m += (double)(l + r) * (l + r);
+    s += (double)(l - r) * (l - r);
+  }
+  *mid = m;
+  *side = s;
+}
+
+bool detect_dual_mono(const int16_t *pcm, int64_t nb_samples, int sample_rate, float threshold_db) {
+  const int window = std::max(1, sample_rate * WINDOW_MS / 1000);
+  const double ratio = pow(10.0, threshold_db / 10.0);
+  // mid is L + R, full scale is twice the S16 range.
+  const double floor = pow(10.0, SILENCE_FLOOR_DB / 10.0) * 65536.0 * 65536.0;
+  int64_t counted = 0;
+  for (int64_t pos = 0; pos < nb_samples; pos += window) {
+    int n = (int)std::min<int64_t>(window, nb_samples - pos);
+    double mid;
+    double side;
+    mid_side_energy(pcm + pos * 2, n, &mid, &side);
+    if (mid + side < floor * n) {
+      continue;
+    }
+    if (side > mid * ratio) {
+      return false;
+    }
+    counted++;
+  }
+  LOGI("dual mono: %lld windows, all of them mono", (long long)counted);
+  return counted > 0;
+}
@@ -0,0 +1,15 @@
+#ifndef AUDIO_ENCODER_DUAL_MONO_H
+#define AUDIO_ENCODER_DUAL_MONO_H
+
+#include <stdint.h>
+
+/**
+ * Checks whether interleaved S16 stereo input is really mono (both channels
+ * the same recording): in every 100 ms window the side signal L - R has to
+ * stay `threshold_db` or more under the mid L + R. Windows near digital
+ * silence don't count either way. Stops at the first window that is stereo,
+ * so real stereo input costs a fraction of a pass.
+ */
+bool detect_dual_mono(const int16_t *pcm, int64_t nb_samples, int sample_rate, float threshold_db);
+
+#endif //AUDIO_ENCODER_DUAL_MONO_H
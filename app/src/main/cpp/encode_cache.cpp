@@ -0,0 +1,176 @@
+#include "encode_cache.h"
+#include "base.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "libavutil/hash.h"
+}
+
+// entries are written under a unique name with this suffix and renamed into place, so readers never see
+// half a file and two jobs storing the same entry don't write into each other's copy.
+#define TMP_SUFFIX ".tmp"
+// a temp file this old (s) was left by a job that died mid-copy, eviction removes it.
+#define STALE_TMP_SECONDS (60 * 60)
+
+ContentHash::ContentHash() {
+  if (av_hash_alloc(&ctx_, "murmur3") < 0) {
+    LOGE("av_hash_alloc murmur3 failed.");
+    ctx_ = nullptr;
+    return;
+  }
+  av_hash_init(ctx_);
+}
+
+ContentHash::~ContentHash() {
+  av_hash_freep(&ctx_);
+}
+
+void ContentHash::update(const void *data, size_t size) {
+  av_hash_update(ctx_, (const uint8_t *)data, size);
+}
+
+void ContentHash::update(const std::string &s) {
+  uint64_t size = s.size();
+  update(&size, sizeof(size));
+  update(s.data(), s.size());
+}
+
+std::string ContentHash::hex() {
+  uint8_t buf[2 * AV_HASH_MAX_SIZE + 1];
+  av_hash_final_hex(ctx_, buf, sizeof(buf));
+  return std::string((const char *)buf);
+}
+
+static int copy_file(const std::string &from, const std::string &to) {
+  FILE *in = fopen(from.c_str(), "rb");
+  if (!in) {
+    return -1;
+  }
+  FILE *out = fopen(to.c_str(), "wb");
+  if (!out) {
+    LOGE("can't open %s: %s", to.c_str(), strerror(errno));
+    fclose(in);
+    return -1;
+  }
+  char buf[64 * 1024];
+  size_t n;
+  int ret = 0;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    if (fwrite(buf, 1, n, out) != n) {
+      ret = -1;
+      break;
+    }
+  }
+  if (ferror(in)) {
+    ret = -1;
+  }
+  fclose(in);
+  if (fclose(out) != 0) {
+    ret = -1;
+  }
+  return ret;
+}
+
+EncodeCache::EncodeCache(const std::string &dir, int64_t max_bytes) : dir_(dir), max_bytes_(max_bytes) {
+  mkdir(dir_.c_str(), 0700);
+}
+
+// the extension of `file` is kept, the muxer picks the container by it.
+std::string EncodeCache::entry_path(const std::string &key, const std::string &file) const {
+  size_t slash = file.rfind('/');
+  size_t dot = file.rfind('.');
+  std::string ext = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? file.substr(dot) : "";
+  return dir_ + "/" + key + ext;
+}
+
+int EncodeCache::fetch(const std::string &key, const std::string &dest) {
+  std::string path = entry_path(key, dest);
+  if (access(path.c_str(), R_OK) != 0) {
+    return 0;
+  }
+  int ret = copy_file(path, dest);
+  if (ret < 0) {
+    LOGE("copy cache entry %s failed.", path.c_str());
+    return ret;
+  }
+  // bump to most recently used.
+  utimes(path.c_str(), nullptr);
+  return 1;
+}
+
+int EncodeCache::store(const std::string &key, const std::string &src) {
+  std::string path = entry_path(key, src);
+  std::string tmp = path + ".XXXXXX" + TMP_SUFFIX;
+  int fd = mkstemps(&tmp[0], (int)strlen(TMP_SUFFIX));
+  if (fd < 0) {
+    LOGE("can't create %s: %s", tmp.c_str(), strerror(errno));
+    return -1;
+  }
+  close(fd);
+  if (copy_file(src, tmp) < 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+    LOGE("store cache entry %s failed.", path.c_str());
+    unlink(tmp.c_str());
+    return -1;
+  }
+  evict();
+  return 0;
+}
+
+void EncodeCache::evict() {
+  struct Entry {
+    std::string path;
+    int64_t size;
+    time_t mtime;
+  };
+  DIR *dir = opendir(dir_.c_str());
+  if (!dir) {
+    return;
+  }
+  std::vector<Entry> entries;
+  int64_t total = 0;
+  const time_t now = time(nullptr);
+  struct dirent *d;
+  while ((d = readdir(dir))) {
+    if (d->d_name[0] == '.') {
+      continue;
+    }
+    std::string path = dir_ + "/" + d->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    // another job's store() still being copied: neither counted nor removed under it, unless it was abandoned.
+    const size_t len = strlen(d->d_name);
+    if (len >= strlen(TMP_SUFFIX) && !strcmp(d->d_name + len - strlen(TMP_SUFFIX), TMP_SUFFIX)) {
+      if (now - st.st_mtime > STALE_TMP_SECONDS && unlink(path.c_str()) == 0) {
+        LOGI("cache: removed stale %s", path.c_str());
+      }
+      continue;
+    }
+    entries.push_back(Entry{path, (int64_t)st.st_size, st.st_mtime});
+    total += st.st_size;
+  }
+  closedir(dir);
+
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.mtime < b.mtime; });
+  for (const Entry &e : entries) {
+    if (total <= max_bytes_) {
+      break;
+    }
+    if (unlink(e.path.c_str()) == 0) {
+      total -= e.size;
+      LOGI("cache: evicted %s", e.path.c_str());
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef AUDIO_ENCODER_ENCODE_CACHE_H
+#define AUDIO_ENCODER_ENCODE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+struct AVHashContext;
+
+/**
+ * Streaming digest of everything that decides the encoded bytes: input PCM,
+ * mix inputs, options and codec configuration. 128 bit murmur3 from
+ * libavutil/hash.h: the cache only has to tell our own jobs apart, and it runs
+ * at memory speed where SHA-2 would cost a noticeable part of an encode.
+ */
+class ContentHash {
+ public:
+  ContentHash();
+
+  ~ContentHash();
+
+  bool valid() const { return ctx_ != nullptr; }
+
+  void update(const void *data, size_t size);
+
+  /** Length prefixed, so ("ab", "c") and ("a", "bc") differ. */
+  void update(const std::string &s);
+
+  std::string hex();
+
+ private:
+  AVHashContext *ctx_ = nullptr;
+};
+
+/**
+ * Finished encodes stored as <dir>/<digest><ext>, least recently used first out
+ * once the directory grows past its size budget. A hit refreshes the entry's
+ * mtime, which is what the eviction order goes by. Temp files a crashed store()
+ * left behind are removed once they are an hour old.
+ */
+class EncodeCache {
+ public:
+  EncodeCache(const std::string &dir, int64_t max_bytes);
+
+  /** Copies the entry for `key` to `dest`: 1 on a hit, 0 on a miss, < 0 on error. */
+  int fetch(const std::string &key, const std::string &dest);
+
+  /** Adds `src` as the entry for `key`, then evicts down to the budget. */
+  int store(const std::string &key, const std::string &src);
+
+ private:
+  std::string entry_path(const std::string &key, const std::string &file) const;
+  void evict();
+
+  std::string dir_;
+  int64_t max_bytes_;
+};
+
+#endif //AUDIO_ENCODER_ENCODE_CACHE_H
@@ -0,0 +1,216 @@
+#include "encoder_pool.h"
+#include "base.h"
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+}
+
+// idle contexts kept per config, enough for back to back sessions.
+#define MAX_IDLE 2
+// idle contexts kept over all configs, the least recently pooled goes first.
+#define MAX_IDLE_TOTAL 4
+// configs remembered as worth refilling, the least recently seen is forgotten first.
+#define MAX_KNOWN 16
+
+int open_encoder(const EncoderConfig &config, AVCodecContext **out) {
+  const AVCodec *codec = config.encoder.empty() ? avcodec_find_encoder(config.codec_id)
+                                                : avcodec_find_encoder_by_name(config.encoder.c_str());
+  if (!codec) {
+    LOGE("Can't find encoder %s.", config.encoder.empty() ? avcodec_get_name(config.codec_id) : config.encoder.c_str());
+    return AVERROR_ENCODER_NOT_FOUND;
+  }
+  AVDictionary *opts = nullptr;
+  if (!config.options.empty() && av_dict_parse_string(&opts, config.options.c_str(), "=", ":", 0) < 0) {
+    LOGE("malformed encoder options '%s'", config.options.c_str());
+    av_dict_free(&opts);
+    return AVERROR(EINVAL);
+  }
+  AVCodecContext *c = avcodec_alloc_context3(codec);
+  if (!c) {
+    av_dict_free(&opts);
+    return AVERROR(ENOMEM);
+  }
+  c->codec_id = config.codec_id;
+  c->codec_type = AVMEDIA_TYPE_AUDIO;
+  c->sample_fmt = config.sample_fmt;
+  c->bit_rate = config.bit_rate;
+  c->sample_rate = config.sample_rate;
+  c->time_base = (AVRational){1, config.sample_rate};
+  av_channel_layout_from_mask(&c->ch_layout, config.channel_mask);
+  c->profile = config.profile;
+  if (config.global_header) {
+    c->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  //打开编码器
+  int ret = avcodec_open2(c, codec, &opts);
+  // whatever is left wasn't recognized by the encoder.
+  const AVDictionaryEntry *e = nullptr;
+  while ((e = av_dict_iterate(opts, e))) {
+    LOGW("%s: unused option %s=%s", codec->name, e->key, e->value);
+  }
+  av_dict_free(&opts);
+  if (ret < 0) {
+    LOGE("avcodec_open2 open failed, reason: %s", av_err2str(ret));
+    avcodec_free_context(&c);
+    return ret;
+  }
+  *out = c;
+  return 0;
+}
+
+EncoderPool &EncoderPool::get() {
+  static EncoderPool pool;
+  return pool;
+}
+
+EncoderPool::EncoderPool() : thread_(&EncoderPool::run, this) {
+}
+
+EncoderPool::~EncoderPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+  for (Idle &idle : idle_) {
+    avcodec_free_context(&idle.ctx);
+  }
+}
+
+int EncoderPool::idle_count(const EncoderConfig &config) const {
+  int n = 0;
+  for (const Idle &idle : idle_) {
+    n += idle.config == config;
+  }
+  return n;
+}
+
+void EncoderPool::remember(const EncoderConfig &config) {
+  for (auto it = known_.begin(); it != known_.end(); ++it) {
+    if (*it == config) {
+      known_.erase(it);
+      break;
+    }
+  }
+  if (known_.size() >= MAX_KNOWN) {
+    known_.erase(known_.begin());
+  }
+  known_.push_back(config);
+}
+
+bool EncoderPool::known(const EncoderConfig &config) const {
+  for (const EncoderConfig &k : known_) {
+    if (k == config) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void EncoderPool::add_idle(const EncoderConfig &config, AVCodecContext *c) {
+  if (idle_count(config) >= MAX_IDLE) {
+    avcodec_free_context(&c);
+    return;
+  }
+  if (idle_.size() >= MAX_IDLE_TOTAL) {
+    avcodec_free_context(&idle_.front().ctx);
+    idle_.erase(idle_.begin());
+  }
+  idle_.push_back(Idle{config, c});
+}
+
+void EncoderPool::warm(const EncoderConfig &config, int count) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    remember(config);
+    for (int i = 0; i < count; i++) {
+      pending_.push_back(config);
+    }
+  }
+  wake_.notify_one();
+}
+
+AVCodecContext *EncoderPool::acquire(const EncoderConfig &config) {
+  AVCodecContext *c = nullptr;
+  bool refill = false;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (auto it = idle_.begin(); it != idle_.end(); ++it) {
+      if (it->config == config) {
+        c = it->ctx;
+        idle_.erase(it);
+        break;
+      }
+    }
+    // replace what was taken, or get one ready for next time after a cold start; a config
+    // seen for the first time may be a one-off and isn't worth a background open.
+    refill = known(config);
+    if (refill) {
+      remember(config);
+      pending_.push_back(config);
+    }
+  }
+  if (refill) {
+    wake_.notify_one();
+  }
+
+  if (c) {
+    return c;
+  }
+  LOGI("encoder pool: cold open");
+  return open_encoder(config, &c) < 0 ? nullptr : c;
+}
+
+void EncoderPool::release(const EncoderConfig &config, AVCodecContext *c, bool used) {
+  if (!c) {
+    return;
+  }
+  bool keep = true;
+  if (used) {
+    keep = c->codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH;
+    if (keep) {
+      avcodec_flush_buffers(c);
+    } else {
+      avcodec_free_context(&c);
+    }
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  // back through the pool once: from now on it is refilled like a warmed one.
+  remember(config);
+  if (keep) {
+    add_idle(config, c);
+  }
+}
+
+void EncoderPool::run() {
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    wake_.wait(guard, [this] { return stop_ || !pending_.empty(); });
+    if (stop_) {
+      return;
+    }
+    EncoderConfig config = pending_.front();
+    pending_.pop_front();
+    if (idle_count(config) >= MAX_IDLE) {
+      continue;
+    }
+
+    // avcodec_open2 runs unlocked, sessions can check out meanwhile.
+    guard.unlock();
+    AVCodecContext *c = nullptr;
+    int ret = open_encoder(config, &c);
+    guard.lock();
+    if (ret < 0) {
+      continue;
+    }
+    if (stop_) {
+      avcodec_free_context(&c);
+    } else {
+      add_idle(config, c);
+    }
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef AUDIO_ENCODER_ENCODER_POOL_H
+#define AUDIO_ENCODER_ENCODER_POOL_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+/** What an opened encoder context is keyed by. */
+struct EncoderConfig {
+  AVCodecID codec_id;
+  AVSampleFormat sample_fmt;
+  int sample_rate;
+  // native order channel layout.
+  uint64_t channel_mask;
+  int64_t bit_rate;
+  int profile;
+  // encoder by name ("libopus"), empty for the default encoder of codec_id.
+  std::string encoder;
+  // "key=value:key=value" AVOptions for avcodec_open2, generic or private to the encoder.
+  std::string options;
+  // the output format keeps the codec config out of band (AVFMT_GLOBALHEADER, .m4a): the encoder is
+  // opened with AV_CODEC_FLAG_GLOBAL_HEADER, so libfdk_aac emits raw AAC and an AudioSpecificConfig
+  // instead of ADTS, which can't carry LD / ELD.
+  bool global_header;
+
+  bool operator==(const EncoderConfig &o) const {
+    return codec_id == o.codec_id && sample_fmt == o.sample_fmt && sample_rate == o.sample_rate &&
+        channel_mask == o.channel_mask && bit_rate == o.bit_rate && profile == o.profile &&
+        encoder == o.encoder && options == o.options && global_header == o.global_header;
+  }
+};
+
+/** Allocates and opens an encoder for `config`, the time base is 1 / sample_rate. */
+int open_encoder(const EncoderConfig &config, AVCodecContext **out);
+
+/**
+ * Pre-opened encoder contexts, so a session doesn't pay for avcodec_open2 (for
+ * AAC that includes building its tables) before its first frame.
+ *
+ * acquire() hands out an idle context when there is one and, for a config
+ * that was warmed or released before, queues a background open to replace
+ * it. A context that was never fed goes back idle on release(); a used one is
+ * flushed and reused when the codec supports AV_CODEC_CAP_ENCODER_FLUSH,
+ * otherwise freed (the native AAC encoder can't be flushed, its replacement
+ * is already on the way). At most MAX_IDLE contexts are kept per config and
+ * MAX_IDLE_TOTAL overall, the least recently pooled one is freed first.
+ */
+class EncoderPool {
+ public:
+  static EncoderPool &get();
+
+  ~EncoderPool();
+
+  /** Opens `count` idle contexts for `config` on the pool thread. */
+  void warm(const EncoderConfig &config, int count);
+
+  /** Returns an opened context, null on failure. */
+  AVCodecContext *acquire(const EncoderConfig &config);
+
+  void release(const EncoderConfig &config, AVCodecContext *c, bool used);
+
+ private:
+  struct Idle {
+    EncoderConfig config;
+    AVCodecContext *ctx;
+  };
+
+  EncoderPool();
+
+  void run();
+  int idle_count(const EncoderConfig &config) const;
+  // marks `config` as worth refilling, most recent last.
+  void remember(const EncoderConfig &config);
+  bool known(const EncoderConfig &config) const;
+  // takes `c`: pooled under the per config and total limits, or freed.
+  void add_idle(const EncoderConfig &config, AVCodecContext *c);
+
+  std::mutex lock_;
+  std::condition_variable wake_;
+  // oldest first.
+  std::vector<Idle> idle_;
+  std::vector<EncoderConfig> known_;
+  // contexts to open in the background, one entry each.
+  std::deque<EncoderConfig> pending_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+#endif //AUDIO_ENCODER_ENCODER_POOL_H
@@ -0,0 +1,29 @@
+#ifndef AUDIO_ENCODER_ENCODER_SESSION_H
+#define AUDIO_ENCODER_ENCODER_SESSION_H
+
+#include <string>
+
+/**
+ * The encoder end of nativeEncode: takes the pre-encode chain's output, planar
+ * float at the input rate and layout, and leaves an encoded file behind.
+ *
+ * FfmpegSession encodes with libavcodec, MediaCodecSession with the device's
+ * MediaCodec encoder; the input, stage chain and cache around them are shared.
+ */
+class EncoderSession {
+ public:
+  virtual ~EncoderSession() = default;
+
+  /** The encoder, its version and setup, for the log. */
+  virtual std::string describe() const = 0;
+
+  /** Creates the output file, before the first write(). */
+  virtual int open(const char *path) = 0;
+
+  virtual int write(const float *const *planes, int nb_samples) = 0;
+
+  /** Encodes whatever is buffered, drains the encoder and completes the file. */
+  virtual int finish() = 0;
+};
+
+#endif //AUDIO_ENCODER_ENCODER_SESSION_H
@@ -0,0 +1,144 @@
+# Builds FFmpeg from source as static libraries trimmed to what this library
+# uses, included by CMakeLists.txt when FFMPEG_SOURCE_DIR is set.
+#
+# Compared to the prebuilt shared libraries: a single .so with no relocations
+# across four libraries at load time, only the AAC codec / ADTS + MP4 (de)muxers
+# linked in, and ThinLTO objects so the linker can inline FFmpeg's small helpers
+# (av_frame_*, av_audio_fifo_*, av_tx calls) into our code.
+#
+# Defines the avcodec / avformat / swresample / avutil targets and FFMPEG_INCLUDE_DIR.
+
+include(ExternalProject)
+
+if (CMAKE_ANDROID_ARCH_ABI STREQUAL "arm64-v8a")
+    set(FFMPEG_ARCH aarch64)
+    set(FFMPEG_CPU armv8-a)
+    set(FFMPEG_TRIPLE aarch64-linux-android)
+elseif (CMAKE_ANDROID_ARCH_ABI STREQUAL "x86_64")
+    set(FFMPEG_ARCH x86_64)
+    set(FFMPEG_CPU x86-64)
+    set(FFMPEG_TRIPLE x86_64-linux-android)
+else ()
+    message(FATAL_ERROR "FFmpeg source build: unsupported ABI ${CMAKE_ANDROID_ARCH_ABI}")
+endif ()
+
+set(FFMPEG_PREFIX ${CMAKE_CURRENT_BINARY_DIR}/ffmpeg-${CMAKE_ANDROID_ARCH_ABI})
+set(FFMPEG_INCLUDE_DIR ${FFMPEG_PREFIX}/include)
+set(FFMPEG_TARGET_FLAGS "--target=${FFMPEG_TRIPLE}${ANDROID_NATIVE_API_LEVEL}")
+
+set(FFMPEG_CONFIGURE_ARGS
+        --prefix=${FFMPEG_PREFIX}
+        --enable-cross-compile
+        --target-os=android
+        --arch=${FFMPEG_ARCH}
+        --cpu=${FFMPEG_CPU}
+        --cc=${CMAKE_C_COMPILER}
+        --cxx=${CMAKE_CXX_COMPILER}
+        --ar=${CMAKE_AR}
+        --ranlib=${CMAKE_RANLIB}
+        --nm=${CMAKE_NM}
+        --strip=${CMAKE_STRIP}
+        --sysroot=${CMAKE_SYSROOT}
+        "--extra-cflags=${FFMPEG_TARGET_FLAGS} -O3 -flto=thin -fPIC"
+        "--extra-ldflags=${FFMPEG_TARGET_FLAGS} -flto=thin"
+        --enable-static
+        --disable-shared
+        --enable-pic
+        --disable-autodetect
+        --disable-programs
+        --disable-doc
+        --disable-network
+        --disable-avdevice
+        --disable-avfilter
+        --disable-swscale
+        --disable-postproc
+        --disable-everything
+        --enable-encoder=aac,opus,flac
+        --enable-decoder=aac,opus,flac
+        --enable-parser=aac,opus,flac
+        --enable-demuxer=aac,mov,ogg,matroska,flac
+        --enable-muxer=adts,ipod,mp4,ogg,opus,webm
+        --enable-bsf=aac_adtstoasc
+        --enable-protocol=file)
+
+# libopus for the voice path (FFMPEG_LIBOPUS_DIR: an install prefix built for this ABI),
+# without it nativeEncode falls back to FFmpeg's native Opus encoder.
+set(FFMPEG_LIBOPUS_DIR "" CACHE PATH "libopus install prefix for the current ABI")
+set(FFMPEG_PKG_CONFIG_DIRS)
+if (FFMPEG_LIBOPUS_DIR)
+    list(APPEND FFMPEG_CONFIGURE_ARGS
+            --enable-libopus
+            --enable-encoder=libopus)
+    list(APPEND FFMPEG_PKG_CONFIG_DIRS ${FFMPEG_LIBOPUS_DIR}/lib/pkgconfig)
+endif ()
+
+# fdk-aac for the HE-AAC (v1 / v2) and AAC-LD / ELD profiles, the native encoder only does LC.
+# fdk-aac isn't GPL compatible, a build with it is nonfree and can't be redistributed.
+set(FFMPEG_FDK_AAC_DIR "" CACHE PATH "fdk-aac install prefix for the current ABI")
+if (FFMPEG_FDK_AAC_DIR)
+    list(APPEND FFMPEG_CONFIGURE_ARGS
+            --enable-nonfree
+            --enable-libfdk-aac
+            --enable-encoder=libfdk_aac)
+    list(APPEND FFMPEG_PKG_CONFIG_DIRS ${FFMPEG_FDK_AAC_DIR}/lib/pkgconfig)
+endif ()
+
+if (FFMPEG_PKG_CONFIG_DIRS)
+    list(APPEND FFMPEG_CONFIGURE_ARGS
+            --pkg-config=pkg-config
+            "--pkg-config-flags=--static")
+    string(REPLACE ";" ":" FFMPEG_PKG_CONFIG_LIBDIR "${FFMPEG_PKG_CONFIG_DIRS}")
+    set(FFMPEG_ENV ${CMAKE_COMMAND} -E env PKG_CONFIG_LIBDIR=${FFMPEG_PKG_CONFIG_LIBDIR})
+endif ()
+
+# x86 assembly needs nasm, the C fallbacks are used without it.
+if (FFMPEG_ARCH STREQUAL "x86_64")
+    find_program(NASM_EXECUTABLE nasm)
+    if (NOT NASM_EXECUTABLE)
+        list(APPEND FFMPEG_CONFIGURE_ARGS --disable-x86asm)
+    endif ()
+endif ()
+
+set(FFMPEG_LIBS avformat avcodec swresample avutil)
+set(FFMPEG_EXTRA_LIBS m)
+if (FFMPEG_LIBOPUS_DIR)
+    list(APPEND FFMPEG_EXTRA_LIBS ${FFMPEG_LIBOPUS_DIR}/lib/libopus.a)
+endif ()
+if (FFMPEG_FDK_AAC_DIR)
+    list(APPEND FFMPEG_EXTRA_LIBS ${FFMPEG_FDK_AAC_DIR}/lib/libfdk-aac.a)
+endif ()
+set(FFMPEG_BYPRODUCTS)
+foreach (lib ${FFMPEG_LIBS})
+    list(APPEND FFMPEG_BYPRODUCTS ${FFMPEG_PREFIX}/lib/lib${lib}.a)
+endforeach ()
+
+include(ProcessorCount)
+ProcessorCount(FFMPEG_JOBS)
+if (FFMPEG_JOBS EQUAL 0)
+    set(FFMPEG_JOBS 1)
+endif ()
+
+ExternalProject_Add(ffmpeg_build
+        SOURCE_DIR ${FFMPEG_SOURCE_DIR}
+        BINARY_DIR ${CMAKE_CURRENT_BINARY_DIR}/ffmpeg-build-${CMAKE_ANDROID_ARCH_ABI}
+        CONFIGURE_COMMAND ${FFMPEG_ENV} ${FFMPEG_SOURCE_DIR}/configure ${FFMPEG_CONFIGURE_ARGS}
+        BUILD_COMMAND make -j${FFMPEG_JOBS}
+        INSTALL_COMMAND make install
+        BUILD_BYPRODUCTS ${FFMPEG_BYPRODUCTS})
+
+# must exist at configure time for INTERFACE_INCLUDE_DIRECTORIES.
+file(MAKE_DIRECTORY ${FFMPEG_INCLUDE_DIR})
+
+foreach (lib ${FFMPEG_LIBS})
+    add_library(${lib} STATIC IMPORTED)
+    set_target_properties(${lib}
+            PROPERTIES IMPORTED_LOCATION
+            ${FFMPEG_PREFIX}/lib/lib${lib}.a)
+    add_dependencies(${lib} ffmpeg_build)
+endforeach ()
+
+# static archives have to be linked in dependency order, whatever order they are listed in.
+set_target_properties(avformat PROPERTIES INTERFACE_LINK_LIBRARIES "avcodec;avutil")
+set_target_properties(swresample PROPERTIES INTERFACE_LINK_LIBRARIES "avutil")
+set_target_properties(avcodec PROPERTIES INTERFACE_LINK_LIBRARIES "swresample;avutil;${FFMPEG_EXTRA_LIBS}")
+set_target_properties(avutil PROPERTIES INTERFACE_LINK_LIBRARIES "m")
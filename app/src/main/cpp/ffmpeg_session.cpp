@@ -0,0 +1,375 @@
+#include "ffmpeg_session.h"
+#include "adts.h"
+#include "base.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/samplefmt.h"
+}
+
+/**
+ * .aac output of an encoder with an AudioSpecificConfig: its raw packets are
+ * framed by AdtsPacketizer and written straight to the file, no muxer.
+ */
+struct AdtsOutput {
+  std::unique_ptr<AdtsPacketizer> packetizer;
+  FILE *file = nullptr;
+
+  ~AdtsOutput() {
+    close();
+  }
+
+  int open(const char *path, const AVCodecParameters *par) {
+    AdtsConfig config;
+    if (adts_config_from_asc(par->extradata, par->extradata_size, &config) < 0) {
+      return AVERROR(EINVAL);
+    }
+    file = fopen(path, "wb");
+    if (!file) {
+      LOGE("open output file %s failed.", path);
+      return AVERROR(errno);
+    }
+    packetizer = std::make_unique<AdtsPacketizer>(config);
+    return 0;
+  }
+
+  int write(const AVPacket *pkt) {
+    int size = 0;
+    const uint8_t *data = packetizer->packetize(pkt->data, pkt->size, &size);
+    if (!data) {
+      return AVERROR(EINVAL);
+    }
+    return fwrite(data, 1, (size_t)size, file) == (size_t)size ? 0 : AVERROR(EIO);
+  }
+
+  int close() {
+    int ret = 0;
+    if (file && fclose(file) != 0) {
+      ret = AVERROR(EIO);
+    }
+    file = nullptr;
+    return ret;
+  }
+};
+
+// packets go to `adts` when it is open, through the muxer otherwise. 0 or the first error.
+static int encode(AVCodecContext* c, AVFrame* frame, AVPacket* pkt, AVStream* stream, AVFormatContext* format_context,
+            AdtsOutput *adts) {
+  int ret = avcodec_send_frame(c, frame);
+  if (ret < 0) {
+    LOGE("avcodec_send_frame error, reason: %s", av_err2str(ret));
+    return ret;
+  }
+
+  while (ret >= 0) {
+    ret = avcodec_receive_packet(c, pkt);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+      return 0;
+    } else if (ret < 0) {
+      LOGE("avcodec_receive_packet error, reason: %s", av_err2str(ret));
+      return ret;
+    }
+    pkt->stream_index = stream->index;
+
+    //convert time_base
+    av_packet_rescale_ts(pkt, c->time_base, stream->time_base);
+    //write file.
+    ret = adts->file ? adts->write(pkt) : av_interleaved_write_frame(format_context, pkt);
+    av_packet_unref(pkt);
+    if (ret < 0) {
+      LOGE("write packet error, reason: %s", av_err2str(ret));
+      return ret;
+    }
+  }
+  return 0;
+}
+
+static void print_support_format(const AVCodec *codec)  {
+  // 打印编码器支持的采样格式
+  LOGI("Supported sample formats:");
+  const enum AVSampleFormat *p = codec->sample_fmts;
+  if (p) {
+    while (*p != AV_SAMPLE_FMT_NONE) {
+      LOGI("  %s", av_get_sample_fmt_name(*p));
+      p++;
+    }
+  }
+
+// 打印支持的采样率
+  LOGI("Supported sample rates:");
+  if (codec->supported_samplerates) {
+    int i = 0;
+    while (codec->supported_samplerates[i] != 0) {
+      LOGI("  %d", codec->supported_samplerates[i]);
+      i++;
+    }
+  }
+
+// 打印支持的通道布局
+  LOGI("Supported channel layouts:");
+  if (codec->ch_layouts) {
+    int i = 0;
+    while (codec->ch_layouts[i].nb_channels != 0) {
+      char buf[256];
+      av_channel_layout_describe(&codec->ch_layouts[i], buf, sizeof(buf));
+      LOGI("  %s", buf);
+      i++;
+    }
+  }
+}
+
+std::unique_ptr<FfmpegSession> FfmpegSession::create(const EncoderConfig &config, int sample_rate,
+                                                     const AVChannelLayout *layout, ResampleQuality quality) {
+  AVCodecContext *c = EncoderPool::get().acquire(config);
+  if (!c) {
+    LOGE("open encoder failed.");
+    return nullptr;
+  }
+  //打印支持的格式
+  print_support_format(c->codec);
+  std::unique_ptr<FfmpegSession> session(new FfmpegSession(config, c, sample_rate, layout, quality));
+  LOGI("ffmpeg: %s", session->describe().c_str());
+  return session;
+}
+
+FfmpegSession::FfmpegSession(const EncoderConfig &config, AVCodecContext *c, int sample_rate,
+                             const AVChannelLayout *layout, ResampleQuality quality)
+    : config_(config), c_(c), sample_rate_(sample_rate), quality_(quality) {
+  av_channel_layout_copy(&layout_, layout);
+}
+
+FfmpegSession::~FfmpegSession() {
+  av_audio_fifo_free(fifo_);
+  swr_free(&swr_);
+  if (conv_) {
+    av_freep(&conv_[0]);
+    av_freep(&conv_);
+  }
+  av_frame_free(&frame_);
+  av_packet_free(&pkt_);
+  adts_.reset();
+  if (format_context_) {
+    if (!(format_context_->oformat->flags & AVFMT_NOFILE)) {
+      avio_closep(&format_context_->pb);
+    }
+    avformat_free_context(format_context_);
+  }
+  EncoderPool::get().release(config_, c_, used_);
+  av_channel_layout_uninit(&layout_);
+}
+
+std::string FfmpegSession::describe() const {
+  char layout[64];
+  av_channel_layout_describe(&c_->ch_layout, layout, sizeof(layout));
+  char config[256];
+  snprintf(config, sizeof(config), "%s %s %d %s %lld %d", LIBAVCODEC_IDENT, c_->codec->name, c_->sample_rate,
+           layout, (long long)c_->bit_rate, c_->profile);
+  std::string desc = config;
+  if (c_->sample_rate != sample_rate_) {
+    desc += " resample " + std::to_string(quality_);
+  }
+  return desc;
+}
+
+int FfmpegSession::open(const char *out_file) {
+  AVCodecContext *c = c_;
+  //分配输出格式
+  int ret = avformat_alloc_output_context2(&format_context_, nullptr, nullptr, out_file);
+  if (!format_context_) {
+    LOGE("avformat_alloc_output_context2 failed");
+    return ret < 0 ? ret : AVERROR(ENOMEM);
+  }
+
+  const AVOutputFormat *ofmt = format_context_->oformat;
+
+  //创建音频流
+  stream_ = avformat_new_stream(format_context_, nullptr);
+  if (!stream_) {
+    LOGE("avformat_new_stream failed.");
+    return AVERROR(ENOMEM);
+  }
+
+  // Set the time base before copying parameters
+  stream_->time_base = (AVRational){1, c->sample_rate};
+  c->time_base = stream_->time_base;
+
+  //将编码器参数复制到流
+  ret = avcodec_parameters_from_context(stream_->codecpar, c);
+  if (ret < 0) {
+    LOGE("avcodec_parameters_from_context failed, ret:%d", ret);
+    return ret;
+  }
+
+  /**  packet for holding encoded output. **/
+  pkt_ = av_packet_alloc();
+  /** frame containing input raw audio. **/
+  frame_ = av_frame_alloc();
+
+  if (!pkt_ || !frame_) {
+    LOGE("av_packet or av_frame alloc failed.");
+    return AVERROR(ENOMEM);
+  }
+
+  frame_->nb_samples = c->frame_size;
+  frame_->format = c->sample_fmt;
+  av_channel_layout_copy(&frame_->ch_layout, &c->ch_layout);
+
+  /**  分配缓冲区数据 **/
+  ret = av_frame_get_buffer(frame_, 0);
+  if (ret < 0) {
+    LOGE("alloc frame buffer failed.");
+    return ret;
+  }
+
+  fifo_ = av_audio_fifo_alloc(c->sample_fmt, c->ch_layout.nb_channels, c->frame_size * 2);
+  if (!fifo_) {
+    LOGE("av_audio_fifo_alloc failed.");
+    return AVERROR(ENOMEM);
+  }
+
+  // a rate change on the shared filter banks, swr only for the ratios that have none.
+  int swr_rate = sample_rate_;
+  if (c->sample_rate != sample_rate_) {
+    resampler_ = Resampler::create(sample_rate_, c->sample_rate, layout_.nb_channels, quality_);
+    if (resampler_) {
+      swr_rate = c->sample_rate;
+    }
+  }
+  // only when the encoder doesn't take the input as is: opus, S16, a layout override or an odd rate.
+  if (c->sample_fmt != AV_SAMPLE_FMT_FLTP || c->sample_rate != swr_rate ||
+      av_channel_layout_compare(&c->ch_layout, &layout_) != 0) {
+    ret = swr_alloc_set_opts2(&swr_, &c->ch_layout, c->sample_fmt, c->sample_rate,
+                              &layout_, AV_SAMPLE_FMT_FLTP, swr_rate, 0, nullptr);
+    if (ret < 0 || (ret = swr_init(swr_)) < 0) {
+      LOGE("swr_init failed");
+      return ret;
+    }
+  }
+
+  // .aac: the header fields come from the encoder's AudioSpecificConfig. An encoder without one
+  // (libfdk_aac opened without a global header) frames its packets itself, the muxer passes them through.
+  adts_ = std::make_unique<AdtsOutput>();
+  if (!strcmp(ofmt->name, "adts") && stream_->codecpar->extradata_size > 0) {
+    ret = adts_->open(out_file, stream_->codecpar);
+    if (ret < 0) {
+      LOGE("adts output failed, ret: %d", ret);
+      return ret;
+    }
+    return 0;
+  }
+
+  if (!(ofmt->flags & AVFMT_NOFILE)) {
+    ret = avio_open(&format_context_->pb, out_file, AVIO_FLAG_WRITE);
+    if (ret < 0) {
+      LOGE("open output file failed.");
+      return ret;
+    }
+  }
+
+  //write file header.
+  ret = avformat_write_header(format_context_,  nullptr);
+  if (ret < 0) {
+    LOGE("av_format_write_header failed.");
+    return ret;
+  }
+  return 0;
+}
+
+int FfmpegSession::write(const float *const *planes, int nb_samples) {
+  if (resampler_) {
+    nb_samples = resampler_->process(planes, nb_samples);
+    planes = resampler_->output();
+  }
+  return convert(planes, nb_samples);
+}
+
+int FfmpegSession::convert(const float *const *planes, int nb_samples) {
+  const uint8_t **data = (const uint8_t **)planes;
+  int ret;
+  if (!swr_) {
+    ret = av_audio_fifo_write(fifo_, (void **)data, nb_samples);
+  } else {
+    // what doesn't fit stays buffered in swr until the next call.
+    int out_samples = swr_get_out_samples(swr_, nb_samples);
+    if (out_samples > conv_samples_) {
+      if (conv_) {
+        av_freep(&conv_[0]);
+        av_freep(&conv_);
+      }
+      ret = av_samples_alloc_array_and_samples(&conv_, nullptr, c_->ch_layout.nb_channels, out_samples,
+                                               c_->sample_fmt, 0);
+      if (ret < 0) {
+        LOGE("alloc resample buffer failed.");
+        return ret;
+      }
+      conv_samples_ = out_samples;
+    }
+    int n = swr_convert(swr_, conv_, conv_samples_, data, nb_samples);
+    ret = n < 0 ? n : av_audio_fifo_write(fifo_, (void **)conv_, n);
+  }
+  return ret < 0 ? ret : drain(false);
+}
+
+int FfmpegSession::drain(bool last) {
+  AVCodecContext *c = c_;
+  while (av_audio_fifo_size(fifo_) >= (last ? 1 : c->frame_size)) {
+    int err = av_frame_make_writable(frame_);
+    if (err < 0) {
+      LOGE("av_frame_make_writable failed, ret: %d", err);
+      return err;
+    }
+
+    int got = av_audio_fifo_read(fifo_, (void **)frame_->extended_data, c->frame_size);
+    if (got < frame_->nb_samples) {
+      LOGE("per frame not enough.");
+      av_samples_set_silence(frame_->extended_data, got, frame_->nb_samples - got,
+                             c->ch_layout.nb_channels, c->sample_fmt);
+    }
+
+    frame_->pts = pts_;
+    pts_ += frame_->nb_samples;
+
+    used_ = true;
+    err = encode(c, frame_, pkt_, stream_, format_context_, adts_.get());
+    if (err < 0) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+int FfmpegSession::finish() {
+  int ret = 0;
+  // the resamplers' filter tails, then whatever is left as a last short frame.
+  if (resampler_) {
+    int n = resampler_->flush();
+    ret = convert(resampler_->output(), n);
+  }
+  if (ret >= 0 && swr_ && conv_) {
+    int n;
+    while (ret >= 0 && (n = swr_convert(swr_, conv_, conv_samples_, nullptr, 0)) > 0) {
+      ret = av_audio_fifo_write(fifo_, (void **)conv_, n);
+    }
+  }
+  if (ret >= 0) {
+    ret = drain(true);
+  }
+
+  // send null to encode, flush. the trailer is written and the file closed even after an error.
+  used_ = true;
+  int flush_ret = encode(c_, nullptr, pkt_, stream_, format_context_, adts_.get());
+  if (ret >= 0) {
+    ret = flush_ret;
+  }
+  int trailer_ret = adts_->file ? adts_->close() : av_write_trailer(format_context_);
+  if (!(format_context_->oformat->flags & AVFMT_NOFILE)) {
+    avio_closep(&format_context_->pb);
+  }
+  return ret < 0 ? ret : trailer_ret;
+}
@@ -0,0 +1,79 @@
+#ifndef AUDIO_ENCODER_FFMPEG_SESSION_H
+#define AUDIO_ENCODER_FFMPEG_SESSION_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "encoder_pool.h"
+#include "encoder_session.h"
+#include "resampler.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/audio_fifo.h"
+#include "libavutil/channel_layout.h"
+#include <libswresample/swresample.h>
+}
+
+struct AdtsOutput;
+
+/**
+ * libavcodec encoder from EncoderPool plus libavformat muxer (or the native
+ * ADTS packetizer for .aac).
+ *
+ * input -> (Resampler) -> (swr) -> fifo -> codec sized frames: a rate change
+ * runs on the polyphase Resampler, swr only converts what the encoder doesn't
+ * take as is (opus, S16 for libfdk_aac, a layout override) and resamples the
+ * odd rate pair the Resampler has no bank for. The fifo absorbs the difference
+ * between block and frame size.
+ */
+class FfmpegSession : public EncoderSession {
+ public:
+  /** Takes an encoder for `config` from the pool, null when none could be opened. */
+  static std::unique_ptr<FfmpegSession> create(const EncoderConfig &config, int sample_rate,
+                                               const AVChannelLayout *layout,
+                                               ResampleQuality quality = RESAMPLE_MEDIUM);
+
+  ~FfmpegSession() override;
+
+  std::string describe() const override;
+
+  int open(const char *path) override;
+
+  int write(const float *const *planes, int nb_samples) override;
+
+  int finish() override;
+
+ private:
+  FfmpegSession(const EncoderConfig &config, AVCodecContext *c, int sample_rate, const AVChannelLayout *layout,
+                ResampleQuality quality);
+
+  // codec rate input -> fifo -> codec.
+  int convert(const float *const *planes, int nb_samples);
+
+  // codec sized frames out of the fifo; with `last` the short tail too, zero padded.
+  int drain(bool last);
+
+  EncoderConfig config_;
+  AVCodecContext *c_;
+  int sample_rate_;
+  AVChannelLayout layout_ = {};
+  ResampleQuality quality_;
+  // the context went through avcodec_send_frame and can't go back to the pool as is.
+  bool used_ = false;
+
+  AVFormatContext *format_context_ = nullptr;
+  AVStream *stream_ = nullptr;
+  std::unique_ptr<AdtsOutput> adts_;
+  AVPacket *pkt_ = nullptr;
+  AVFrame *frame_ = nullptr;
+  AVAudioFifo *fifo_ = nullptr;
+  std::unique_ptr<Resampler> resampler_;
+  SwrContext *swr_ = nullptr;
+  uint8_t **conv_ = nullptr;
+  int conv_samples_ = 0;
+  int64_t pts_ = 0;
+};
+
+#endif //AUDIO_ENCODER_FFMPEG_SESSION_H
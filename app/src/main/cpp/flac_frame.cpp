@@ -0,0 +1,65 @@
+#include "flac_frame.h"
+
+extern "C" {
+#include "libavutil/bswap.h"
+#include "libavutil/crc.h"
+#include "libavutil/error.h"
+}
+
+// length of the coded number starting with `first`.
+static int utf8_size(uint8_t first) {
+  if (first < 0x80) {
+    return 1;
+  }
+  int n = 0;
+  while (n < 8 && (first & (0x80 >> n))) {
+    n++;
+  }
+  return n;
+}
+
+int flac_put_utf8(uint8_t *dst, uint64_t v) {
+  if (v < 0x80) {
+    dst[0] = (uint8_t)v;
+    return 1;
+  }
+  // n bytes carry 5 * n + 1 bits.
+  int n = 2;
+  while (v >> (5 * n + 1)) {
+    n++;
+  }
+  dst[0] = (uint8_t)((0xFF00 >> n) | (v >> (6 * (n - 1))));
+  for (int i = 1; i < n; i++) {
+    dst[i] = (uint8_t)(0x80 | ((v >> (6 * (n - 1 - i))) & 0x3F));
+  }
+  return n;
+}
+
+int flac_renumber_frame(const uint8_t *frame, int size, uint64_t number, std::vector<uint8_t> *out) {
+  if (size < 8 || frame[0] != 0xFF || (frame[1] & 0xFE) != 0xF8) {
+    return AVERROR_INVALIDDATA;
+  }
+  int bs_code = frame[2] >> 4;
+  int sr_code = frame[2] & 0xF;
+  int old_number = utf8_size(frame[4]);
+  // explicit block size / sample rate that follow the frame number.
+  int extra = (bs_code == 6 ? 1 : bs_code == 7 ? 2 : 0) + (sr_code == 12 ? 1 : sr_code == 13 || sr_code == 14 ? 2 : 0);
+  int body = 4 + old_number + extra + 1;
+  if (body + 2 > size) {
+    return AVERROR_INVALIDDATA;
+  }
+
+  size_t begin = out->size();
+  uint8_t number_buf[8];
+  int number_size = flac_put_utf8(number_buf, number);
+  out->insert(out->end(), frame, frame + 4);
+  out->insert(out->end(), number_buf, number_buf + number_size);
+  out->insert(out->end(), frame + 4 + old_number, frame + 4 + old_number + extra);
+  out->push_back((uint8_t)av_crc(av_crc_get_table(AV_CRC_8_ATM), 0, out->data() + begin, out->size() - begin));
+  // subframes start byte aligned after the header, they are copied untouched.
+  out->insert(out->end(), frame + body, frame + size - 2);
+  uint16_t crc = (uint16_t)av_crc(av_crc_get_table(AV_CRC_16_ANSI), 0, out->data() + begin, out->size() - begin);
+  out->push_back((uint8_t)(av_bswap16(crc) >> 8));
+  out->push_back((uint8_t)av_bswap16(crc));
+  return (int)(out->size() - begin);
+}
@@ -0,0 +1,19 @@
+#ifndef AUDIO_ENCODER_FLAC_FRAME_H
+#define AUDIO_ENCODER_FLAC_FRAME_H
+
+#include <stdint.h>
+#include <vector>
+
+/** FLAC's UTF-8 like coding of a frame number, up to 7 bytes into `dst`. Returns its length. */
+int flac_put_utf8(uint8_t *dst, uint64_t v);
+
+/**
+ * Appends the FLAC frame `frame` to `out` as frame `number`: the frame number
+ * is rewritten and the header CRC-8 and frame CRC-16 recomputed, the
+ * subframes are copied as they are. Returns the new frame size,
+ * AVERROR_INVALIDDATA when `frame` doesn't start with a fixed block size
+ * frame header.
+ */
+int flac_renumber_frame(const uint8_t *frame, int size, uint64_t number, std::vector<uint8_t> *out);
+
+#endif //AUDIO_ENCODER_FLAC_FRAME_H
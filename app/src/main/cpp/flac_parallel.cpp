@@ -0,0 +1,216 @@
+#include "flac_parallel.h"
+#include "base.h"
+#include "encoder_pool.h"
+#include "flac_frame.h"
+#include "worker_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+}
+
+// samples per frame, fixed so run boundaries fall on frame boundaries.
+#define FLAC_BLOCK 4096
+// a run is at least this many frames, below that opening an encoder costs more than it saves.
+#define MIN_RUN_FRAMES 64
+#define STREAMINFO_SIZE 34
+
+struct FlacRun {
+  int64_t first_frame;
+  int64_t start;
+  int64_t end;
+  // renumbered frames back to back, and the size of each.
+  std::vector<uint8_t> data;
+  std::vector<uint32_t> frame_sizes;
+  int ret = 0;
+  bool done = false;
+};
+
+static int receive_frames(AVCodecContext *c, AVPacket *pkt, FlacRun *run) {
+  int ret;
+  while ((ret = avcodec_receive_packet(c, pkt)) >= 0) {
+    // the flush packet only carries the updated STREAMINFO as side data, we write our own.
+    if (pkt->size > 0) {
+      int64_t number = run->first_frame + (int64_t)run->frame_sizes.size();
+      ret = flac_renumber_frame(pkt->data, pkt->size, number, &run->data);
+      if (ret < 0) {
+        av_packet_unref(pkt);
+        return ret;
+      }
+      run->frame_sizes.push_back((uint32_t)ret);
+    }
+    av_packet_unref(pkt);
+  }
+  return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+static void encode_run(const EncoderConfig &config, const int16_t *pcm, int channels, FlacRun *run) {
+  AVCodecContext *c = nullptr;
+  AVPacket *pkt = av_packet_alloc();
+  AVFrame *frame = av_frame_alloc();
+  int ret = open_encoder(config, &c);
+  if (ret < 0 || !pkt || !frame) {
+    run->ret = ret < 0 ? ret : AVERROR(ENOMEM);
+    goto end;
+  }
+
+  frame->nb_samples = FLAC_BLOCK;
+  frame->format = c->sample_fmt;
+  av_channel_layout_copy(&frame->ch_layout, &c->ch_layout);
+  if ((ret = av_frame_get_buffer(frame, 0)) < 0) {
+    run->ret = ret;
+    goto end;
+  }
+
+  for (int64_t pos = run->start; pos < run->end; pos += FLAC_BLOCK) {
+    if ((ret = av_frame_make_writable(frame)) < 0) {
+      break;
+    }
+    // only the last frame of the stream is short.
+    frame->nb_samples = (int)std::min<int64_t>(FLAC_BLOCK, run->end - pos);
+    memcpy(frame->data[0], pcm + pos * channels, (size_t)frame->nb_samples * channels * sizeof(int16_t));
+    frame->pts = pos - run->start;
+    if ((ret = avcodec_send_frame(c, frame)) < 0 || (ret = receive_frames(c, pkt, run)) < 0) {
+      break;
+    }
+  }
+  if (ret >= 0 && (ret = avcodec_send_frame(c, nullptr)) >= 0) {
+    ret = receive_frames(c, pkt, run);
+  }
+  run->ret = ret < 0 ? ret : 0;
+
+end:
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+  avcodec_free_context(&c);
+}
+
+// "fLaC" and the STREAMINFO block, rewritten at the end once frame sizes and MD5 are known.
+static void put_header(uint8_t *header, int64_t nb_samples, int sample_rate, int channels, uint32_t min_frame,
+                       uint32_t max_frame, const uint8_t *md5) {
+  memcpy(header, "fLaC", 4);
+  // last metadata block, type 0 (STREAMINFO).
+  header[4] = 0x80;
+  AV_WB24(header + 5, STREAMINFO_SIZE);
+  uint8_t *si = header + 8;
+  // the minimum leaves out the last frame, the only short one.
+  AV_WB16(si, FLAC_BLOCK);
+  AV_WB16(si + 2, FLAC_BLOCK);
+  AV_WB24(si + 4, min_frame);
+  AV_WB24(si + 7, max_frame);
+  // sample rate (20 bits), channels - 1 (3), bits per sample - 1 (5), total samples (36).
+  AV_WB64(si + 10, (uint64_t)sample_rate << 44 | (uint64_t)(channels - 1) << 41 | (uint64_t)(16 - 1) << 36 |
+                   ((uint64_t)nb_samples & 0xFFFFFFFFFULL));
+  memcpy(si + 18, md5, 16);
+}
+
+int encode_flac_parallel(const int16_t *pcm, int64_t nb_samples, int sample_rate, const AVChannelLayout *layout,
+                         int compression_level, int threads, const char *path) {
+  if (nb_samples <= 0) {
+    LOGE("flac: no input samples.");
+    return AVERROR(EINVAL);
+  }
+  const int channels = layout->nb_channels;
+  EncoderConfig config = {};
+  config.codec_id = AV_CODEC_ID_FLAC;
+  config.sample_fmt = AV_SAMPLE_FMT_S16;
+  config.sample_rate = sample_rate;
+  config.channel_mask = layout->u.mask;
+  config.profile = AV_PROFILE_UNKNOWN;
+  config.options = "compression_level=" + std::to_string(compression_level) +
+      ":frame_size=" + std::to_string(FLAC_BLOCK);
+
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    LOGE("open output file failed.");
+    return -1;
+  }
+  uint8_t header[4 + 4 + STREAMINFO_SIZE];
+  uint8_t md5[16] = {0};
+  put_header(header, nb_samples, sample_rate, channels, 0, 0, md5);
+  int ret = fwrite(header, 1, sizeof(header), file) == sizeof(header) ? 0 : -1;
+
+  std::vector<FlacRun> runs;
+  std::mutex lock;
+  std::condition_variable done;
+  // declared last: its destructor finishes the queued runs before anything they use goes away.
+  WorkerPool pool(threads);
+  const int64_t nb_frames = (nb_samples + FLAC_BLOCK - 1) / FLAC_BLOCK;
+  int64_t nb_runs = std::min<int64_t>((nb_frames + MIN_RUN_FRAMES - 1) / MIN_RUN_FRAMES, pool.size() * 2);
+  nb_runs = std::max<int64_t>(nb_runs, 1);
+  const int64_t run_frames = std::max<int64_t>((nb_frames + nb_runs - 1) / nb_runs, 1);
+
+  for (int64_t first = 0; first < nb_frames; first += run_frames) {
+    FlacRun run;
+    run.first_frame = first;
+    run.start = first * FLAC_BLOCK;
+    run.end = std::min(nb_samples, (first + run_frames) * FLAC_BLOCK);
+    runs.push_back(std::move(run));
+  }
+  // the MD5 of the source samples, little endian interleaved, is just the input bytes.
+  pool.submit([&md5, pcm, nb_samples, channels] {
+    av_md5_sum(md5, (const uint8_t *)pcm, (size_t)nb_samples * channels * sizeof(int16_t));
+  });
+  for (FlacRun &run : runs) {
+    FlacRun *r = &run;
+    pool.submit([&, r] {
+      encode_run(config, pcm, channels, r);
+      std::lock_guard<std::mutex> guard(lock);
+      r->done = true;
+      done.notify_all();
+    });
+  }
+
+  // each run is written and freed as soon as the ones before it are out, later ones still encoding.
+  uint32_t min_frame = 0;
+  uint32_t max_frame = 0;
+  for (FlacRun &run : runs) {
+    if (ret < 0) {
+      break;
+    }
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      done.wait(guard, [&run] { return run.done; });
+    }
+    if (run.ret < 0) {
+      LOGE("flac run at frame %lld failed, reason: %s", (long long)run.first_frame, av_err2str(run.ret));
+      ret = run.ret;
+      break;
+    }
+    if (fwrite(run.data.data(), 1, run.data.size(), file) != run.data.size()) {
+      ret = -1;
+    }
+    for (uint32_t size : run.frame_sizes) {
+      min_frame = min_frame ? std::min(min_frame, size) : size;
+      max_frame = std::max(max_frame, size);
+    }
+    std::vector<uint8_t>().swap(run.data);
+  }
+  pool.wait();
+
+  if (ret == 0) {
+    put_header(header, nb_samples, sample_rate, channels, min_frame, max_frame, md5);
+    if (fseek(file, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+      ret = -1;
+    }
+  }
+  if (fclose(file) != 0 && ret == 0) {
+    ret = -1;
+  }
+  if (ret < 0) {
+    LOGE("write %s failed.", path);
+    remove(path);
+    return ret;
+  }
+  LOGI("flac: %lld frames in %zu runs on %d threads", (long long)nb_frames, runs.size(), pool.size());
+  return 0;
+}
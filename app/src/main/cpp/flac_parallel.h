@@ -0,0 +1,26 @@
+#ifndef AUDIO_ENCODER_FLAC_PARALLEL_H
+#define AUDIO_ENCODER_FLAC_PARALLEL_H
+
+#include <stdint.h>
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+}
+
+/**
+ * Lossless archive of interleaved S16 input as a native .flac file, using every core.
+ *
+ * FLAC frames are independent, so the input is cut into runs of whole frames
+ * that a WorkerPool encodes with one libavcodec FLAC encoder each. Every run
+ * numbers its frames from 0; they are renumbered in place (frame number, header
+ * CRC-8, frame CRC-16) and each run is written and freed as soon as it is its
+ * turn, behind a STREAMINFO block built here and filled in at the end with
+ * the MD5 of the whole input, computed alongside the encode.
+ *
+ * `compression_level` is FFmpeg's 0..12, `threads` 0 means one per core.
+ * Returns 0 or < 0 on error, empty input included; a failed file is removed.
+ */
+int encode_flac_parallel(const int16_t *pcm, int64_t nb_samples, int sample_rate, const AVChannelLayout *layout,
+                         int compression_level, int threads, const char *path);
+
+#endif //AUDIO_ENCODER_FLAC_PARALLEL_H
@@ -0,0 +1,87 @@
+#include <dlfcn.h>
+#include <jni.h>
+#include <time.h>
+#include <mutex>
+#include "base.h"
+#include "core_api.h"
+
+struct Core {
+  void *handle = nullptr;
+  audio_core_encode_fn encode = nullptr;
+  audio_core_encode_ladder_fn encode_ladder = nullptr;
+  audio_core_decode_fn decode = nullptr;
+  audio_core_scan_fn scan = nullptr;
+};
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// loads the core (and FFmpeg with it) on first use, null if that failed.
+static const Core *load_core() {
+  static Core core;
+  static std::once_flag once;
+  std::call_once(once, [] {
+    double start = now_ms();
+    void *handle = dlopen(AUDIO_CORE_LIBRARY, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+      LOGE("dlopen %s failed: %s", AUDIO_CORE_LIBRARY, dlerror());
+      return;
+    }
+    auto init = (audio_core_init_fn)dlsym(handle, "audio_core_init");
+    core.encode = (audio_core_encode_fn)dlsym(handle, "audio_core_encode");
+    core.encode_ladder = (audio_core_encode_ladder_fn)dlsym(handle, "audio_core_encode_ladder");
+    core.decode = (audio_core_decode_fn)dlsym(handle, "audio_core_decode");
+    core.scan = (audio_core_scan_fn)dlsym(handle, "audio_core_scan");
+    if (!init || !core.encode || !core.encode_ladder || !core.decode || !core.scan) {
+      LOGE("%s is missing entry points.", AUDIO_CORE_LIBRARY);
+      dlclose(handle);
+      core = Core();
+      return;
+    }
+    init();
+    core.handle = handle;
+    LOGI("%s loaded in %.2f ms", AUDIO_CORE_LIBRARY, now_ms() - start);
+  });
+  return core.handle ? &core : nullptr;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_soundvision_audio_1encoder_MainActivity_nativePrewarm(JNIEnv *env, jobject thiz) {
+  return load_core() ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_soundvision_audio_1encoder_MainActivity_nativeEncode(JNIEnv *env, jobject thiz, jobject mgr, jstring dest,
+                                                              jstring options) {
+  const Core *core = load_core();
+  return core ? core->encode(env, thiz, mgr, dest, options) : -1;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_soundvision_audio_1encoder_MainActivity_nativeEncodeLadder(JNIEnv *env, jobject thiz, jobject mgr,
+                                                                    jobjectArray dests, jstring options,
+                                                                    jobjectArray variants) {
+  const Core *core = load_core();
+  return core ? core->encode_ladder(env, thiz, mgr, dests, options, variants) : -1;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_soundvision_audio_1encoder_MainActivity_nativeDecode(JNIEnv *env, jobject thiz, jstring input_path,
+                                                              jstring output_path, jstring options) {
+  const Core *core = load_core();
+  return core ? core->decode(env, thiz, input_path, output_path, options) : -1;
+}
+
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_soundvision_audio_1encoder_MainActivity_nativeScan(JNIEnv *env, jobject thiz, jobjectArray paths) {
+  const Core *core = load_core();
+  return core ? core->scan(env, thiz, paths) : nullptr;
+}
@@ -0,0 +1,312 @@
+#include "loudness.h"
+#include "base.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+#define TP_PHASES 4
+#define TP_TAPS 12
+static_assert(TRUE_PEAK_DELAY == TP_TAPS / 2, "the interpolator is centred on tap TP_TAPS / 2");
+#define ABSOLUTE_GATE (-70.0)
+#define ST_SUB_BLOCKS 30
+
+static double energy_to_lufs(double energy) {
+  return -0.691 + 10.0 * log10(energy);
+}
+
+static double lufs_to_energy(double lufs) {
+  return pow(10.0, (lufs + 0.691) / 10.0);
+}
+
+static double to_db(double v) {
+  return v > 0.0 ? 20.0 * log10(v) : -INFINITY;
+}
+
+// BS.1770 channel weights: surrounds count +1.5 dB, LFE not at all.
+static float channel_weight(const AVChannelLayout *layout, int index) {
+  switch (av_channel_layout_channel_from_index(layout, index)) {
+    case AV_CHAN_LOW_FREQUENCY:
+    case AV_CHAN_LOW_FREQUENCY_2:
+      return 0.0f;
+    case AV_CHAN_SIDE_LEFT:
+    case AV_CHAN_SIDE_RIGHT:
+    case AV_CHAN_BACK_LEFT:
+    case AV_CHAN_BACK_RIGHT:
+      return 1.41f;
+    default:
+      return 1.0f;
+  }
+}
+
+// 48 tap windowed-sinc interpolator split into 4 phases, coef[k] holds tap k of every phase.
+static const f32x4 *true_peak_coefs() {
+  static f32x4 coefs[TP_TAPS];
+  static bool init = [] {
+    float h[TP_TAPS][TP_PHASES];
+    const int n = TP_TAPS * TP_PHASES;
+    for (int p = 0; p < TP_PHASES; p++) {
+      float sum = 0.0f;
+      for (int k = 0; k < TP_TAPS; k++) {
+        int i = k * TP_PHASES + p;
+        double t = (i - (n - 1) / 2.0) / TP_PHASES;
+        double sinc = t == 0.0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+        double w = 0.42 - 0.5 * cos(2.0 * M_PI * i / (n - 1)) + 0.08 * cos(4.0 * M_PI * i / (n - 1));
+        h[k][p] = (float)(sinc * w);
+        sum += h[k][p];
+      }
+      // unity gain per phase so DC passes every phase unchanged.
+      for (int k = 0; k < TP_TAPS; k++) {
+        h[k][p] /= sum;
+      }
+    }
+    for (int k = 0; k < TP_TAPS; k++) {
+      coefs[k] = f32x4_set(h[k][0], h[k][1], h[k][2], h[k][3]);
+    }
+    return true;
+  }();
+  (void)init;
+  return coefs;
+}
+
+LoudnessMeter::LoudnessMeter(int sample_rate, const AVChannelLayout *layout)
+    : channels_(layout->nb_channels),
+      sub_block_samples_(sample_rate / 10),
+      oversample_(sample_rate < 96000) {
+  // K-weighting: high shelf followed by the RLB high pass, re-derived for any rate.
+  double f0 = 1681.974450955533;
+  double gain = 3.999843853973347;
+  double q = 0.7071752369554196;
+  double k = tan(M_PI * f0 / sample_rate);
+  double vh = pow(10.0, gain / 20.0);
+  double vb = pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / q + k * k;
+  b_[0][0] = f32x4_set1((float)((vh + vb * k / q + k * k) / a0));
+  b_[0][1] = f32x4_set1((float)(2.0 * (k * k - vh) / a0));
+  b_[0][2] = f32x4_set1((float)((vh - vb * k / q + k * k) / a0));
+  a_[0][0] = f32x4_set1((float)(2.0 * (k * k - 1.0) / a0));
+  a_[0][1] = f32x4_set1((float)((1.0 - k / q + k * k) / a0));
+
+  f0 = 38.13547087602444;
+  q = 0.5003270373238773;
+  k = tan(M_PI * f0 / sample_rate);
+  a0 = 1.0 + k / q + k * k;
+  b_[1][0] = f32x4_set1(1.0f);
+  b_[1][1] = f32x4_set1(-2.0f);
+  b_[1][2] = f32x4_set1(1.0f);
+  a_[1][0] = f32x4_set1((float)(2.0 * (k * k - 1.0) / a0));
+  a_[1][1] = f32x4_set1((float)((1.0 - k / q + k * k) / a0));
+
+  for (int first = 0; first < channels_; first += 4) {
+    float w[4];
+    for (int l = 0; l < 4; l++) {
+      // lanes past the last channel re-read the first one with zero weight.
+      w[l] = first + l < channels_ ? channel_weight(layout, first + l) : 0.0f;
+    }
+    Group g;
+    g.first = first;
+    g.weight = f32x4_set(w[0], w[1], w[2], w[3]);
+    g.z1[0] = g.z1[1] = g.z2[0] = g.z2[1] = f32x4_zero();
+    g.energy = f32x4_zero();
+    groups_.push_back(g);
+  }
+  true_peak_.resize(channels_);
+}
+
+void LoudnessMeter::filter(Group &g, const float *const *planes, int offset, int n) {
+  const float *p[4];
+  for (int l = 0; l < 4; l++) {
+    p[l] = (g.first + l < channels_ ? planes[g.first + l] : planes[g.first]) + offset;
+  }
+  f32x4 z1a = g.z1[0], z2a = g.z2[0], z1b = g.z1[1], z2b = g.z2[1];
+  f32x4 energy = g.energy;
+  for (int i = 0; i < n; i++) {
+    f32x4 x = f32x4_set(p[0][i], p[1][i], p[2][i], p[3][i]);
+    f32x4 y = f32x4_add(f32x4_mul(b_[0][0], x), z1a);
+    z1a = f32x4_sub(f32x4_add(f32x4_mul(b_[0][1], x), z2a), f32x4_mul(a_[0][0], y));
+    z2a = f32x4_sub(f32x4_mul(b_[0][2], x), f32x4_mul(a_[0][1], y));
+    f32x4 out = f32x4_add(f32x4_mul(b_[1][0], y), z1b);
+    z1b = f32x4_sub(f32x4_add(f32x4_mul(b_[1][1], y), z2b), f32x4_mul(a_[1][0], out));
+    z2b = f32x4_sub(f32x4_mul(b_[1][2], y), f32x4_mul(a_[1][1], out));
+    energy = f32x4_mla(energy, out, out);
+  }
+  g.z1[0] = z1a;
+  g.z2[0] = z2a;
+  g.z1[1] = z1b;
+  g.z2[1] = z2b;
+  g.energy = energy;
+}
+
+void LoudnessMeter::end_sub_block() {
+  double energy = 0.0;
+  for (Group &g : groups_) {
+    energy += f32x4_hsum(f32x4_mul(g.energy, g.weight));
+    g.energy = f32x4_zero();
+  }
+  recent_.push_back(energy / sub_block_samples_);
+  if ((int)recent_.size() > ST_SUB_BLOCKS) {
+    recent_.erase(recent_.begin());
+  }
+  sub_blocks_++;
+  sub_block_fill_ = 0;
+
+  // 400 ms blocks every 100 ms, 3 s short-term blocks every second.
+  size_t size = recent_.size();
+  if (size >= 4) {
+    momentary_.push_back((recent_[size - 1] + recent_[size - 2] + recent_[size - 3] + recent_[size - 4]) / 4.0);
+  }
+  if (size == ST_SUB_BLOCKS && sub_blocks_ % 10 == 0) {
+    double sum = 0.0;
+    for (double e : recent_) {
+      sum += e;
+    }
+    short_term_.push_back(sum / ST_SUB_BLOCKS);
+  }
+}
+
+TruePeakFilter::TruePeakFilter() : buf_(TP_TAPS - 1, 0.0f) {
+}
+
+float TruePeakFilter::process(const float *src, int n, float *peaks) {
+  const f32x4 *coefs = true_peak_coefs();
+  // history + block in one run so each output is a plain dot product.
+  buf_.resize(TP_TAPS - 1 + n);
+  std::copy(src, src + n, buf_.begin() + TP_TAPS - 1);
+  const float *x = buf_.data() + TP_TAPS - 1;
+  f32x4 peak = f32x4_zero();
+  for (int i = 0; i < n; i++) {
+    f32x4 acc = f32x4_zero();
+    for (int k = 0; k < TP_TAPS; k++) {
+      acc = f32x4_mla(acc, f32x4_set1(x[i - k]), coefs[k]);
+    }
+    acc = f32x4_abs(acc);
+    if (peaks) {
+      peaks[i] = fmaxf(f32x4_hmax(acc), fabsf(x[i]));
+    }
+    peak = f32x4_max(peak, acc);
+  }
+  std::copy(buf_.end() - (TP_TAPS - 1), buf_.end(), buf_.begin());
+  buf_.resize(TP_TAPS - 1);
+  return f32x4_hmax(peak);
+}
+
+void LoudnessMeter::true_peak(const float *const *planes, int nb_samples) {
+  float sample_peak = sample_peak_;
+  float peak = 0.0f;
+  for (int c = 0; c < channels_; c++) {
+    const float *src = planes[c];
+    for (int i = 0; i < nb_samples; i++) {
+      sample_peak = fmaxf(sample_peak, fabsf(src[i]));
+    }
+    if (oversample_) {
+      peak = fmaxf(peak, true_peak_[c].process(src, nb_samples, nullptr));
+    }
+  }
+  sample_peak_ = sample_peak;
+  peak_ = fmaxf(peak_, fmaxf(peak, sample_peak));
+}
+
+void LoudnessMeter::add(const float *const *planes, int nb_samples) {
+  true_peak(planes, nb_samples);
+  int offset = 0;
+  while (offset < nb_samples) {
+    int n = std::min(nb_samples - offset, sub_block_samples_ - sub_block_fill_);
+    for (Group &g : groups_) {
+      filter(g, planes, offset, n);
+    }
+    offset += n;
+    sub_block_fill_ += n;
+    if (sub_block_fill_ == sub_block_samples_) {
+      end_sub_block();
+    }
+  }
+}
+
+// mean energy of the blocks above both the absolute gate and `relative` LU below the first-pass mean.
+static std::vector<double> gate(const std::vector<double> &blocks, double relative, double *mean) {
+  double abs_gate = lufs_to_energy(ABSOLUTE_GATE);
+  double sum = 0.0;
+  int count = 0;
+  for (double e : blocks) {
+    if (e > abs_gate) {
+      sum += e;
+      count++;
+    }
+  }
+  std::vector<double> gated;
+  *mean = 0.0;
+  if (count == 0) {
+    return gated;
+  }
+  double rel_gate = sum / count * pow(10.0, relative / 10.0);
+  sum = 0.0;
+  for (double e : blocks) {
+    if (e > abs_gate && e > rel_gate) {
+      gated.push_back(e);
+      sum += e;
+    }
+  }
+  *mean = gated.empty() ? 0.0 : sum / gated.size();
+  return gated;
+}
+
+LoudnessResult LoudnessMeter::result() const {
+  LoudnessResult r;
+  double mean = 0.0;
+  gate(momentary_, -10.0, &mean);
+  r.integrated = mean > 0.0 ? energy_to_lufs(mean) : -INFINITY;
+
+  // EBU Tech 3342: spread between the 10th and 95th percentile of gated short-term loudness.
+  std::vector<double> st = gate(short_term_, -20.0, &mean);
+  r.range = 0.0;
+  if (!st.empty()) {
+    std::sort(st.begin(), st.end());
+    size_t lo = (size_t)((st.size() - 1) * 0.10 + 0.5);
+    size_t hi = (size_t)((st.size() - 1) * 0.95 + 0.5);
+    r.range = energy_to_lufs(st[hi]) - energy_to_lufs(st[lo]);
+  }
+
+  r.true_peak = to_db(peak_);
+  r.sample_peak = to_db(sample_peak_);
+  r.replaygain = std::isinf(r.integrated) ? 0.0 : -18.0 - r.integrated;
+  r.replaygain_peak = peak_;
+  return r;
+}
+
+LoudnessStage::LoudnessStage(int sample_rate, const AVChannelLayout *layout, const std::string &path)
+    : meter_(sample_rate, layout), path_(path) {
+}
+
+int LoudnessStage::process(float *const *planes, int channels, int nb_samples) {
+  meter_.add(planes, nb_samples);
+  return 0;
+}
+
+// JSON has no infinities, silence is reported as null.
+static void write_number(FILE *file, const char *key, double v, bool last) {
+  if (std::isinf(v) || std::isnan(v)) {
+    fprintf(file, "  \"%s\": null%s\n", key, last ? "" : ",");
+  } else {
+    fprintf(file, "  \"%s\": %.2f%s\n", key, v, last ? "" : ",");
+  }
+}
+
+int LoudnessStage::finish() {
+  LoudnessResult r = meter_.result();
+  LOGI("loudness: I=%.1f LUFS, LRA=%.1f LU, TP=%.1f dBTP", r.integrated, r.range, r.true_peak);
+  FILE *file = fopen(path_.c_str(), "w");
+  if (!file) {
+    LOGE("can't open loudness output %s", path_.c_str());
+    return -1;
+  }
+  fprintf(file, "{\n");
+  write_number(file, "integrated_lufs", r.integrated, false);
+  write_number(file, "loudness_range_lu", r.range, false);
+  write_number(file, "true_peak_dbtp", r.true_peak, false);
+  write_number(file, "sample_peak_dbfs", r.sample_peak, false);
+  write_number(file, "replaygain_track_gain_db", r.replaygain, false);
+  fprintf(file, "  \"replaygain_track_peak\": %.6f\n", r.replaygain_peak);
+  fprintf(file, "}\n");
+  fclose(file);
+  return 0;
+}
@@ -0,0 +1,115 @@
+#ifndef AUDIO_ENCODER_LOUDNESS_H
+#define AUDIO_ENCODER_LOUDNESS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "pcm_stage.h"
+#include "simd.h"
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+}
+
+struct LoudnessResult {
+  // LUFS, -inf when everything was gated away (silence).
+  double integrated;
+  // LU
+  double range;
+  // dBTP / dBFS
+  double true_peak;
+  double sample_peak;
+  // ReplayGain 2.0 track gain (dB, reference -18 LUFS) and linear peak.
+  double replaygain;
+  double replaygain_peak;
+};
+
+// input samples the interpolated peaks lag the input by: the interpolator's group delay, rounded up.
+#define TRUE_PEAK_DELAY 6
+
+/**
+ * 4x oversampling peak detector for one channel, BS.1770 annex 2 style. The four
+ * interpolation phases of each input sample are computed in one vector.
+ */
+class TruePeakFilter {
+ public:
+  TruePeakFilter();
+
+  /**
+   * Returns the true peak of the block. When `peaks` isn't null it receives the
+   * per-sample peak, the max of |x| and the interpolated values TRUE_PEAK_DELAY
+   * samples back.
+   */
+  float process(const float *src, int n, float *peaks);
+
+ private:
+  // filter history followed by the current block.
+  std::vector<float> buf_;
+};
+
+/**
+ * EBU R128 / ITU-R BS.1770 meter: K-weighting, gated integrated loudness,
+ * loudness range and 4x oversampled true peak.
+ *
+ * Channels are packed four to a vector so the K-weighting biquads run on all
+ * of them at once, the true-peak interpolator computes its four phases per
+ * input sample in one vector.
+ */
+class LoudnessMeter {
+ public:
+  LoudnessMeter(int sample_rate, const AVChannelLayout *layout);
+
+  void add(const float *const *planes, int nb_samples);
+
+  LoudnessResult result() const;
+
+ private:
+  struct Group {
+    // first channel of the four packed into this group.
+    int first;
+    f32x4 weight;
+    // transposed direct form II state of the two K-weighting biquads.
+    f32x4 z1[2];
+    f32x4 z2[2];
+    f32x4 energy;
+  };
+
+  void filter(Group &g, const float *const *planes, int offset, int n);
+  void true_peak(const float *const *planes, int nb_samples);
+  void end_sub_block();
+
+  int channels_;
+  int sub_block_samples_;
+  int sub_block_fill_ = 0;
+  f32x4 b_[2][3];
+  f32x4 a_[2][2];
+  std::vector<Group> groups_;
+
+  // 100 ms sub-block energies of the last 3 s, momentary (400 ms) and short-term (3 s) blocks.
+  std::vector<double> recent_;
+  int64_t sub_blocks_ = 0;
+  std::vector<double> momentary_;
+  std::vector<double> short_term_;
+
+  bool oversample_;
+  std::vector<TruePeakFilter> true_peak_;
+  float peak_ = 0.0f;
+  float sample_peak_ = 0.0f;
+};
+
+/** Feeds every block to a LoudnessMeter and writes the result as JSON on finish(). */
+class LoudnessStage : public PcmStage {
+ public:
+  LoudnessStage(int sample_rate, const AVChannelLayout *layout, const std::string &path);
+
+  int process(float *const *planes, int channels, int nb_samples) override;
+
+  int finish() override;
+
+ private:
+  LoudnessMeter meter_;
+  std::string path_;
+};
+
+#endif //AUDIO_ENCODER_LOUDNESS_H
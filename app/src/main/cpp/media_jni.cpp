@@ -0,0 +1,99 @@
+#include <jni.h>
+#include <memory>
+#include "adts.h"
+#include "base.h"
+#include "packet_sink.h"
+
+/**
+ * Native helpers for the Kotlin MediaCodec paths (AudioEncoder / AudioDecoder).
+ * Everything goes through direct ByteBuffers, the codec's own buffers, so a
+ * packet costs neither a JVM allocation nor a copy on the Java heap.
+ */
+
+static uint8_t *direct_buffer(JNIEnv *env, jobject buffer, jint offset, jint size) {
+  auto *data = (uint8_t *)env->GetDirectBufferAddress(buffer);
+  jlong capacity = env->GetDirectBufferCapacity(buffer);
+  if (!data || offset < 0 || size < 0 || offset + (jlong)size > capacity) {
+    LOGE("not a direct buffer, or [%d, %d) is outside of it", offset, offset + size);
+    return nullptr;
+  }
+  return data + offset;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_soundvision_audio_1encoder_PacketSink_nativeOpenFile(JNIEnv *env, jclass clazz, jstring path) {
+  auto writer = std::make_unique<AsyncFileWriter>();
+  const char *file = env->GetStringUTFChars(path, nullptr);
+  int ret = writer->open(file);
+  env->ReleaseStringUTFChars(path, file);
+  if (ret < 0) {
+    return 0;
+  }
+  // a PacketSink handle is the sink itself.
+  return (jlong)(PacketSink *)writer.release();
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_soundvision_audio_1encoder_PacketSink_nativeWrite(JNIEnv *env, jclass clazz, jlong handle, jobject buffer,
+                                                           jint offset, jint size, jlong pts_us) {
+  const uint8_t *data = direct_buffer(env, buffer, offset, size);
+  if (!handle || !data) {
+    return -1;
+  }
+  return ((PacketSink *)handle)->write(data, size, pts_us);
+}
+
+// bytes written, < 0 on error; the handle is gone either way.
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_soundvision_audio_1encoder_PacketSink_nativeClose(JNIEnv *env, jclass clazz, jlong handle) {
+  auto *sink = (PacketSink *)handle;
+  if (!sink) {
+    return -1;
+  }
+  int64_t ret = sink->close();
+  delete sink;
+  return ret;
+}
+
+// configured from the codec's AudioSpecificConfig (the BUFFER_FLAG_CODEC_CONFIG buffer), 0 on error.
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_soundvision_audio_1encoder_AudioEncoder_nativeAdtsOpen(JNIEnv *env, jobject thiz, jobject csd, jint offset,
+                                                                jint size) {
+  const uint8_t *asc = direct_buffer(env, csd, offset, size);
+  AdtsConfig config;
+  if (!asc || adts_config_from_asc(asc, size, &config) < 0) {
+    return 0;
+  }
+  return (jlong)new AdtsPacketizer(config);
+}
+
+// header + payload built right in the sink, returns the frame size or -1.
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_soundvision_audio_1encoder_AudioEncoder_nativeAdtsWrite(JNIEnv *env, jobject thiz, jlong handle,
+                                                                 jobject src, jint offset, jint size, jlong pts_us,
+                                                                 jlong sink) {
+  auto *packetizer = (AdtsPacketizer *)handle;
+  const uint8_t *payload = direct_buffer(env, src, offset, size);
+  if (!packetizer || !payload || !sink) {
+    return -1;
+  }
+  PacketSink *out = (PacketSink *)sink;
+  const int capacity = size + ADTS_HEADER_SIZE;
+  uint8_t *dst = out->begin_packet(capacity);
+  int frame_size = dst ? packetizer->write(payload, size, dst, capacity) : -1;
+  if (frame_size < 0 || out->end_packet(frame_size, pts_us) < 0) {
+    return -1;
+  }
+  return frame_size;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_soundvision_audio_1encoder_AudioEncoder_nativeAdtsClose(JNIEnv *env, jobject thiz, jlong handle) {
+  delete (AdtsPacketizer *)handle;
+}
@@ -0,0 +1,335 @@
+#include "media_scan.h"
+#include "adts.h"
+#include "base.h"
+#include "probe_cache.h"
+#include "worker_pool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/macros.h"
+#include "libavutil/mathematics.h"
+}
+
+// read from the start of a file (after an ID3v2 tag), and from the end of an Ogg stream for its last granule.
+#define SCAN_HEAD_SIZE (64 * 1024)
+#define SCAN_TAIL_SIZE (64 * 1024)
+// MP4 boxes are followed this deep, stsd sits at moov / trak / mdia / minf / stbl.
+#define MP4_MAX_DEPTH 8
+
+namespace {
+
+struct ScanInput {
+  int fd = -1;
+  int64_t size = 0;
+
+  ~ScanInput() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  // short only at the end of the file.
+  int64_t read(int64_t offset, void *buf, int64_t n) const {
+    int64_t done = 0;
+    while (done < n) {
+      ssize_t r = pread64(fd, (uint8_t *)buf + done, (size_t)(n - done), (off64_t)(offset + done));
+      if (r < 0 && errno == EINTR) {
+        continue;
+      }
+      if (r <= 0) {
+        break;
+      }
+      done += r;
+    }
+    return done;
+  }
+};
+
+struct Mp4Track {
+  bool sound = false;
+  uint32_t timescale = 0;
+  int64_t duration = 0;
+  int channels = 0;
+  int sample_rate = 0;
+};
+
+struct Mp4Info {
+  Mp4Track track;
+  bool found = false;
+  int64_t mdat = 0;
+};
+
+}
+
+// `samples` at `sample_rate` carried in `bytes`.
+static int set_result(int64_t samples, int sample_rate, int channels, int64_t bytes, ScanResult *out) {
+  if (samples <= 0 || sample_rate <= 0) {
+    return AVERROR_INVALIDDATA;
+  }
+  out->duration_ms = av_rescale(samples, 1000, sample_rate);
+  out->sample_rate = sample_rate;
+  out->channels = channels;
+  out->bit_rate = av_rescale(bytes * 8, sample_rate, samples);
+  return 0;
+}
+
+static int scan_adts(const ScanInput &in, int64_t start, const uint8_t *head, int64_t n, ScanResult *out) {
+  std::vector<AdtsFrame> frames;
+  if (adts_index_frames(head, n, &frames) == 0 || frames[0].offset != 0) {
+    return AVERROR_INVALIDDATA;
+  }
+  AdtsHeader header;
+  int64_t samples = 0;
+  int64_t bytes = 0;
+  for (const AdtsFrame &frame : frames) {
+    adts_parse_header(head + frame.offset, frame.size, &header);
+    samples += 1024 * header.blocks;
+    bytes += frame.size;
+  }
+  // the frames past the head are taken to average like the ones in it.
+  if (start + n < in.size) {
+    samples = av_rescale(samples, in.size - start, bytes);
+    bytes = in.size - start;
+  }
+  adts_parse_header(head, n, &header);
+  return set_result(samples, header.sample_rate, header.channel_config == 7 ? 8 : header.channel_config, bytes,
+                    out);
+}
+
+static int scan_wav(const ScanInput &in, int64_t start, ScanResult *out) {
+  int channels = 0;
+  int sample_rate = 0;
+  int64_t byte_rate = 0;
+  int64_t data = -1;
+  for (int64_t pos = start + 12; pos + 8 <= in.size;) {
+    uint8_t chunk[24];
+    int64_t got = in.read(pos, chunk, sizeof(chunk));
+    if (got < 8) {
+      break;
+    }
+    const int64_t size = AV_RL32(chunk + 4);
+    if (!memcmp(chunk, "fmt ", 4) && got >= 20) {
+      channels = AV_RL16(chunk + 10);
+      sample_rate = (int)AV_RL32(chunk + 12);
+      byte_rate = AV_RL32(chunk + 16);
+    } else if (!memcmp(chunk, "data", 4)) {
+      // streamed files leave the size at 0 or 0xFFFFFFFF.
+      data = size > 0 ? std::min(size, in.size - pos - 8) : in.size - pos - 8;
+      break;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  if (data < 0 || byte_rate <= 0 || sample_rate <= 0) {
+    return AVERROR_INVALIDDATA;
+  }
+  out->duration_ms = av_rescale(data, 1000, byte_rate);
+  out->sample_rate = sample_rate;
+  out->channels = channels;
+  out->bit_rate = byte_rate * 8;
+  return 0;
+}
+
+static int scan_flac(const ScanInput &in, int64_t start, const uint8_t *head, ScanResult *out) {
+  // the first metadata block is STREAMINFO.
+  if ((head[4] & 0x7F) != 0) {
+    return AVERROR_INVALIDDATA;
+  }
+  const uint8_t *si = head + 8;
+  const int sample_rate = (si[10] << 12) | (si[11] << 4) | (si[12] >> 4);
+  const int channels = ((si[12] >> 1) & 7) + 1;
+  const int64_t samples = ((int64_t)(si[13] & 0xF) << 32) | AV_RB32(si + 14);
+  return set_result(samples, sample_rate, channels, in.size - start, out);
+}
+
+static int scan_ogg(const ScanInput &in, const uint8_t *head, int64_t n, ScanResult *out) {
+  const int64_t packet = 27 + head[26];
+  if (packet + 20 > n) {
+    return AVERROR_INVALIDDATA;
+  }
+  const uint32_t serial = AV_RL32(head + 14);
+  const uint8_t *id = head + packet;
+  int sample_rate;
+  int channels;
+  int64_t pre_skip = 0;
+  if (!memcmp(id, "OpusHead", 8)) {
+    // the granule counts 48 kHz samples whatever the input rate was.
+    channels = id[9];
+    pre_skip = AV_RL16(id + 10);
+    sample_rate = 48000;
+  } else if (!memcmp(id, "\x01vorbis", 7)) {
+    channels = id[11];
+    sample_rate = (int)AV_RL32(id + 12);
+  } else {
+    return AVERROR_INVALIDDATA;
+  }
+
+  // the last page of the stream with a granule position.
+  const int64_t tail_size = std::min<int64_t>(SCAN_TAIL_SIZE, in.size);
+  std::vector<uint8_t> tail((size_t)tail_size);
+  const int64_t got = in.read(in.size - tail_size, tail.data(), tail_size);
+  for (int64_t i = got - 27; i >= 0; i--) {
+    const uint8_t *page = tail.data() + i;
+    if (!memcmp(page, "OggS", 4) && AV_RL32(page + 14) == serial && AV_RL64(page + 6) != UINT64_MAX) {
+      return set_result((int64_t)AV_RL64(page + 6) - pre_skip, sample_rate, channels, in.size, out);
+    }
+  }
+  return AVERROR_INVALIDDATA;
+}
+
+static void walk_mp4(const ScanInput &in, int64_t pos, int64_t end, int depth, Mp4Track *track, Mp4Info *info) {
+  while (pos + 8 <= end) {
+    uint8_t box[16];
+    if (in.read(pos, box, sizeof(box)) < 8) {
+      return;
+    }
+    int64_t size = AV_RB32(box);
+    int64_t header = 8;
+    if (size == 1) {
+      size = (int64_t)AV_RB64(box + 8);
+      header = 16;
+    } else if (size == 0) {
+      size = end - pos;
+    }
+    if (size < header) {
+      return;
+    }
+    // a truncated file still tells its format.
+    size = std::min(size, end - pos);
+    const int64_t payload = pos + header;
+    uint8_t b[44] = {};
+    switch (AV_RB32(box + 4)) {
+      case MKBETAG('m', 'o', 'o', 'v'):
+      case MKBETAG('m', 'd', 'i', 'a'):
+      case MKBETAG('m', 'i', 'n', 'f'):
+      case MKBETAG('s', 't', 'b', 'l'):
+        if (depth < MP4_MAX_DEPTH) {
+          walk_mp4(in, payload, pos + size, depth + 1, track, info);
+        }
+        break;
+      case MKBETAG('t', 'r', 'a', 'k'):
+        if (depth < MP4_MAX_DEPTH) {
+          Mp4Track t;
+          walk_mp4(in, payload, pos + size, depth + 1, &t, info);
+          if (t.sound && !info->found) {
+            info->track = t;
+            info->found = true;
+          }
+        }
+        break;
+      case MKBETAG('m', 'd', 'a', 't'):
+        info->mdat += size - header;
+        break;
+      case MKBETAG('m', 'd', 'h', 'd'):
+        if (track && in.read(payload, b, 32) == 32) {
+          // version 1 has 64 bit times.
+          track->timescale = AV_RB32(b + (b[0] == 1 ? 20 : 12));
+          track->duration = b[0] == 1 ? (int64_t)AV_RB64(b + 24) : AV_RB32(b + 16);
+        }
+        break;
+      case MKBETAG('h', 'd', 'l', 'r'):
+        if (track && in.read(payload, b, 12) == 12) {
+          track->sound = !memcmp(b + 8, "soun", 4);
+        }
+        break;
+      case MKBETAG('s', 't', 's', 'd'):
+        // the first AudioSampleEntry: channel count at 24, 16.16 sample rate at 32.
+        if (track && in.read(payload, b, sizeof(b)) == sizeof(b)) {
+          track->channels = AV_RB16(b + 8 + 24);
+          track->sample_rate = (int)(AV_RB32(b + 8 + 32) >> 16);
+        }
+        break;
+      default:
+        break;
+    }
+    pos += size;
+  }
+}
+
+static int scan_mp4(const ScanInput &in, int64_t start, ScanResult *out) {
+  Mp4Info info;
+  walk_mp4(in, start, in.size, 0, nullptr, &info);
+  const Mp4Track &t = info.track;
+  if (!info.found || t.timescale == 0 || t.duration <= 0) {
+    return AVERROR_INVALIDDATA;
+  }
+  out->duration_ms = av_rescale(t.duration, 1000, t.timescale);
+  out->sample_rate = t.sample_rate;
+  out->channels = t.channels;
+  out->bit_rate = av_rescale(info.mdat * 8, t.timescale, t.duration);
+  return 0;
+}
+
+// everything the headers above don't cover: a full open, which the probe cache makes cheap the second time.
+static int scan_libavformat(const char *path, ScanResult *out) {
+  AVFormatContext *ctx = nullptr;
+  AVCodecParameters *par = avcodec_parameters_alloc();
+  int stream_index;
+  int ret = par ? open_audio_input(path, &ctx, &stream_index, par) : AVERROR(ENOMEM);
+  if (ret >= 0) {
+    out->duration_ms = ctx->duration != AV_NOPTS_VALUE ? av_rescale(ctx->duration, 1000, AV_TIME_BASE) : 0;
+    out->sample_rate = par->sample_rate;
+    out->channels = par->ch_layout.nb_channels;
+    out->bit_rate = ctx->bit_rate > 0 ? ctx->bit_rate : par->bit_rate;
+  }
+  avformat_close_input(&ctx);
+  avcodec_parameters_free(&par);
+  return ret;
+}
+
+int scan_file(const char *path, ScanResult *out) {
+  *out = ScanResult();
+  ScanInput in;
+  in.fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (in.fd < 0 || fstat(in.fd, &st) != 0) {
+    LOGE("scan: can't open %s", path);
+    out->ret = AVERROR(ENOENT);
+    return out->ret;
+  }
+  in.size = st.st_size;
+
+  uint8_t tag[ID3V2_HEADER_SIZE];
+  const int64_t start = id3v2_tag_size(tag, in.read(0, tag, sizeof(tag)));
+  std::vector<uint8_t> head(SCAN_HEAD_SIZE);
+  const int64_t n = in.read(start, head.data(), SCAN_HEAD_SIZE);
+  const uint8_t *h = head.data();
+  AdtsHeader adts;
+  int ret = AVERROR_INVALIDDATA;
+  if (n >= 12 && !memcmp(h, "RIFF", 4) && !memcmp(h + 8, "WAVE", 4)) {
+    ret = scan_wav(in, start, out);
+  } else if (n >= 42 && !memcmp(h, "fLaC", 4)) {
+    ret = scan_flac(in, start, h, out);
+  } else if (n >= 28 && !memcmp(h, "OggS", 4)) {
+    ret = scan_ogg(in, h, n, out);
+  } else if (n >= 8 && !memcmp(h + 4, "ftyp", 4)) {
+    ret = scan_mp4(in, start, out);
+  } else if (adts_parse_header(h, n, &adts) >= 0) {
+    ret = scan_adts(in, start, h, n, out);
+  }
+  if (ret < 0) {
+    *out = ScanResult();
+    ret = scan_libavformat(path, out);
+  }
+  out->ret = ret;
+  return ret;
+}
+
+void scan_files(const std::vector<std::string> &paths, int threads, std::vector<ScanResult> *out) {
+  out->assign(paths.size(), ScanResult());
+  WorkerPool pool(threads);
+  for (size_t i = 0; i < paths.size(); i++) {
+    ScanResult *result = &(*out)[i];
+    const char *path = paths[i].c_str();
+    pool.submit([path, result] { scan_file(path, result); });
+  }
+  pool.wait();
+}
@@ -0,0 +1,37 @@
+#ifndef AUDIO_ENCODER_MEDIA_SCAN_H
+#define AUDIO_ENCODER_MEDIA_SCAN_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** What a library listing shows of a file, fields the headers don't give are 0. */
+struct ScanResult {
+  int64_t duration_ms = 0;
+  int sample_rate = 0;
+  int channels = 0;
+  int64_t bit_rate = 0;
+  // < 0 when the file couldn't be read or recognized.
+  int ret = 0;
+};
+
+/**
+ * Duration, format and average bitrate of `path` from its headers alone,
+ * nothing is decoded. ADTS, MP4 / M4A, WAV, FLAC and Ogg (Opus, Vorbis) are
+ * parsed here with a few small reads at the start and end of the file:
+ *
+ * - ADTS: the frame headers of the first SCAN_HEAD_SIZE bytes, extrapolated
+ *   over the rest of the file. The rate is the one in the header, which for
+ *   HE-AAC is the core's, half of what the decoder outputs.
+ * - MP4: mdhd and stsd of the first sound track, the bitrate from mdat.
+ * - WAV / FLAC: fmt / data chunks and STREAMINFO.
+ * - Ogg: the identification header, the duration from the last page's granule.
+ *
+ * Anything else is opened with libavformat through the probe cache.
+ */
+int scan_file(const char *path, ScanResult *out);
+
+/** scan_file() over `paths` on `threads` threads (0 = one per core), results in the same order. */
+void scan_files(const std::vector<std::string> &paths, int threads, std::vector<ScanResult> *out);
+
+#endif //AUDIO_ENCODER_MEDIA_SCAN_H
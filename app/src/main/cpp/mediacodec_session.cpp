@@ -0,0 +1,403 @@
+#include "mediacodec_session.h"
+#include "base.h"
+#include "pcm_dsp.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+}
+
+#define AAC_MIME "audio/mp4a-latm"
+// bytes per input buffer the codec is asked for, 2048 stereo S16 samples.
+#define INPUT_BUFFER_SIZE 8192
+// how long finish() waits for the end of stream to come out of the codec.
+#define DRAIN_TIMEOUT_MS 5000
+
+// AMediaCodecOnAsyncNotifyCallback: the NDK only declares it for API 28 targets, minSdk is 24.
+struct AsyncNotifyCallback {
+  void (*on_input)(AMediaCodec *codec, void *userdata, int32_t index);
+  void (*on_output)(AMediaCodec *codec, void *userdata, int32_t index, AMediaCodecBufferInfo *info);
+  void (*on_format)(AMediaCodec *codec, void *userdata, AMediaFormat *format);
+  void (*on_error)(AMediaCodec *codec, void *userdata, media_status_t error, int32_t action_code,
+                   const char *detail);
+};
+
+// the API 28 part of libmediandk, looked up at runtime.
+struct MediaNdk28 {
+  media_status_t (*set_async_notify_callback)(AMediaCodec *codec, AsyncNotifyCallback callback, void *userdata);
+  media_status_t (*get_name)(AMediaCodec *codec, char **name);
+  void (*release_name)(AMediaCodec *codec, char *name);
+};
+
+// null below Android 9.
+static const MediaNdk28 *media_ndk_28() {
+  static const MediaNdk28 api = {
+      (decltype(api.set_async_notify_callback))dlsym(RTLD_DEFAULT, "AMediaCodec_setAsyncNotifyCallback"),
+      (decltype(api.get_name))dlsym(RTLD_DEFAULT, "AMediaCodec_getName"),
+      (decltype(api.release_name))dlsym(RTLD_DEFAULT, "AMediaCodec_releaseName"),
+  };
+  return api.set_async_notify_callback && api.get_name && api.release_name ? &api : nullptr;
+}
+
+std::unique_ptr<MediaCodecSession> MediaCodecSession::create(const EncoderConfig &config, int sample_rate,
+                                                             const AVChannelLayout *layout, ResampleQuality quality) {
+  const MediaNdk28 *ndk = media_ndk_28();
+  if (!ndk) {
+    LOGE("mediacodec: async mode needs Android 9 (API 28)");
+    return nullptr;
+  }
+  AMediaCodec *codec = AMediaCodec_createEncoderByType(AAC_MIME);
+  if (!codec) {
+    LOGE("mediacodec: no %s encoder on this device", AAC_MIME);
+    return nullptr;
+  }
+  std::unique_ptr<MediaCodecSession> session(new MediaCodecSession(config, codec, sample_rate, layout));
+  session->quality_ = quality;
+  char *name = nullptr;
+  if (ndk->get_name(codec, &name) == AMEDIA_OK) {
+    session->name_ = name;
+    ndk->release_name(codec, name);
+  }
+
+  // callbacks have to be in place before configure().
+  AsyncNotifyCallback callback = {on_input, on_output, on_format, on_error};
+  media_status_t status = ndk->set_async_notify_callback(codec, callback, session.get());
+  if (status != AMEDIA_OK) {
+    LOGE("mediacodec: setAsyncNotifyCallback failed, status: %d", status);
+    return nullptr;
+  }
+
+  AMediaFormat *format = AMediaFormat_new();
+  AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, AAC_MIME);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_SAMPLE_RATE, config.sample_rate);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_CHANNEL_COUNT, session->channels_);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_BIT_RATE, (int32_t)config.bit_rate);
+  // FF_PROFILE_AAC_* is the MPEG-4 audio object type minus one, MediaCodec takes the object type.
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_AAC_PROFILE, config.profile + 1);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_MAX_INPUT_SIZE, INPUT_BUFFER_SIZE);
+  status = AMediaCodec_configure(codec, format, nullptr, nullptr, AMEDIACODEC_CONFIGURE_FLAG_ENCODE);
+  AMediaFormat_delete(format);
+  if (status != AMEDIA_OK) {
+    LOGE("mediacodec: %s doesn't take %d Hz / %d ch / %lld b/s / object type %d, status: %d",
+         session->name_.c_str(), config.sample_rate, session->channels_, (long long)config.bit_rate,
+         config.profile + 1, status);
+    return nullptr;
+  }
+
+  // the codec takes interleaved S16 at its own rate and layout.
+  AVChannelLayout out_layout;
+  av_channel_layout_from_mask(&out_layout, config.channel_mask);
+  const bool same_layout = av_channel_layout_compare(&out_layout, layout) == 0;
+  if (config.sample_rate != sample_rate && same_layout) {
+    session->resampler_ = Resampler::create(sample_rate, config.sample_rate, session->channels_, quality);
+  }
+  if (!session->resampler_ && (config.sample_rate != sample_rate || !same_layout)) {
+    int ret = swr_alloc_set_opts2(&session->swr_, &out_layout, AV_SAMPLE_FMT_S16, config.sample_rate,
+                                  layout, AV_SAMPLE_FMT_FLTP, sample_rate, 0, nullptr);
+    if (ret < 0 || swr_init(session->swr_) < 0) {
+      LOGE("swr_init failed");
+      return nullptr;
+    }
+  }
+  LOGI("mediacodec: %s", session->describe().c_str());
+  return session;
+}
+
+MediaCodecSession::MediaCodecSession(const EncoderConfig &config, AMediaCodec *codec, int sample_rate,
+                                     const AVChannelLayout *layout)
+    : config_(config), codec_(codec), sample_rate_(sample_rate),
+      channels_(av_popcount64(config.channel_mask)) {
+  av_channel_layout_copy(&layout_, layout);
+}
+
+MediaCodecSession::~MediaCodecSession() {
+  // no callbacks once the codec is stopped and gone.
+  if (started_) {
+    AMediaCodec_stop(codec_);
+  }
+  AMediaCodec_delete(codec_);
+  if (muxer_) {
+    AMediaMuxer_delete(muxer_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  if (file_) {
+    fclose(file_);
+  }
+  swr_free(&swr_);
+  av_channel_layout_uninit(&layout_);
+}
+
+std::string MediaCodecSession::describe() const {
+  char config[256];
+  snprintf(config, sizeof(config), "MediaCodec %s %d %d %lld %d", name_.c_str(), config_.sample_rate, channels_,
+           (long long)config_.bit_rate, config_.profile);
+  std::string desc = config;
+  if (config_.sample_rate != sample_rate_) {
+    desc += " resample " + std::to_string(quality_);
+  }
+  return desc;
+}
+
+int MediaCodecSession::open(const char *path) {
+  if (av_match_ext(path, "m4a,mp4")) {
+    // the muxer wants a read / write descriptor, it seeks back for the moov box.
+    fd_ = ::open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    muxer_ = fd_ >= 0 ? AMediaMuxer_new(fd_, AMEDIAMUXER_OUTPUT_FORMAT_MPEG_4) : nullptr;
+  } else if (av_match_ext(path, "aac")) {
+    file_ = fopen(path, "wb");
+  } else {
+    LOGE("mediacodec: %s, only .aac and .m4a outputs are supported", path);
+    return AVERROR(EINVAL);
+  }
+  if (!muxer_ && !file_) {
+    LOGE("open output file %s failed.", path);
+    return AVERROR(EIO);
+  }
+  media_status_t status = AMediaCodec_start(codec_);
+  if (status != AMEDIA_OK) {
+    LOGE("mediacodec: start failed, status: %d", status);
+    return AVERROR_EXTERNAL;
+  }
+  started_ = true;
+  return 0;
+}
+
+int MediaCodecSession::input_buffer() {
+  if (in_index_ >= 0) {
+    return 0;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return !inputs_.empty() || error_ < 0; });
+  if (error_ < 0) {
+    return error_;
+  }
+  in_index_ = inputs_.front();
+  inputs_.pop_front();
+  lock.unlock();
+
+  in_data_ = AMediaCodec_getInputBuffer(codec_, (size_t)in_index_, &in_capacity_);
+  in_fill_ = 0;
+  if (!in_data_) {
+    LOGE("mediacodec: no input buffer at index %d", in_index_);
+    return AVERROR_EXTERNAL;
+  }
+  return 0;
+}
+
+int MediaCodecSession::queue_input(uint32_t flags) {
+  const uint64_t pts_us = (uint64_t)av_rescale(in_samples_, 1000000, config_.sample_rate);
+  in_samples_ += in_fill_ / (channels_ * sizeof(int16_t));
+  media_status_t status = AMediaCodec_queueInputBuffer(codec_, (size_t)in_index_, 0, in_fill_, pts_us, flags);
+  in_index_ = -1;
+  if (status != AMEDIA_OK) {
+    LOGE("mediacodec: queueInputBuffer failed, status: %d", status);
+    return AVERROR_EXTERNAL;
+  }
+  return 0;
+}
+
+int MediaCodecSession::write(const float *const *planes, int nb_samples) {
+  if (resampler_) {
+    nb_samples = resampler_->process(planes, nb_samples);
+    planes = resampler_->output();
+  }
+  return feed(planes, nb_samples);
+}
+
+int MediaCodecSession::feed(const float *const *planes, int nb_samples) {
+  // without swr the conversion writes straight into the codec's buffer.
+  const int16_t *s16 = nullptr;
+  if (swr_) {
+    int out_samples = swr_get_out_samples(swr_, nb_samples);
+    conv_.resize((size_t)out_samples * channels_);
+    uint8_t *out[] = {(uint8_t *)conv_.data()};
+    nb_samples = swr_convert(swr_, out, out_samples, (const uint8_t **)planes, planes ? nb_samples : 0);
+    if (nb_samples < 0) {
+      return nb_samples;
+    }
+    s16 = conv_.data();
+  }
+
+  const PcmDsp *dsp = pcm_dsp_get();
+  const size_t frame_bytes = channels_ * sizeof(int16_t);
+  const float *src[AV_NUM_DATA_POINTERS];
+  int done = 0;
+  while (done < nb_samples) {
+    int ret = input_buffer();
+    if (ret < 0) {
+      return ret;
+    }
+    int n = (int)FFMIN((in_capacity_ - in_fill_) / frame_bytes, (size_t)(nb_samples - done));
+    int16_t *dst = (int16_t *)(in_data_ + in_fill_);
+    if (s16) {
+      memcpy(dst, s16 + (size_t)done * channels_, n * frame_bytes);
+    } else {
+      for (int ch = 0; ch < channels_; ch++) {
+        src[ch] = planes[ch] + done;
+      }
+      dsp->float_planar_to_s16(dst, src, channels_, n);
+    }
+    in_fill_ += n * frame_bytes;
+    done += n;
+    if (in_capacity_ - in_fill_ < frame_bytes) {
+      ret = queue_input(0);
+      if (ret < 0) {
+        return ret;
+      }
+    }
+  }
+  return 0;
+}
+
+int MediaCodecSession::finish() {
+  // the resampler's filter tail first.
+  int ret = 0;
+  if (resampler_) {
+    int n = resampler_->flush();
+    ret = feed(resampler_->output(), n);
+  } else if (swr_) {
+    ret = feed(nullptr, 0);
+  }
+  if (ret >= 0) {
+    ret = input_buffer();
+  }
+  if (ret >= 0) {
+    ret = queue_input(AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+  }
+  if (ret >= 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cond_.wait_for(lock, std::chrono::milliseconds(DRAIN_TIMEOUT_MS),
+                        [this] { return eos_ || error_ < 0; })) {
+      LOGE("mediacodec: no end of stream after %d ms", DRAIN_TIMEOUT_MS);
+      ret = AVERROR_EXTERNAL;
+    } else {
+      ret = error_;
+    }
+  }
+
+  AMediaCodec_stop(codec_);
+  started_ = false;
+  if (muxer_ && track_ >= 0 && AMediaMuxer_stop(muxer_) != AMEDIA_OK) {
+    LOGE("mediacodec: muxer stop failed");
+    ret = ret < 0 ? ret : AVERROR(EIO);
+  }
+  if (file_ && fclose(file_) != 0) {
+    ret = ret < 0 ? ret : AVERROR(EIO);
+  }
+  file_ = nullptr;
+  return ret;
+}
+
+void MediaCodecSession::fail(int err) {
+  if (error_ == 0) {
+    error_ = err;
+  }
+  cond_.notify_all();
+}
+
+int MediaCodecSession::start_output(AMediaFormat *format) {
+  if (muxer_) {
+    if (track_ >= 0) {
+      return 0;
+    }
+    track_ = AMediaMuxer_addTrack(muxer_, format);
+    if (track_ < 0 || AMediaMuxer_start(muxer_) != AMEDIA_OK) {
+      LOGE("mediacodec: muxer rejected %s", AMediaFormat_toString(format));
+      return AVERROR_EXTERNAL;
+    }
+    return 0;
+  }
+  void *csd = nullptr;
+  size_t size = 0;
+  AdtsConfig config;
+  if (!AMediaFormat_getBuffer(format, "csd-0", &csd, &size) ||
+      adts_config_from_asc((const uint8_t *)csd, (int)size, &config) < 0) {
+    LOGE("mediacodec: no usable AudioSpecificConfig in %s", AMediaFormat_toString(format));
+    return AVERROR_EXTERNAL;
+  }
+  adts_ = std::make_unique<AdtsPacketizer>(config);
+  return 0;
+}
+
+int MediaCodecSession::write_output(int32_t index, const AMediaCodecBufferInfo *info) {
+  // the config also comes in as the output format, that's where it is taken from.
+  if ((info->flags & AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG) || info->size <= 0) {
+    return 0;
+  }
+  size_t capacity = 0;
+  const uint8_t *data = AMediaCodec_getOutputBuffer(codec_, (size_t)index, &capacity);
+  if (!data) {
+    LOGE("mediacodec: no output buffer at index %d", index);
+    return AVERROR_EXTERNAL;
+  }
+  if (muxer_) {
+    if (track_ < 0) {
+      LOGE("mediacodec: a packet before the output format");
+      return AVERROR_EXTERNAL;
+    }
+    // the muxer applies info->offset itself.
+    return AMediaMuxer_writeSampleData(muxer_, (size_t)track_, data, info) == AMEDIA_OK ? 0 : AVERROR(EIO);
+  }
+  if (!adts_) {
+    LOGE("mediacodec: a packet before the output format");
+    return AVERROR_EXTERNAL;
+  }
+  int size = 0;
+  const uint8_t *frame = adts_->packetize(data + info->offset, info->size, &size);
+  if (!frame) {
+    return AVERROR(EINVAL);
+  }
+  return fwrite(frame, 1, (size_t)size, file_) == (size_t)size ? 0 : AVERROR(EIO);
+}
+
+void MediaCodecSession::on_input(AMediaCodec *codec, void *userdata, int32_t index) {
+  auto *session = (MediaCodecSession *)userdata;
+  std::lock_guard<std::mutex> lock(session->mutex_);
+  session->inputs_.push_back(index);
+  session->cond_.notify_all();
+}
+
+void MediaCodecSession::on_output(AMediaCodec *codec, void *userdata, int32_t index, AMediaCodecBufferInfo *info) {
+  auto *session = (MediaCodecSession *)userdata;
+  std::lock_guard<std::mutex> lock(session->mutex_);
+  if (session->error_ == 0) {
+    int ret = session->write_output(index, info);
+    if (ret < 0) {
+      session->fail(ret);
+    }
+  }
+  AMediaCodec_releaseOutputBuffer(codec, (size_t)index, false);
+  if (info->flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) {
+    session->eos_ = true;
+    session->cond_.notify_all();
+  }
+}
+
+void MediaCodecSession::on_format(AMediaCodec *codec, void *userdata, AMediaFormat *format) {
+  auto *session = (MediaCodecSession *)userdata;
+  std::lock_guard<std::mutex> lock(session->mutex_);
+  int ret = session->start_output(format);
+  // the callback owns `format`, the muxer and the ASC lookup only read it.
+  AMediaFormat_delete(format);
+  if (ret < 0) {
+    session->fail(ret);
+  }
+}
+
+void MediaCodecSession::on_error(AMediaCodec *codec, void *userdata, media_status_t error, int32_t action_code,
+                                 const char *detail) {
+  auto *session = (MediaCodecSession *)userdata;
+  LOGE("mediacodec: error %d (action %d): %s", error, action_code, detail ? detail : "");
+  std::lock_guard<std::mutex> lock(session->mutex_);
+  session->fail(AVERROR_EXTERNAL);
+}
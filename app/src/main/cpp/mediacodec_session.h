@@ -0,0 +1,116 @@
+#ifndef AUDIO_ENCODER_MEDIACODEC_SESSION_H
+#define AUDIO_ENCODER_MEDIACODEC_SESSION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaMuxer.h>
+
+#include "adts.h"
+#include "encoder_pool.h"
+#include "encoder_session.h"
+#include "resampler.h"
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include <libswresample/swresample.h>
+}
+
+/**
+ * AAC through the device's MediaCodec encoder, driven from native code with
+ * the NDK AMediaCodec API: PCM is converted straight into the codec's input
+ * buffers, packets are written from its output buffers into an .aac
+ * (AdtsPacketizer) or .m4a (AMediaMuxer). Nothing goes through the JVM.
+ *
+ * The codec runs in async mode, its callbacks come in on the codec's own
+ * thread: input buffer indices are queued for write(), output buffers are
+ * written out right in the callback.
+ *
+ * The async API is Android 9 (API 28) and resolved at runtime, create()
+ * returns null on older devices.
+ */
+class MediaCodecSession : public EncoderSession {
+ public:
+  /**
+   * An encoder for the rate, layout, bitrate and AAC profile of `config`, fed
+   * with planar float at `sample_rate` / `layout`. Null when the device has none.
+   */
+  static std::unique_ptr<MediaCodecSession> create(const EncoderConfig &config, int sample_rate,
+                                                   const AVChannelLayout *layout,
+                                                   ResampleQuality quality = RESAMPLE_MEDIUM);
+
+  ~MediaCodecSession() override;
+
+  std::string describe() const override;
+
+  int open(const char *path) override;
+
+  int write(const float *const *planes, int nb_samples) override;
+
+  int finish() override;
+
+ private:
+  MediaCodecSession(const EncoderConfig &config, AMediaCodec *codec, int sample_rate, const AVChannelLayout *layout);
+
+  static void on_input(AMediaCodec *codec, void *userdata, int32_t index);
+  static void on_output(AMediaCodec *codec, void *userdata, int32_t index, AMediaCodecBufferInfo *info);
+  static void on_format(AMediaCodec *codec, void *userdata, AMediaFormat *format);
+  static void on_error(AMediaCodec *codec, void *userdata, media_status_t error, int32_t action_code,
+                       const char *detail);
+
+  // codec rate planar float, or swr's input -> codec input buffers.
+  int feed(const float *const *planes, int nb_samples);
+  // the current input buffer, waits for the codec to hand one out. < 0 on a codec error.
+  int input_buffer();
+  int queue_input(uint32_t flags);
+  // on the codec thread, with mutex_ held.
+  int write_output(int32_t index, const AMediaCodecBufferInfo *info);
+  int start_output(AMediaFormat *format);
+  void fail(int err);
+
+  EncoderConfig config_;
+  AMediaCodec *codec_;
+  // component name, "c2.android.aac.encoder" or a vendor's.
+  std::string name_;
+  int sample_rate_;
+  AVChannelLayout layout_ = {};
+  int channels_;
+  bool started_ = false;
+
+  // a rate change on a shared filter bank. swr when the layout differs too or the ratio has no bank.
+  std::unique_ptr<Resampler> resampler_;
+  ResampleQuality quality_ = RESAMPLE_MEDIUM;
+  // codec channel count S16 at the codec rate, through swr when that isn't the input format.
+  SwrContext *swr_ = nullptr;
+  std::vector<int16_t> conv_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<int32_t> inputs_;
+  bool eos_ = false;
+  int error_ = 0;
+
+  // input buffer being filled, its index is -1 when there is none.
+  int32_t in_index_ = -1;
+  uint8_t *in_data_ = nullptr;
+  size_t in_capacity_ = 0;
+  size_t in_fill_ = 0;
+  int64_t in_samples_ = 0;
+
+  // .aac
+  FILE *file_ = nullptr;
+  std::unique_ptr<AdtsPacketizer> adts_;
+  // .m4a
+  int fd_ = -1;
+  AMediaMuxer *muxer_ = nullptr;
+  ssize_t track_ = -1;
+};
+
+#endif //AUDIO_ENCODER_MEDIACODEC_SESSION_H
@@ -1,8 +1,33 @@
 #include <jni.h>
 #include <string>
 #include "base.h"
+#include "aac_profile.h"
+#include "adts_demuxer.h"
+#include "adts_parallel.h"
+#include "bandwidth.h"
+#include "channel_matrix.h"
+#include "core_api.h"
+#include "dual_mono.h"
+#include "encode_cache.h"
+#include "encoder_pool.h"
+#include "ffmpeg_session.h"
+#include "flac_parallel.h"
+#include "loudness.h"
+#include "media_scan.h"
+#include "mediacodec_session.h"
+#include "normalize.h"
+#include "options.h"
+#include "peaks.h"
+#include "probe_cache.h"
+#include "pcm_dsp.h"
+#include "pcm_stage.h"
+#include "resampler.h"
+#include "session_fanout.h"
+#include "silence.h"
+#include "spectrum.h"
 extern "C" {
 #include "libavcodec/avcodec.h"
+#include "libavutil/audio_fifo.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
 #include "libavutil/frame.h"
@@ -14,274 +39,692 @@ extern "C" {
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 
-void encode(AVCodecContext* c, AVFrame* frame, AVPacket* pkt, AVStream* stream, AVFormatContext* format_context) {
-  int ret = avcodec_send_frame(c, frame);
-  if (ret < 0) {
-    LOGE("avcodec_send_frame error, reason: %s", av_err2str(ret));
-    return;
-  }
+// haidao.pcm: interleaved S16, 44.1 kHz, stereo unless "in_layout" says otherwise, whatever the encoder is set up for.
+#define INPUT_SAMPLE_RATE 44100
+static const AVChannelLayout default_input_layout = AV_CHANNEL_LAYOUT_STEREO;
+// input is converted and run through the pre-encode stage in blocks of this many samples.
+#define INPUT_BLOCK 1024
+// auto_rate: the bandwidth is where the long-term spectrum falls this far under its peak.
+#define BANDWIDTH_RANGE_DB 60.0f
+
+// the default encoder of nativeEncode, opened through EncoderPool.
+static EncoderConfig aac_config() {
+  EncoderConfig config = {};
+  config.codec_id = AV_CODEC_ID_AAC;
+  config.sample_fmt = AV_SAMPLE_FMT_FLTP;
+  config.bit_rate = 96000;
+  config.sample_rate = 44100;
+  config.channel_mask = AV_CH_LAYOUT_STEREO;
+  config.profile = FF_PROFILE_AAC_LOW;
+  return config;
+}
 
-  while (ret >= 0) {
-    ret = avcodec_receive_packet(c, pkt);
-    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-      break;
-    } else if (ret < 0) {
-      break;
+// voice: libopus when it is linked in, FFmpeg's own encoder (experimental, 48 kHz and 20 ms only) otherwise.
+static EncoderConfig opus_config(const EncodeOptions &opts) {
+  EncoderConfig config = {};
+  config.codec_id = AV_CODEC_ID_OPUS;
+  config.bit_rate = 24000;
+  config.channel_mask = AV_CH_LAYOUT_MONO;
+  config.profile = AV_PROFILE_UNKNOWN;
+  if (avcodec_find_encoder_by_name("libopus")) {
+    config.encoder = "libopus";
+    config.sample_fmt = AV_SAMPLE_FMT_FLT;
+    config.sample_rate = opts.sample_rate > 0 ? opts.sample_rate : 48000;
+    char buf[256];
+    // FEC only goes into the stream when the encoder expects some loss.
+    snprintf(buf, sizeof(buf), "application=voip:frame_duration=%g:dtx=%d:fec=%d:packet_loss=%d",
+             opts.frame_duration, opts.dtx, opts.fec, opts.fec ? 10 : 0);
+    config.options = buf;
+    if (opts.complexity >= 0) {
+      config.options += ":compression_level=" + std::to_string(opts.complexity);
     }
-    pkt->stream_index = stream->index;
+  } else {
+    LOGW("libopus isn't available, falling back to the native Opus encoder: 48 kHz, 20 ms, no DTX / FEC.");
+    config.encoder = "opus";
+    config.sample_fmt = AV_SAMPLE_FMT_FLTP;
+    config.sample_rate = 48000;
+    config.options = "strict=experimental";
+  }
+  return config;
+}
 
-    //convert time_base
-    av_packet_rescale_ts(pkt, c->time_base, stream->time_base);
-    //write file.
-    ret = av_interleaved_write_frame(format_context, pkt);
-    if (ret < 0) {
-      av_packet_unref(pkt);
-      break;
+// HE / HE v2 / LD / ELD come from libfdk_aac, LC stays on the native encoder the pool keeps warm.
+static int aac_profile_config(const EncodeOptions &opts, const char *out_file, EncoderConfig *config) {
+  const AVOutputFormat *ofmt = av_guess_format(nullptr, out_file, nullptr);
+  const bool adts = ofmt && !strcmp(ofmt->name, "adts");
+  const int channels = av_popcount64(config->channel_mask);
+  // MediaCodec's AAC encoder has every profile.
+  const bool have_fdk = opts.backend == "mediacodec" || avcodec_find_encoder_by_name("libfdk_aac") != nullptr;
+  int profile = select_aac_profile(opts.profile.c_str(), config->bit_rate, channels, opts.latency_ms, adts, have_fdk);
+  if (profile < 0) {
+    return profile;
+  }
+  config->profile = profile;
+  if (profile != FF_PROFILE_AAC_LOW) {
+    config->encoder = "libfdk_aac";
+    config->sample_fmt = AV_SAMPLE_FMT_S16;
+    // ELD without SBR wastes its bits on the top octave at speech bitrates.
+    if (profile == FF_PROFILE_AAC_ELD && config->bit_rate <= 32000 * (int64_t)channels) {
+      config->options = "eld_sbr=1";
     }
-    av_packet_unref(pkt);
   }
+  return 0;
 }
 
-void print_support_format(const AVCodec *codec)  {
-  // 打印编码器支持的采样格式
-  LOGI("Supported sample formats:");
-  const enum AVSampleFormat *p = codec->sample_fmts;
-  if (p) {
-    while (*p != AV_SAMPLE_FMT_NONE) {
-      LOGI("  %s", av_get_sample_fmt_name(*p));
-      p++;
-    }
+static int encoder_config(const EncodeOptions &opts, const char *out_file, EncoderConfig *config) {
+  *config = opts.codec == "opus" ? opus_config(opts) : aac_config();
+  const AVOutputFormat *ofmt = av_guess_format(nullptr, out_file, nullptr);
+  config->global_header = ofmt && (ofmt->flags & AVFMT_GLOBALHEADER);
+  if (opts.bitrate > 0) {
+    config->bit_rate = opts.bitrate;
   }
-
-// 打印支持的采样率
-  LOGI("Supported sample rates:");
-  if (codec->supported_samplerates) {
-    int i = 0;
-    while (codec->supported_samplerates[i] != 0) {
-      LOGI("  %d", codec->supported_samplerates[i]);
-      i++;
-    }
+  if (opts.sample_rate > 0 && opts.codec != "opus") {
+    config->sample_rate = opts.sample_rate;
   }
-
-// 打印支持的通道布局
-  LOGI("Supported channel layouts:");
-  if (codec->ch_layouts) {
-    int i = 0;
-    while (codec->ch_layouts[i].nb_channels != 0) {
-      char buf[256];
-      av_channel_layout_describe(&codec->ch_layouts[i], buf, sizeof(buf));
-      LOGI("  %s", buf);
-      i++;
-    }
+  if (!opts.layout.empty()) {
+    AVChannelLayout layout = {};
+    av_channel_layout_from_string(&layout, opts.layout.c_str());
+    config->channel_mask = layout.u.mask;
+  } else if (opts.channels > 0) {
+    config->channel_mask = opts.channels == 1 ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO;
   }
+  return opts.codec == "aac" ? aac_profile_config(opts, out_file, config) : 0;
 }
 
-int configureCodec(AVCodecContext *&c, const AVCodec *codec) {
-  c = avcodec_alloc_context3(codec);
-  c->codec_id = AV_CODEC_ID_AAC;
-  c->codec_type = AVMEDIA_TYPE_AUDIO;
-  c->sample_fmt = AV_SAMPLE_FMT_FLTP;
-
-  c->bit_rate = 96000;
-  c->sample_rate = 44100;
-
-  const AVChannelLayout src = AV_CHANNEL_LAYOUT_STEREO;
-  av_channel_layout_copy(&c->ch_layout, &src);
-  c->profile = FF_PROFILE_AAC_LOW;
+extern "C"
+JNIEXPORT void JNICALL audio_core_init() {
+  // the first encode finds its context already opened, the pool thread did it right after the core was loaded.
+  EncoderPool::get().warm(aac_config(), 1);
+  // nor does it build the filters of the common rate pairs.
+  filter_bank_warm();
+}
 
-  //打开编码器
-  int ret = avcodec_open2(c, codec, nullptr);
-  if (ret < 0) {
-    LOGE("avcodec_open2 open failed, reason: %s", av_err2str(ret));
+/**
+ * An asset opened with AASSET_MODE_BUFFER and read through AAsset_getBuffer, so an
+ * uncompressed asset is used straight from the apk mapping instead of being copied.
+ */
+struct MappedAsset {
+  AAsset *asset = nullptr;
+  const uint8_t *data = nullptr;
+  int64_t size = 0;
+
+  ~MappedAsset() {
+    if (asset) {
+      AAsset_close(asset);
+    }
   }
-  return ret;
-}
+};
 
-int64_t fill_input_buffer(JNIEnv *env, jobject mgr, void** input_buffer) {
+int map_asset(JNIEnv *env, jobject mgr, const char *name, MappedAsset *out) {
   AAssetManager* native_mgr = AAssetManager_fromJava(env, mgr);
   if (native_mgr == nullptr) {
     LOGE("native_mgr is nullptr.");
     return -1;
   }
-  AAsset* asset = AAssetManager_open(native_mgr, "haidao.pcm", AASSET_MODE_BUFFER);
-  if (asset == nullptr) {
-    LOGE("asset is nullptr.");
+  out->asset = AAssetManager_open(native_mgr, name, AASSET_MODE_BUFFER);
+  if (out->asset == nullptr) {
+    LOGE("asset %s is nullptr.", name);
     return -1;
   }
 
-  off_t file_size = AAsset_getLength(asset);
-  if (file_size <= 0) {
+  out->size = AAsset_getLength64(out->asset);
+  if (out->size <= 0) {
     LOGE("asset file is empty.");
     return -1;
   }
 
-  *input_buffer = (uint8_t*)av_malloc(file_size);
-  if (*input_buffer == nullptr) {
-    LOGE("av_malloc failed.");
-    return -1;
-  }
-  int read_bytes = AAsset_read(asset, (uint8_t*)*input_buffer, file_size);
-  if (read_bytes != file_size) {
-    LOGE("Failed to read asset.");
+  out->data = (const uint8_t *)AAsset_getBuffer(out->asset);
+  if (out->data == nullptr) {
+    LOGE("Failed to map asset.");
     return -1;
   }
-  AAsset_close(asset);
   LOGI("open assets success.");
-  return file_size;
+  return 0;
 }
 
-extern "C"
-JNIEXPORT jint JNICALL
-Java_com_soundvision_audio_1encoder_MainActivity_nativeEncode(JNIEnv *env, jobject thiz, jobject mgr, jstring dest) {
+// pre-encode stage: gain / fade-in / background mix / soft clip. Mix inputs have the input's
+// `in_channels` and go through `remix` like it.
+static std::unique_ptr<DspStage> make_dsp_stage(const EncodeOptions &opts, int sample_rate, int in_channels,
+                                                const ChannelMatrix *remix,
+                                                const std::vector<std::unique_ptr<MappedAsset>> &mix) {
+  auto stage = std::make_unique<DspStage>(opts.dsp, sample_rate);
+  for (size_t i = 0; i < mix.size(); i++) {
+    float gain_db = i < opts.mix_gain_db.size() ? opts.mix_gain_db[i] : 0.0f;
+    stage->add_mix_input((const int16_t *)mix[i]->data, mix[i]->size / (in_channels * (int64_t)sizeof(int16_t)),
+                         gain_db, remix);
+  }
+  return stage;
+}
 
-  uint8_t * input_buffer;
-  int64_t file_size= fill_input_buffer(env, mgr, (void **)&input_buffer);
-  if (file_size < 0) {
-    LOGE("get input buffer failed, ret: %ld", file_size);
-    return -1;
+// what a target's encoder is set up with, known before any encoder is opened. The FFmpeg version stands in for
+// the encoder's own, a device's MediaCodec is whatever it is.
+static std::string encoder_key(const EncodeOptions &opts, const EncoderConfig &config) {
+  char key[512];
+  snprintf(key, sizeof(key), "%s %s %s %d %d %llx %lld %d %d %s", opts.backend.c_str(), LIBAVCODEC_IDENT,
+           config.encoder.empty() ? avcodec_get_name(config.codec_id) : config.encoder.c_str(), config.sample_fmt,
+           config.sample_rate, (unsigned long long)config.channel_mask, (long long)config.bit_rate, config.profile,
+           config.global_header, config.options.c_str());
+  return key;
+}
+
+// cache key of an encode job: options, encoder setup and every input byte. Empty if hashing isn't available.
+static std::string encode_digest(const std::string &options, const std::string &encoder, const MappedAsset &input,
+                                 const std::vector<std::unique_ptr<MappedAsset>> &mix) {
+  ContentHash hash;
+  if (!hash.valid()) {
+    return "";
+  }
+  hash.update(encoder);
+  hash.update(options);
+  hash.update(input.data, input.size);
+  for (const std::unique_ptr<MappedAsset> &m : mix) {
+    hash.update(m->data, m->size);
   }
+  return hash.hex();
+}
 
-  const char* out_file = env->GetStringUTFChars(dest, nullptr);
-  const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
-  if (!codec) {
-    LOGE("Can't find AAC encoder.");
-    return -1;
+/** One output of an encode job. */
+struct EncodeTarget {
+  std::string path;
+  // the option string it was parsed from, part of its cache key.
+  std::string options;
+  EncodeOptions opts;
+  std::unique_ptr<EncoderSession> session;
+  std::string cache_key;
+};
+
+// the lowest rate of `codec` that carries `bandwidth`, 0 when only the input's own does.
+static int auto_sample_rate(const std::string &codec, int bandwidth) {
+  static const int aac_rates[] = {16000, 24000, 32000};
+  static const int opus_rates[] = {16000, 24000};
+  const int *rates = codec == "opus" ? opus_rates : aac_rates;
+  const int nb_rates = codec == "opus" ? FF_ARRAY_ELEMS(opus_rates) : FF_ARRAY_ELEMS(aac_rates);
+  for (int i = 0; i < nb_rates; i++) {
+    // encoders low-pass a little under Nyquist.
+    if (rates[i] * 45 / 100 >= bandwidth) {
+      return rates[i];
+    }
   }
+  return 0;
+}
 
-  //打印支持的格式
-  print_support_format(codec);
+// the encoder end: the device's MediaCodec with backend=mediacodec, libavcodec otherwise. `layout` is what it is fed.
+static std::unique_ptr<EncoderSession> make_session(const EncodeOptions &opts, const char *path,
+                                                    const AVChannelLayout *layout) {
+  EncoderConfig config;
+  if (encoder_config(opts, path, &config) < 0) {
+    return nullptr;
+  }
+  const ResampleQuality quality = (ResampleQuality)opts.resample_quality;
+  if (opts.backend == "mediacodec") {
+    return MediaCodecSession::create(config, INPUT_SAMPLE_RATE, layout, quality);
+  }
+  return FfmpegSession::create(config, INPUT_SAMPLE_RATE, layout, quality);
+}
 
-  AVCodecContext *c = nullptr;
-  int ret = configureCodec(c, codec);
+/**
+ * Reads the input once, runs it through the pre-encode stages of `opts` and
+ * encodes the result into every target, each on its own thread when there are
+ * several. Returns how many targets failed, < 0 when nothing could be encoded.
+ */
+static int encode_targets(JNIEnv *env, jobject mgr, const EncodeOptions &opts, std::vector<EncodeTarget> &targets) {
+  MappedAsset input;
+  int ret = map_asset(env, mgr, "haidao.pcm", &input);
   if (ret < 0) {
-    LOGE("configureCodec failed, ret: %d", ret);
+    LOGE("get input buffer failed, ret: %d", ret);
     return -1;
   }
 
-  //分配输出格式
-  AVFormatContext* format_context = nullptr;
-  const AVOutputFormat *ofmt = nullptr;
-  avformat_alloc_output_context2(&format_context, nullptr, nullptr, out_file);
-  if (!format_context) {
-    LOGE("avformat_alloc_output_context2 failed");
-    return -1;
+  std::vector<std::unique_ptr<MappedAsset>> mix;
+  for (const std::string &name : opts.mix) {
+    mix.push_back(std::make_unique<MappedAsset>());
+    if (map_asset(env, mgr, name.c_str(), mix.back().get()) < 0) {
+      LOGE("load mix input %s failed.", name.c_str());
+      return -1;
+    }
   }
 
-  ofmt = format_context->oformat;
+  AVChannelLayout in_layout = default_input_layout;
+  if (!opts.in_layout.empty()) {
+    av_channel_layout_from_string(&in_layout, opts.in_layout.c_str());
+  }
+  const int in_channels = in_layout.nb_channels;
 
-  //创建音频流
-  AVStream* stream = avformat_new_stream(format_context, nullptr);
-  if (!stream) {
-    LOGE("avformat_new_stream failed.");
-    return -1;
+  if (opts.codec == "flac") {
+    ret = encode_flac_parallel((const int16_t *)input.data, input.size / (in_channels * (int64_t)sizeof(int16_t)),
+                               INPUT_SAMPLE_RATE, &in_layout, opts.compression_level, opts.threads,
+                               targets[0].path.c_str());
+    return ret < 0 ? -1 : 0;
   }
 
-  // Set the time base before copying parameters
-  stream->time_base = (AVRational){1, c->sample_rate};
-  c->time_base = stream->time_base;
+  // identical left and right: as mono at half the bitrate the encoder does half the work for the same sound.
+  std::vector<std::pair<EncodeTarget *, EncoderConfig>> stereo;
+  for (EncodeTarget &target : targets) {
+    EncoderConfig config;
+    if (opts.dual_mono_db < 0.0f && in_channels == 2 && opts.matrix.empty() && target.opts.layout.empty() &&
+        target.opts.channels == 0 && encoder_config(target.opts, target.path.c_str(), &config) == 0 &&
+        av_popcount64(config.channel_mask) == 2) {
+      stereo.emplace_back(&target, config);
+    }
+  }
+  if (!stereo.empty() && detect_dual_mono((const int16_t *)input.data, input.size / (2 * (int64_t)sizeof(int16_t)),
+                                          INPUT_SAMPLE_RATE, opts.dual_mono_db)) {
+    for (auto &entry : stereo) {
+      EncodeTarget *target = entry.first;
+      // a profile that needs stereo (hev2) rejects mono, that output stays as it was.
+      EncodeOptions mono = target->opts;
+      mono.channels = 1;
+      mono.bitrate = (int)(entry.second.bit_rate / 2);
+      EncoderConfig config;
+      if (encoder_config(mono, target->path.c_str(), &config) < 0) {
+        continue;
+      }
+      target->opts = mono;
+      LOGI("dual mono: %s is encoded as mono at %d b/s", target->path.c_str(), target->opts.bitrate);
+    }
+  }
 
-  //将编码器参数复制到流
-  ret = avcodec_parameters_from_context(stream->codecpar, c);
-  if (ret < 0) {
-    LOGE("avcodec_parameters_from_context failed, ret:%d", ret);
-    return -1;
+  // narrowband input is encoded at the lowest rate that still carries all of it.
+  std::vector<EncodeTarget *> any_rate;
+  for (EncodeTarget &target : targets) {
+    if (target.opts.auto_rate && target.opts.sample_rate == 0) {
+      any_rate.push_back(&target);
+    }
+  }
+  if (!any_rate.empty()) {
+    int bandwidth = detect_bandwidth((const int16_t *)input.data, input.size / (in_channels * (int64_t)sizeof(int16_t)),
+                                     in_channels, INPUT_SAMPLE_RATE, BANDWIDTH_RANGE_DB);
+    for (EncodeTarget *target : any_rate) {
+      target->opts.sample_rate = auto_sample_rate(target->opts.codec, bandwidth);
+      if (target->opts.sample_rate > 0) {
+        LOGI("auto_rate: %s is encoded at %d Hz", target->path.c_str(), target->opts.sample_rate);
+      }
+    }
   }
 
-  struct SwrContext *swr_ctx = nullptr;
-  ret = swr_alloc_set_opts2(&swr_ctx, const_cast<const AVChannelLayout*>(&c->ch_layout), c->sample_fmt, c->sample_rate,
-                      const_cast<const AVChannelLayout *>(&c->ch_layout),  AV_SAMPLE_FMT_S16, c->sample_rate, 0, nullptr);
-  if (ret < 0) {
-    LOGE("swr_alloc_set_opts2 failed, ret: %d", ret);
-    return -1;
+  // the input is remixed once, up front, to the widest layout among the outputs: the stages and every
+  // encoder only see those channels, a narrower ladder output is downmixed by its session. Remixing
+  // to a narrower one would leave a wider output with an upmix.
+  AVChannelLayout layout = in_layout;
+  int widest = 0;
+  for (const EncodeTarget &target : targets) {
+    EncoderConfig config;
+    if (encoder_config(target.opts, target.path.c_str(), &config) == 0 &&
+        av_popcount64(config.channel_mask) > widest) {
+      widest = av_popcount64(config.channel_mask);
+      av_channel_layout_from_mask(&layout, config.channel_mask);
+    }
+  }
+  std::unique_ptr<ChannelMatrix> remix;
+  if (av_channel_layout_compare(&in_layout, &layout) != 0 || !opts.matrix.empty()) {
+    remix = ChannelMatrix::create(&in_layout, &layout, opts.matrix);
+    if (!remix) {
+      return -1;
+    }
+    if (remix->identity()) {
+      remix.reset();
+    }
+  }
+
+  // a job seen before is served from the cache, peaks is a side output only a real encode produces.
+  std::unique_ptr<EncodeCache> cache;
+  if (!opts.cache.empty() && opts.peaks.empty()) {
+    cache = std::make_unique<EncodeCache>(opts.cache, opts.cache_size_mb * 1024 * 1024);
+  }
+  std::vector<EncodeTarget *> pending;
+  int failed = 0;
+  for (EncodeTarget &target : targets) {
+    // looked up before the session exists: a hit opens no encoder, software or hardware.
+    EncoderConfig config;
+    if (cache && encoder_config(target.opts, target.path.c_str(), &config) == 0) {
+      target.cache_key = encode_digest(target.options, encoder_key(target.opts, config), input, mix);
+    }
+    if (!target.cache_key.empty() && cache->fetch(target.cache_key, target.path.c_str()) > 0) {
+      LOGI("cache: hit %s", target.cache_key.c_str());
+      continue;
+    }
+    target.session = make_session(target.opts, target.path.c_str(), &layout);
+    if (!target.session) {
+      failed++;
+      continue;
+    }
+    pending.push_back(&target);
+  }
+  if (pending.empty()) {
+    return failed == (int)targets.size() ? -1 : failed;
+  }
+
+  const int channels = layout.nb_channels;
+  const int sample_rate = INPUT_SAMPLE_RATE;
+  const PcmDsp *dsp = pcm_dsp_get();
+  const int16_t *pcm = (const int16_t *)input.data;
+  const int64_t nb_input = input.size / (in_channels * (int64_t)sizeof(int16_t));
+
+  // the parts of the input that get encoded, all of it unless silence is trimmed.
+  std::vector<PcmRange> ranges(1, PcmRange{0, nb_input});
+  if (opts.silence.enabled()) {
+    ranges = detect_sound(pcm, nb_input, in_channels, sample_rate, opts.silence);
+  }
+  int64_t remaining = 0;
+  for (const PcmRange &r : ranges) {
+    remaining += r.end - r.start;
+  }
+  if (opts.silence.enabled()) {
+    LOGI("silence: keeping %lld of %lld samples in %zu ranges",
+         (long long)remaining, (long long)nb_input, ranges.size());
+  }
+
+  PcmChain chain;
+  if (opts.dsp.enabled() || !mix.empty()) {
+    chain.add(make_dsp_stage(opts, sample_rate, in_channels, remix.get(), mix));
+  }
+  if (opts.normalize) {
+    // analysis pass over the same mapped input through a twin of the stage above: no I/O, no codec.
+    std::unique_ptr<DspStage> twin;
+    if (!chain.empty()) {
+      twin = make_dsp_stage(opts, sample_rate, in_channels, remix.get(), mix);
+    }
+    LoudnessResult measured = measure_s16(pcm, ranges, sample_rate, &in_layout, remix.get(), twin.get());
+    float gain_db = normalize_gain(measured, opts.target_lufs);
+    bool limit = measured.true_peak + gain_db > opts.true_peak;
+    LOGI("normalize: measured %.1f LUFS / %.1f dBTP, gain %.1f dB, limiter %s",
+         measured.integrated, measured.true_peak, gain_db, limit ? "on" : "off");
+    chain.add(std::make_unique<NormalizeStage>(gain_db, opts.true_peak, limit, sample_rate, channels));
+  }
+  if (!opts.peaks.empty()) {
+    // last in the chain, so it sees exactly what the encoder gets.
+    chain.add(std::make_unique<PeakStage>(sample_rate, channels, opts.peaks, chain.latency()));
+  }
+
+  // an output that can't be opened fails alone, the rest of the ladder is still encoded.
+  std::vector<EncoderSession *> sessions;
+  for (auto it = pending.begin(); it != pending.end();) {
+    EncodeTarget *target = *it;
+    ret = target->session->open(target->path.c_str());
+    if (ret < 0) {
+      LOGE("open encoder output %s failed, ret: %d", target->path.c_str(), ret);
+      target->session.reset();
+      failed++;
+      it = pending.erase(it);
+      continue;
+    }
+    sessions.push_back(target->session.get());
+    ++it;
   }
-  if (!swr_ctx || swr_init(swr_ctx) < 0) {
-    LOGE("swr_init failed.");
+  if (sessions.empty()) {
     return -1;
   }
+  ret = 0;
+
+  // stage output -> encoder sessions in blocks, a session absorbs the difference to its frame size.
+  const int block = INPUT_BLOCK;
+  SessionFanOut fanout(sessions, channels, block);
+  std::vector<float *> planes(channels);
+  // the input ahead of the remix.
+  std::vector<float> in_buf;
+  std::vector<float *> in_planes(in_channels);
+  if (remix) {
+    in_buf.resize((size_t)in_channels * block);
+    for (int ch = 0; ch < in_channels; ch++) {
+      in_planes[ch] = in_buf.data() + (size_t)ch * block;
+    }
+  }
 
-  /**  packet for holding encoded output. **/
-  AVPacket* pkt = av_packet_alloc();
-  /** frame containing input raw audio. **/
-  AVFrame* frame = av_frame_alloc();
+  // a delaying stage first emits its empty delay line: drop that, then push zeros to flush it.
+  int64_t skip = chain.latency();
+  int64_t flush = skip;
+  size_t range = 0;
+  int64_t pos = ranges.empty() ? 0 : ranges[0].start;
+  while (remaining > 0 || flush > 0) {
+    std::shared_ptr<SessionFanOut::Block> block_buf = fanout.acquire();
+    for (int ch = 0; ch < channels; ch++) {
+      planes[ch] = block_buf->data.data() + (size_t)ch * block;
+    }
+    int nb_samples;
+    if (remaining > 0) {
+      // blocks never straddle two ranges, the chain and session splice them back to back.
+      nb_samples = (int)FFMIN(ranges[range].end - pos, (int64_t)block);
+      if (remix) {
+        dsp->s16_to_float_planar(in_planes.data(), pcm + pos * in_channels, in_channels, nb_samples);
+        remix->process(planes.data(), in_planes.data(), nb_samples);
+      } else {
+        dsp->s16_to_float_planar(planes.data(), pcm + pos * channels, channels, nb_samples);
+      }
+      pos += nb_samples;
+      remaining -= nb_samples;
+      if (pos == ranges[range].end && ++range < ranges.size()) {
+        pos = ranges[range].start;
+      }
+    } else {
+      nb_samples = (int)FFMIN(flush, (int64_t)block);
+      memset(block_buf->data.data(), 0, block_buf->data.size() * sizeof(float));
+      flush -= nb_samples;
+    }
 
-  if (!pkt || !frame) {
-    LOGE("av_packet or av_frame alloc failed.");
+    ret = chain.process(planes.data(), channels, nb_samples);
+    if (ret < 0) {
+      LOGE("pre-encode stage failed, ret: %d", ret);
+      break;
+    }
+
+    int drop = (int)FFMIN(skip, (int64_t)nb_samples);
+    skip -= drop;
+    ret = fanout.write(block_buf, drop, nb_samples - drop);
+    if (ret < 0) {
+      break;
+    }
   }
 
-  frame->nb_samples = c->frame_size;
-  frame->format = c->sample_fmt;
-  av_channel_layout_copy(&frame->ch_layout, &c->ch_layout);
+  std::vector<int> results = fanout.finish();
+  chain.finish();
+  for (size_t i = 0; i < pending.size(); i++) {
+    EncodeTarget *target = pending[i];
+    target->session.reset();
+    if (ret < 0 || results[i] < 0) {
+      failed++;
+    } else if (!target->cache_key.empty()) {
+      cache->store(target->cache_key, target->path.c_str());
+    }
+  }
+  return failed;
+}
 
-  /**  分配缓冲区数据 **/
-  ret = av_frame_get_buffer(frame, 0);
+extern "C"
+JNIEXPORT jint JNICALL
+audio_core_encode(JNIEnv *env, jobject thiz, jobject mgr, jstring dest, jstring options) {
+  std::vector<EncodeTarget> targets(1);
+  EncodeTarget &target = targets[0];
+  const char *opt_str = env->GetStringUTFChars(options, nullptr);
+  target.options = opt_str;
+  int ret = parse_encode_options(opt_str, &target.opts);
+  env->ReleaseStringUTFChars(options, opt_str);
   if (ret < 0) {
-    LOGE("alloc frame buffer failed.");
+    LOGE("parse encode options failed, ret: %d", ret);
     return -1;
   }
+  const char* out_file = env->GetStringUTFChars(dest, nullptr);
+  target.path = out_file;
+  env->ReleaseStringUTFChars(dest, out_file);
+
+  const EncodeOptions opts = target.opts;
+  return encode_targets(env, mgr, opts, targets) < 0 ? -1 : 0;
+}
 
-  //计算编码每帧 aac 所需要的 pcm 字节大小
-  int fsize = frame->nb_samples * av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) * c->ch_layout.nb_channels;
-  auto per_frame = (uint8_t *)av_malloc(fsize);
-  if (per_frame == nullptr) {
+extern "C"
+JNIEXPORT jint JNICALL
+audio_core_encode_ladder(JNIEnv *env, jobject thiz, jobject mgr, jobjectArray dests, jstring options,
+                         jobjectArray variants) {
+  const jsize count = env->GetArrayLength(dests);
+  if (count == 0 || env->GetArrayLength(variants) != count) {
+    LOGE("ladder: %d outputs but %d variants", count, env->GetArrayLength(variants));
     return -1;
   }
-
-  if (!(ofmt->flags & AVFMT_NOFILE)) {
-    ret = avio_open(&format_context->pb, out_file, AVIO_FLAG_WRITE);
+  const char *opt_str = env->GetStringUTFChars(options, nullptr);
+  const std::string shared = opt_str;
+  env->ReleaseStringUTFChars(options, opt_str);
+
+  std::vector<EncodeTarget> targets(count);
+  for (jsize i = 0; i < count; i++) {
+    auto dest = (jstring)env->GetObjectArrayElement(dests, i);
+    auto variant = (jstring)env->GetObjectArrayElement(variants, i);
+    const char *path = env->GetStringUTFChars(dest, nullptr);
+    const char *var = env->GetStringUTFChars(variant, nullptr);
+    targets[i].path = path;
+    int ret = parse_variant_options(shared.c_str(), var, &targets[i].opts, &targets[i].options);
+    env->ReleaseStringUTFChars(dest, path);
+    env->ReleaseStringUTFChars(variant, var);
+    env->DeleteLocalRef(dest);
+    env->DeleteLocalRef(variant);
     if (ret < 0) {
-      LOGE("open output file failed.");
+      LOGE("ladder: variant %d has bad options, ret: %d", i, ret);
       return -1;
     }
   }
 
-  //write file header.
-  ret = avformat_write_header(format_context,  nullptr);
-  if (ret < 0) {
-    LOGE("av_format_write_header failed.");
-    return -1;
+  // every target has the shared options, the first one stands for all of them.
+  const EncodeOptions opts = targets[0].opts;
+  int failed = encode_targets(env, mgr, opts, targets);
+  if (failed != 0) {
+    LOGE("ladder: %d of %d outputs failed", failed < 0 ? count : failed, count);
   }
+  return failed < 0 ? -count : -failed;
+}
 
-  int64_t pts = 0;
-  while(file_size > 0) {
-    memset(per_frame, 0, fsize);
+// scans are I/O bound, flash storage gains little from more small reads in flight than this.
+#define SCAN_THREADS 4
 
-    int copy_amount = file_size > fsize ? fsize : (int)file_size;
-    LOGI("copy_amount: %d", copy_amount);
-    if (copy_amount < fsize) {
-      LOGE("per frame not enough.");
+extern "C"
+JNIEXPORT jlongArray JNICALL
+audio_core_scan(JNIEnv *env, jobject thiz, jobjectArray paths) {
+  const jsize count = env->GetArrayLength(paths);
+  std::vector<std::string> list(count);
+  for (jsize i = 0; i < count; i++) {
+    auto path = (jstring)env->GetObjectArrayElement(paths, i);
+    const char *str = env->GetStringUTFChars(path, nullptr);
+    list[i] = str;
+    env->ReleaseStringUTFChars(path, str);
+    env->DeleteLocalRef(path);
+  }
+
+  std::vector<ScanResult> results;
+  scan_files(list, SCAN_THREADS, &results);
+  std::vector<jlong> values((size_t)count * 4, -1);
+  for (jsize i = 0; i < count; i++) {
+    const ScanResult &r = results[i];
+    if (r.ret >= 0) {
+      values[i * 4] = r.duration_ms;
+      values[i * 4 + 1] = r.sample_rate;
+      values[i * 4 + 2] = r.channels;
+      values[i * 4 + 3] = r.bit_rate;
     }
-    memcpy(per_frame, input_buffer, copy_amount);
-    input_buffer += copy_amount;
-    file_size -= copy_amount;
+  }
+  jlongArray array = env->NewLongArray(count * 4);
+  if (array) {
+    env->SetLongArrayRegion(array, 0, count * 4, values.data());
+  }
+  return array;
+}
 
-    ret = av_frame_make_writable(frame);
-    if (ret < 0) {
-      LOGE("av_frame_make_writable failed, ret: %d", ret);
-      break;
-    }
 
-    //resample.
-    LOGI("nb_samples: %d, frame_size: %d", frame->nb_samples, c->frame_size);
-    ret = swr_convert(swr_ctx, frame->data, frame->nb_samples, (const uint8_t**)&per_frame, frame->nb_samples);
-    if (ret < 0) {
-      LOGE("swr_convert failed, ret: %d", ret);
-      break;
+/** Everything a decoded frame goes through on its way to the output file. */
+struct DecodeOutput {
+  const DecodeOptions *opts = nullptr;
+  // of the first decoded frame, set by start_output(). The stream parameters may only come from
+  // a header, an HE-AAC stream decodes at twice the rate its ADTS header gives.
+  AVChannelLayout layout = {};
+  // only set up when the decoder doesn't hand out planar float itself.
+  SwrContext *swr_ctx = nullptr;
+  uint8_t **fltp = nullptr;
+  int fltp_samples = 0;
+  // "sample_rate": created on the first frame, whose rate may differ from the one the
+  // stream header announced (HE-AAC).
+  int out_rate = 0;
+  ResampleQuality quality = RESAMPLE_MEDIUM;
+  std::unique_ptr<Resampler> resampler;
+  // post-decode stage, runs on planar float, at out_rate when resampling.
+  PcmChain chain;
+  bool dither = false;
+  uint32_t dither_seed = 0x1234567u;
+  // reusable interleaved S16 output.
+  std::vector<int16_t> pcm;
+  FILE *file = nullptr;
+
+  ~DecodeOutput() {
+    av_channel_layout_uninit(&layout);
+    swr_free(&swr_ctx);
+    if (fltp) {
+      av_freep(&fltp[0]);
     }
+    av_freep(&fltp);
+  }
+};
 
-    frame->pts = pts;
-    pts += frame->nb_samples;
+// the post-decode stages, at the output rate.
+static void start_output(DecodeOutput *out, const AVChannelLayout *layout, int sample_rate) {
+  const DecodeOptions &opts = *out->opts;
+  const int rate = opts.sample_rate > 0 ? opts.sample_rate : sample_rate;
+  av_channel_layout_copy(&out->layout, layout);
+  if (opts.dsp.enabled()) {
+    out->chain.add(std::make_unique<DspStage>(opts.dsp, rate));
+  }
+  // measured after the stage above, i.e. on exactly what lands in the output file.
+  if (!opts.loudness.empty()) {
+    out->chain.add(std::make_unique<LoudnessStage>(rate, layout, opts.loudness));
+  }
+  if (!opts.peaks.empty()) {
+    out->chain.add(std::make_unique<PeakStage>(rate, layout->nb_channels, opts.peaks));
+  }
+  if (!opts.spectrum.empty()) {
+    out->chain.add(std::make_unique<SpectrumStage>(rate, opts.spectrum, opts.spectrum_size));
+  }
+}
 
-    encode(c, frame, pkt, stream, format_context);
+// post-decode stage and S16 output of `nb_samples` planar float samples.
+static int write_output(DecodeOutput *out, float *const *planes, int channels, int nb_samples) {
+  if (out->chain.process(planes, channels, nb_samples) < 0) {
+    LOGE("post-decode stage failed.");
+    return -1;
   }
 
-  // send null to encode, flush.
-  encode(c, nullptr, pkt, stream, format_context);
-  av_write_trailer(format_context);
+  const PcmDsp *dsp = pcm_dsp_get();
+  out->pcm.resize((size_t)nb_samples * channels);
+  if (out->dither) {
+    dsp->float_planar_to_s16_dither(out->pcm.data(), planes, channels, nb_samples, &out->dither_seed);
+  } else {
+    dsp->float_planar_to_s16(out->pcm.data(), planes, channels, nb_samples);
+  }
+  if (out->file) {
+    fwrite(out->pcm.data(), sizeof(int16_t), out->pcm.size(), out->file);
+  }
   return 0;
 }
 
+// resampled when asked to, then through write_output().
+static int output_frame(DecodeOutput *out, float *const *planes, const AVChannelLayout *layout, int nb_samples,
+                        int sample_rate) {
+  if (!out->layout.nb_channels) {
+    start_output(out, layout, sample_rate);
+  }
+  const int channels = layout->nb_channels;
+  if (channels != out->layout.nb_channels) {
+    LOGE("channel count changes from %d to %d", out->layout.nb_channels, channels);
+    return -1;
+  }
+  if (out->out_rate > 0 && !out->resampler && sample_rate != out->out_rate) {
+    out->resampler = Resampler::create(sample_rate, out->out_rate, channels, out->quality);
+    if (!out->resampler) {
+      LOGE("can't resample %d Hz to %d Hz", sample_rate, out->out_rate);
+      return -1;
+    }
+  }
+  if (out->resampler) {
+    nb_samples = out->resampler->process(planes, nb_samples);
+    planes = out->resampler->output();
+  }
+  return write_output(out, planes, channels, nb_samples);
+}
 
-void decode(AVCodecContext* codec_ctx, SwrContext *swr_ctx, AVPacket* packet, AVFrame* frame, FILE* file) {
+void decode(AVCodecContext* codec_ctx, AVPacket* packet, AVFrame* frame, DecodeOutput *out) {
   int ret = avcodec_send_packet(codec_ctx, packet);
   if (ret < 0) {
     LOGE("send packet to decoder failed, reason: %s", av_err2str(ret));
@@ -310,74 +753,107 @@ void decode(AVCodecContext* codec_ctx, SwrContext *swr_ctx, AVPacket* packet, AV
     }
 
 
-    uint8_t **dst_data = nullptr;
-    int dst_linesize;
-    av_samples_alloc_array_and_samples(&dst_data, &dst_linesize, codec_ctx->ch_layout.nb_channels,
-                                       frame->nb_samples, AV_SAMPLE_FMT_S16, 0);
-
-    //在采样率相同的情况下，output 的 fmt 通常等于 输入的 fmt
-    int actual_out_sample = swr_convert(swr_ctx, dst_data, frame->nb_samples, (const uint8_t**)frame->data, frame->nb_samples);
-    if (actual_out_sample < 0) {
-      LOGE("resample failed.");
-      break;
+    int channels = frame->ch_layout.nb_channels;
+    int nb_samples = frame->nb_samples;
+    float *const *planes;
+    if (!out->layout.nb_channels) {
+      start_output(out, &frame->ch_layout, frame->sample_rate);
+    }
+    if (frame->format == AV_SAMPLE_FMT_FLTP) {
+      if (!out->chain.empty() && av_frame_make_writable(frame) < 0) {
+        LOGE("av_frame_make_writable failed.");
+        break;
+      }
+      planes = (float *const *)frame->extended_data;
+    } else {
+      // planar float is what the post-decode stage and the S16 writer work on, AAC already decodes to it.
+      if (!out->swr_ctx &&
+          (swr_alloc_set_opts2(&out->swr_ctx, &frame->ch_layout, AV_SAMPLE_FMT_FLTP, frame->sample_rate,
+                               &frame->ch_layout, (AVSampleFormat)frame->format, frame->sample_rate, 0, nullptr) < 0 ||
+           swr_init(out->swr_ctx) < 0)) {
+        LOGE("swr_init failed");
+        swr_free(&out->swr_ctx);
+        break;
+      }
+      if (nb_samples > out->fltp_samples) {
+        if (out->fltp) {
+          av_freep(&out->fltp[0]);
+        }
+        av_freep(&out->fltp);
+        if (av_samples_alloc_array_and_samples(&out->fltp, nullptr, channels, nb_samples,
+                                               AV_SAMPLE_FMT_FLTP, 0) < 0) {
+          LOGE("alloc planar float buffer failed.");
+          out->fltp_samples = 0;
+          break;
+        }
+        out->fltp_samples = nb_samples;
+      }
+      //在采样率相同的情况下，output 的 fmt 通常等于 输入的 fmt
+      nb_samples = swr_convert(out->swr_ctx, out->fltp, nb_samples, (const uint8_t**)frame->extended_data, nb_samples);
+      if (nb_samples < 0) {
+        LOGE("resample failed.");
+        break;
+      }
+      planes = (float *const *)out->fltp;
     }
 
-    int actual_write_size = av_samples_get_buffer_size(nullptr, codec_ctx->ch_layout.nb_channels, actual_out_sample, AV_SAMPLE_FMT_S16, 1);
-    if (file) {
-      fwrite(dst_data[0], 1, actual_write_size, file);
+    if (output_frame(out, planes, &frame->ch_layout, nb_samples, frame->sample_rate) < 0) {
+      break;
     }
 
-    av_free(dst_data[0]);
-    av_free(dst_data);
     av_frame_unref(frame);
   }
 }
 
 extern "C"
 JNIEXPORT jint JNICALL
-Java_com_soundvision_audio_1encoder_MainActivity_nativeDecode(JNIEnv *env, jobject thiz, jstring input_path, jstring output_path) {
+audio_core_decode(JNIEnv *env, jobject thiz, jstring input_path, jstring output_path, jstring options) {
   const char* aac_file = env->GetStringUTFChars(input_path, nullptr);
   const char* pcm_file = env->GetStringUTFChars(output_path, nullptr);
+  const char* opt_str = env->GetStringUTFChars(options, nullptr);
 
   int ret = -1;
+  DecodeOptions opts;
+  DecodeOutput output;
   AVFormatContext *format_ctx = nullptr;
   AVCodecContext *codec_ctx = nullptr;
   const AVCodec *codec;
   AVPacket *packet = nullptr;
   AVFrame *frame = nullptr;
-  SwrContext *swr_ctx = nullptr;
   FILE *out_file = nullptr;
   int stream_index = -1;
+  std::unique_ptr<AdtsDemuxer> adts;
+  AVCodecParameters *par = nullptr;
 
-  // 打开输入文件
-  ret = avformat_open_input(&format_ctx, aac_file, nullptr, nullptr);
+  ret = parse_decode_options(opt_str, &opts);
   if (ret < 0) {
-    LOGE("avformat_open_input failed: %s", av_err2str(ret));
+    LOGE("parse decode options failed: %s", av_err2str(ret));
     goto end;
   }
 
-  // 获取流信息
-  ret = avformat_find_stream_info(format_ctx, nullptr);
-  if (ret < 0) {
-    LOGE("avformat_find_stream_info failed: %s", av_err2str(ret));
+  par = avcodec_parameters_alloc();
+  if (!par) {
+    ret = -1;
     goto end;
   }
-
-  // 查找音频流
-  for (int i = 0; i < format_ctx->nb_streams; i++) {
-    if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-      stream_index = i;
-      break;
+  // a raw .aac is mapped and split at its frame headers, without probing; anything else goes through
+  // libavformat, probed once per file.
+  adts = AdtsDemuxer::open(aac_file);
+  if (adts) {
+    ret = adts->parameters(par);
+    if (ret < 0) {
+      LOGE("adts: no stream parameters");
+      goto end;
+    }
+  } else {
+    ret = open_audio_input(aac_file, &format_ctx, &stream_index, par);
+    if (ret < 0) {
+      goto end;
     }
-  }
-
-  if (stream_index == -1) {
-    LOGE("can't find stream_index");
-    goto end;
   }
 
   // 获取解码器
-  codec = avcodec_find_decoder(format_ctx->streams[stream_index]->codecpar->codec_id);
+  codec = avcodec_find_decoder(par->codec_id);
   if (!codec) {
     LOGE("can't find decoder.");
     goto end;
@@ -391,7 +867,7 @@ Java_com_soundvision_audio_1encoder_MainActivity_nativeDecode(JNIEnv *env, jobje
   }
 
   // 从流参数填充解码器上下文
-  ret = avcodec_parameters_to_context(codec_ctx, format_ctx->streams[stream_index]->codecpar);
+  ret = avcodec_parameters_to_context(codec_ctx, par);
   if (ret < 0) {
     LOGE("avcodec_parameters_to_context failed: %s", av_err2str(ret));
     goto end;
@@ -413,16 +889,10 @@ Java_com_soundvision_audio_1encoder_MainActivity_nativeDecode(JNIEnv *env, jobje
     goto end;
   }
 
-  ret = swr_alloc_set_opts2(&swr_ctx, &codec_ctx->ch_layout, AV_SAMPLE_FMT_S16, codec_ctx->sample_rate, &codec_ctx->ch_layout, codec_ctx->sample_fmt, codec_ctx->sample_rate, 0, nullptr);
-  if (ret < 0) {
-    LOGE("swr_alloc_set_opts2 failed, reason: %s", av_err2str(ret));
-    goto end;
-  }
-
-  if (!swr_ctx || swr_init(swr_ctx) < 0) {
-    LOGE("swr_init failed");
-    goto end;
-  }
+  output.opts = &opts;
+  output.out_rate = opts.sample_rate;
+  output.quality = (ResampleQuality)opts.resample_quality;
+  output.dither = opts.dither;
 
   // 打开输出文件
   out_file = fopen(pcm_file, "wb");
@@ -432,16 +902,44 @@ Java_com_soundvision_audio_1encoder_MainActivity_nativeDecode(JNIEnv *env, jobje
     goto end;
   }
 
-  while (av_read_frame(format_ctx, packet) >= 0) {
-      if (packet->stream_index == stream_index) {
-          decode(codec_ctx, swr_ctx, packet, frame, out_file);
+  output.file = out_file;
+  // ADTS frames can be found without decoding, so a raw .aac is cut up and decoded on several threads.
+  if (adts && opts.threads != 1 && codec_ctx->sample_fmt == AV_SAMPLE_FMT_FLTP) {
+    ret = decode_adts_parallel(*adts, par, opts.threads,
+                               [&output](float *const *planes, const AVChannelLayout *layout, int nb_samples,
+                                         int sample_rate) {
+                                 return output_frame(&output, planes, layout, nb_samples, sample_rate);
+                               });
+    if (ret < 0) {
+      LOGE("parallel decode failed: %s", av_err2str(ret));
+      goto end;
+    }
+  } else {
+    if (adts) {
+      for (int64_t i = 0; i < adts->nb_frames() && adts->packet(i, packet) >= 0; i++) {
+        decode(codec_ctx, packet, frame, &output);
+        av_packet_unref(packet);
+      }
+    } else {
+      while (av_read_frame(format_ctx, packet) >= 0) {
+        if (packet->stream_index == stream_index) {
+          decode(codec_ctx, packet, frame, &output);
+        }
+        av_packet_unref(packet);
+      }
     }
-    av_packet_unref(packet);
-  }
 
-  packet->data = nullptr;
-  packet->size = 0;
-  decode(codec_ctx, swr_ctx, packet, frame, out_file);
+    packet->data = nullptr;
+    packet->size = 0;
+    decode(codec_ctx, packet, frame, &output);
+  }
+  if (output.resampler) {
+    int nb_samples = output.resampler->flush();
+    if (nb_samples > 0) {
+      write_output(&output, output.resampler->output(), output.layout.nb_channels, nb_samples);
+    }
+  }
+  output.chain.finish();
 
   ret = 0;
   end:
@@ -449,9 +947,6 @@ Java_com_soundvision_audio_1encoder_MainActivity_nativeDecode(JNIEnv *env, jobje
   if (out_file) {
     fclose(out_file);
   }
-  if (swr_ctx) {
-    swr_free(&swr_ctx);
-  }
   if (frame) {
     av_frame_free(&frame);
   }
@@ -464,9 +959,11 @@ Java_com_soundvision_audio_1encoder_MainActivity_nativeDecode(JNIEnv *env, jobje
   if (format_ctx) {
     avformat_close_input(&format_ctx);
   }
+  avcodec_parameters_free(&par);
 
   env->ReleaseStringUTFChars(input_path, aac_file);
   env->ReleaseStringUTFChars(output_path, pcm_file);
+  env->ReleaseStringUTFChars(options, opt_str);
 
   return ret;
 }
\ No newline at end of file
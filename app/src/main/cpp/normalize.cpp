@@ -0,0 +1,131 @@
+#include "normalize.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define MEASURE_BLOCK 4096
+#define MAX_GAIN_DB 20.0f
+#define LOOKAHEAD_MS 5
+#define RELEASE_MS 80
+
+LoudnessResult measure_s16(const int16_t *pcm, const std::vector<PcmRange> &ranges, int sample_rate,
+                           const AVChannelLayout *layout, const ChannelMatrix *remix, PcmStage *pre) {
+  const PcmDsp *dsp = pcm_dsp_get();
+  const int in_channels = layout->nb_channels;
+  const int channels = remix ? remix->out_channels() : in_channels;
+  LoudnessMeter meter(sample_rate, remix ? remix->out_layout() : layout);
+  std::vector<float> scratch((size_t)channels * MEASURE_BLOCK);
+  std::vector<float *> planes(channels);
+  for (int c = 0; c < channels; c++) {
+    planes[c] = scratch.data() + (size_t)c * MEASURE_BLOCK;
+  }
+  std::vector<float> raw;
+  std::vector<float *> raw_planes(in_channels);
+  if (remix) {
+    raw.resize((size_t)in_channels * MEASURE_BLOCK);
+    for (int c = 0; c < in_channels; c++) {
+      raw_planes[c] = raw.data() + (size_t)c * MEASURE_BLOCK;
+    }
+  }
+
+  for (const PcmRange &r : ranges) {
+    for (int64_t pos = r.start; pos < r.end; pos += MEASURE_BLOCK) {
+      int n = (int)std::min<int64_t>(MEASURE_BLOCK, r.end - pos);
+      if (remix) {
+        dsp->s16_to_float_planar(raw_planes.data(), pcm + pos * in_channels, in_channels, n);
+        remix->process(planes.data(), raw_planes.data(), n);
+      } else {
+        dsp->s16_to_float_planar(planes.data(), pcm + pos * channels, channels, n);
+      }
+      if (pre) {
+        pre->process(planes.data(), channels, n);
+      }
+      meter.add(planes.data(), n);
+    }
+  }
+  return meter.result();
+}
+
+float normalize_gain(const LoudnessResult &measured, float target_lufs) {
+  if (std::isinf(measured.integrated)) {
+    return 0.0f;
+  }
+  return std::min((float)(target_lufs - measured.integrated), MAX_GAIN_DB);
+}
+
+NormalizeStage::NormalizeStage(float gain_db, float ceiling_dbtp, bool limit, int sample_rate, int channels)
+    : dsp_(pcm_dsp_get()),
+      gain_(db_to_gain(gain_db)),
+      ceiling_(db_to_gain(ceiling_dbtp)),
+      limit_(limit),
+      lookahead_(std::max(1, sample_rate * LOOKAHEAD_MS / 1000)),
+      delay_(lookahead_ + TRUE_PEAK_DELAY),
+      release_(1.0f - expf(-1.0f / (sample_rate * RELEASE_MS / 1000.0f))),
+      true_peak_(channels),
+      line_(channels, std::vector<float>(delay_, 0.0f)),
+      ring_(lookahead_, 1.0f),
+      ring_sum_(lookahead_) {
+}
+
+int NormalizeStage::process(float *const *planes, int channels, int nb_samples) {
+  for (int c = 0; c < channels; c++) {
+    dsp_->gain(planes[c], gain_, nb_samples);
+  }
+  if (!limit_) {
+    return 0;
+  }
+
+  peaks_.assign(nb_samples, 0.0f);
+  tmp_.resize(nb_samples);
+  for (int c = 0; c < channels; c++) {
+    true_peak_[c].process(planes[c], nb_samples, tmp_.data());
+    for (int i = 0; i < nb_samples; i++) {
+      peaks_[i] = std::max(peaks_[i], tmp_[i]);
+    }
+  }
+
+  // gains_[i] applies to the sample delay_ behind input i. The interpolated peaks come
+  // TRUE_PEAK_DELAY late, so the minimum spans that much more than the ramp: every gain
+  // averaged into a sample's ramp has seen every peak that sample could be part of.
+  gains_.resize(nb_samples);
+  for (int i = 0; i < nb_samples; i++, pos_++) {
+    float required = peaks_[i] > ceiling_ ? ceiling_ / peaks_[i] : 1.0f;
+    while (!window_.empty() && window_.back().second >= required) {
+      window_.pop_back();
+    }
+    window_.emplace_back(pos_, required);
+    while (window_.front().first < pos_ - delay_) {
+      window_.pop_front();
+    }
+    float held = window_.front().second;
+
+    ring_sum_ += held - ring_[ring_pos_];
+    ring_[ring_pos_] = held;
+    ring_pos_ = ring_pos_ + 1 == lookahead_ ? 0 : ring_pos_ + 1;
+    float smoothed = (float)(ring_sum_ / lookahead_);
+
+    // attack is already a ramp, release slowly so the gain doesn't pump.
+    envelope_ = smoothed < envelope_ ? smoothed : envelope_ + release_ * (smoothed - envelope_);
+    gains_[i] = envelope_;
+  }
+
+  for (int c = 0; c < channels; c++) {
+    std::vector<float> &line = line_[c];
+    line.resize(delay_ + nb_samples);
+    std::copy(planes[c], planes[c] + nb_samples, line.begin() + delay_);
+    const float *src = line.data();
+    const float *g = gains_.data();
+    float *dst = planes[c];
+    int i = 0;
+    for (; i + 4 <= nb_samples; i += 4) {
+      f32x4_store(dst + i, f32x4_mul(f32x4_load(src + i), f32x4_load(g + i)));
+    }
+    for (; i < nb_samples; i++) {
+      dst[i] = src[i] * g[i];
+    }
+    std::copy(line.end() - delay_, line.end(), line.begin());
+    line.resize(delay_);
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef AUDIO_ENCODER_NORMALIZE_H
+#define AUDIO_ENCODER_NORMALIZE_H
+
+#include <stdint.h>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "channel_matrix.h"
+#include "loudness.h"
+#include "pcm_stage.h"
+#include "silence.h"
+
+/**
+ * First pass of a loudness-normalized encode: measures the `ranges` of interleaved
+ * S16 input in `layout`, back to back, the way they will reach the encoder, i.e.
+ * after `remix` and `pre` when given. Runs on the SIMD kernels only, no codec involved.
+ */
+LoudnessResult measure_s16(const int16_t *pcm, const std::vector<PcmRange> &ranges, int sample_rate,
+                           const AVChannelLayout *layout, const ChannelMatrix *remix, PcmStage *pre);
+
+/** Gain in dB taking `measured` to `target_lufs`, capped so near-silence isn't blown up. */
+float normalize_gain(const LoudnessResult &measured, float target_lufs);
+
+/**
+ * Second pass: applies the normalization gain, then a lookahead true-peak limiter
+ * keeping the output under the ceiling. With `limit` false it is gain only and
+ * adds no latency.
+ */
+class NormalizeStage : public PcmStage {
+ public:
+  NormalizeStage(float gain_db, float ceiling_dbtp, bool limit, int sample_rate, int channels);
+
+  int process(float *const *planes, int channels, int nb_samples) override;
+
+  int latency() const override { return limit_ ? delay_ : 0; }
+
+ private:
+  const PcmDsp *dsp_;
+  float gain_;
+  float ceiling_;
+  bool limit_;
+  int lookahead_;
+  // lookahead_ plus the true-peak interpolator's delay: how far the audio is held back.
+  int delay_;
+  float release_;
+
+  std::vector<TruePeakFilter> true_peak_;
+  // delay line per channel: delay_ pending samples followed by the current block.
+  std::vector<std::vector<float>> line_;
+  std::vector<float> peaks_;
+  std::vector<float> tmp_;
+  std::vector<float> gains_;
+
+  // sliding minimum of the required gain over the last delay_ peaks, (sample index, gain).
+  std::deque<std::pair<int64_t, float>> window_;
+  // moving average of that minimum, which turns gain steps into ramps of lookahead_ samples.
+  std::vector<float> ring_;
+  int ring_pos_ = 0;
+  double ring_sum_;
+  float envelope_ = 1.0f;
+  int64_t pos_ = 0;
+};
+
+#endif //AUDIO_ENCODER_NORMALIZE_H
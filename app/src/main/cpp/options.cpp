@@ -0,0 +1,399 @@
+#include "options.h"
+#include "base.h"
+#include "resampler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+}
+
+static int parse_float(const char *key, const char *value, float *out) {
+  char *end = nullptr;
+  float v = strtof(value, &end);
+  if (end == value || *end != '\0') {
+    LOGE("option %s: '%s' is not a number", key, value);
+    return AVERROR(EINVAL);
+  }
+  *out = v;
+  return 0;
+}
+
+static int parse_int(const char *key, const char *value, int *out) {
+  char *end = nullptr;
+  long v = strtol(value, &end, 10);
+  if (end == value || *end != '\0') {
+    LOGE("option %s: '%s' is not an integer", key, value);
+    return AVERROR(EINVAL);
+  }
+  *out = (int)v;
+  return 0;
+}
+
+static int parse_bool(const char *key, const char *value, bool *out) {
+  int v = 0;
+  int ret = parse_int(key, value, &v);
+  if (ret < 0) {
+    return ret;
+  }
+  *out = v != 0;
+  return 0;
+}
+
+// "a|b|c" -> {"a", "b", "c"}
+static std::vector<std::string> split_list(const char *value) {
+  std::vector<std::string> items;
+  const char *p = value;
+  while (*p) {
+    const char *sep = strchr(p, '|');
+    size_t len = sep ? (size_t)(sep - p) : strlen(p);
+    if (len > 0) {
+      items.emplace_back(p, len);
+    }
+    p += len + (sep ? 1 : 0);
+  }
+  return items;
+}
+
+// a layout the encoders take: named channels in native order, at most 8 of them.
+static int check_layout(const char *key, const char *value) {
+  AVChannelLayout layout = {};
+  int ret = av_channel_layout_from_string(&layout, value);
+  if (ret == 0 && (layout.order != AV_CHANNEL_ORDER_NATIVE || layout.nb_channels > 8)) {
+    ret = AVERROR(EINVAL);
+  }
+  av_channel_layout_uninit(&layout);
+  if (ret < 0) {
+    LOGE("option %s: '%s' is not a channel layout of up to 8 named channels", key, value);
+    return AVERROR(EINVAL);
+  }
+  return 0;
+}
+
+// "a,b,c|d,e,f" -> {a, b, c, d, e, f}, every row as wide as the first.
+static int parse_matrix(const char *key, const char *value, std::vector<float> *out) {
+  out->clear();
+  size_t width = 0;
+  for (const std::string &row : split_list(value)) {
+    size_t start = out->size();
+    size_t pos = 0;
+    while (pos <= row.size()) {
+      size_t end = std::min(row.find(',', pos), row.size());
+      float v = 0.0f;
+      int ret = parse_float(key, row.substr(pos, end - pos).c_str(), &v);
+      if (ret < 0) {
+        return ret;
+      }
+      out->push_back(v);
+      pos = end + 1;
+    }
+    if (width == 0) {
+      width = out->size() - start;
+    } else if (out->size() - start != width) {
+      LOGE("option %s: rows of %zu and %zu coefficients", key, width, out->size() - start);
+      return AVERROR(EINVAL);
+    }
+  }
+  return 0;
+}
+
+// "fast", "medium", "high" -> ResampleQuality.
+static int parse_resample_quality(const char *key, const char *value, int *out) {
+  static const char *const names[] = {"fast", "medium", "high"};
+  for (int i = 0; i < 3; i++) {
+    if (!strcmp(names[i], value)) {
+      *out = i;
+      return 0;
+    }
+  }
+  LOGE("option %s must be fast, medium or high, got %s", key, value);
+  return AVERROR(EINVAL);
+}
+
+// returns 1 when the key belongs to DspOptions, 0 when it doesn't, < 0 on a bad value.
+static int parse_dsp_option(const char *key, const char *value, DspOptions *dsp) {
+  int ret;
+  if (!strcmp(key, "gain")) {
+    ret = parse_float(key, value, &dsp->gain_db);
+  } else if (!strcmp(key, "fade_in")) {
+    ret = parse_int(key, value, &dsp->fade_in_ms);
+  } else if (!strcmp(key, "soft_clip")) {
+    ret = parse_float(key, value, &dsp->soft_clip);
+    if (ret == 0 && (dsp->soft_clip < 0.0f || dsp->soft_clip >= 1.0f)) {
+      LOGE("option soft_clip must be in [0, 1), got %s", value);
+      ret = AVERROR(EINVAL);
+    }
+  } else {
+    return 0;
+  }
+  return ret < 0 ? ret : 1;
+}
+
+// the rates and frame lengths an Opus stream can carry.
+static int check_opus_options(const EncodeOptions *opts) {
+  static const int rates[] = {8000, 12000, 16000, 24000, 48000};
+  static const float durations[] = {2.5f, 5.0f, 10.0f, 20.0f, 40.0f, 60.0f};
+  if (opts->sample_rate > 0 && std::find(std::begin(rates), std::end(rates), opts->sample_rate) == std::end(rates)) {
+    LOGE("opus sample_rate must be 8000, 12000, 16000, 24000 or 48000, got %d", opts->sample_rate);
+    return AVERROR(EINVAL);
+  }
+  if (opts->profile != "auto") {
+    LOGE("option profile is for codec=aac, got %s", opts->profile.c_str());
+    return AVERROR(EINVAL);
+  }
+  if (std::find(std::begin(durations), std::end(durations), opts->frame_duration) == std::end(durations)) {
+    LOGE("opus frame_duration must be 2.5, 5, 10, 20, 40 or 60, got %g", opts->frame_duration);
+    return AVERROR(EINVAL);
+  }
+  return 0;
+}
+
+// AAC object types, not all of them are an exact FF_PROFILE_AAC_* name.
+static int check_aac_profile(const char *value) {
+  static const char *const profiles[] = {"auto", "lc", "he", "hev2", "ld", "eld"};
+  for (const char *p : profiles) {
+    if (!strcmp(p, value)) {
+      return 0;
+    }
+  }
+  LOGE("option profile must be auto, lc, he, hev2, ld or eld, got %s", value);
+  return AVERROR(EINVAL);
+}
+
+// the archive is the source bit for bit, in its own format.
+static int check_flac_options(const EncodeOptions *opts) {
+  if (opts->dsp.enabled() || !opts->mix.empty() || opts->normalize || opts->silence.enabled() ||
+      !opts->peaks.empty() || opts->bitrate || opts->sample_rate || opts->auto_rate || opts->channels ||
+      opts->resample_quality != RESAMPLE_MEDIUM ||
+      !opts->layout.empty() || !opts->matrix.empty() || opts->profile != "auto" || opts->latency_ms) {
+    LOGE("codec=flac encodes the source as is, processing and format options don't apply");
+    return AVERROR(EINVAL);
+  }
+  return 0;
+}
+
+static int parse_dict(const char *str, AVDictionary **dict) {
+  if (!str || !*str) {
+    return 0;
+  }
+  int ret = av_dict_parse_string(dict, str, "=", ":", 0);
+  if (ret < 0) {
+    LOGE("malformed options '%s'", str);
+  }
+  return ret;
+}
+
+int parse_encode_options(const char *str, EncodeOptions *opts) {
+  AVDictionary *dict = nullptr;
+  int ret = parse_dict(str, &dict);
+  const AVDictionaryEntry *e = nullptr;
+  while (ret >= 0 && (e = av_dict_iterate(dict, e))) {
+    ret = parse_dsp_option(e->key, e->value, &opts->dsp);
+    if (ret != 0) {
+      continue;
+    }
+    if (!strcmp(e->key, "codec")) {
+      opts->codec = e->value;
+      if (opts->codec != "aac" && opts->codec != "opus" && opts->codec != "flac") {
+        LOGE("option codec must be aac, opus or flac, got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "backend")) {
+      opts->backend = e->value;
+      if (opts->backend != "ffmpeg" && opts->backend != "mediacodec") {
+        LOGE("option backend must be ffmpeg or mediacodec, got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "bitrate")) {
+      ret = parse_int(e->key, e->value, &opts->bitrate);
+    } else if (!strcmp(e->key, "sample_rate")) {
+      ret = parse_int(e->key, e->value, &opts->sample_rate);
+    } else if (!strcmp(e->key, "resample")) {
+      ret = parse_resample_quality(e->key, e->value, &opts->resample_quality);
+    } else if (!strcmp(e->key, "auto_rate")) {
+      ret = parse_bool(e->key, e->value, &opts->auto_rate);
+    } else if (!strcmp(e->key, "channels")) {
+      ret = parse_int(e->key, e->value, &opts->channels);
+      if (ret == 0 && (opts->channels < 1 || opts->channels > 2)) {
+        LOGE("option channels must be 1 or 2, got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "in_layout")) {
+      opts->in_layout = e->value;
+      ret = check_layout(e->key, e->value);
+    } else if (!strcmp(e->key, "layout")) {
+      opts->layout = e->value;
+      ret = check_layout(e->key, e->value);
+    } else if (!strcmp(e->key, "matrix")) {
+      ret = parse_matrix(e->key, e->value, &opts->matrix);
+    } else if (!strcmp(e->key, "dual_mono")) {
+      ret = parse_float(e->key, e->value, &opts->dual_mono_db);
+      if (ret == 0 && opts->dual_mono_db > 0.0f) {
+        LOGE("option dual_mono is a level under the mid in dB (<= 0), got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "profile")) {
+      opts->profile = e->value;
+      ret = check_aac_profile(e->value);
+    } else if (!strcmp(e->key, "latency")) {
+      ret = parse_int(e->key, e->value, &opts->latency_ms);
+    } else if (!strcmp(e->key, "frame_duration")) {
+      ret = parse_float(e->key, e->value, &opts->frame_duration);
+    } else if (!strcmp(e->key, "complexity")) {
+      ret = parse_int(e->key, e->value, &opts->complexity);
+      if (ret == 0 && (opts->complexity < 0 || opts->complexity > 10)) {
+        LOGE("option complexity must be in [0, 10], got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "compression_level")) {
+      ret = parse_int(e->key, e->value, &opts->compression_level);
+      if (ret == 0 && (opts->compression_level < 0 || opts->compression_level > 12)) {
+        LOGE("option compression_level must be in [0, 12], got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "threads")) {
+      ret = parse_int(e->key, e->value, &opts->threads);
+    } else if (!strcmp(e->key, "dtx")) {
+      ret = parse_bool(e->key, e->value, &opts->dtx);
+    } else if (!strcmp(e->key, "fec")) {
+      ret = parse_bool(e->key, e->value, &opts->fec);
+    } else if (!strcmp(e->key, "mix")) {
+      opts->mix = split_list(e->value);
+    } else if (!strcmp(e->key, "mix_gain")) {
+      opts->mix_gain_db.clear();
+      for (const std::string &item : split_list(e->value)) {
+        float db = 0.0f;
+        ret = parse_float(e->key, item.c_str(), &db);
+        if (ret < 0) {
+          break;
+        }
+        opts->mix_gain_db.push_back(db);
+      }
+    } else if (!strcmp(e->key, "normalize")) {
+      opts->normalize = true;
+      ret = parse_float(e->key, e->value, &opts->target_lufs);
+    } else if (!strcmp(e->key, "true_peak")) {
+      ret = parse_float(e->key, e->value, &opts->true_peak);
+    } else if (!strcmp(e->key, "silence")) {
+      ret = parse_float(e->key, e->value, &opts->silence.threshold_db);
+    } else if (!strcmp(e->key, "silence_hangover")) {
+      ret = parse_int(e->key, e->value, &opts->silence.hangover_ms);
+    } else if (!strcmp(e->key, "silence_gap")) {
+      ret = parse_int(e->key, e->value, &opts->silence.max_gap_ms);
+    } else if (!strcmp(e->key, "silence_peak")) {
+      ret = parse_bool(e->key, e->value, &opts->silence.peak);
+    } else if (!strcmp(e->key, "peaks")) {
+      opts->peaks = e->value;
+    } else if (!strcmp(e->key, "cache")) {
+      opts->cache = e->value;
+    } else if (!strcmp(e->key, "cache_size")) {
+      int mb = 0;
+      ret = parse_int(e->key, e->value, &mb);
+      if (ret == 0 && mb < 0) {
+        LOGE("option cache_size must be >= 0, got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+      opts->cache_size_mb = mb;
+    } else {
+      LOGE("unknown encode option '%s'", e->key);
+      ret = AVERROR(EINVAL);
+    }
+  }
+  av_dict_free(&dict);
+  if (ret >= 0 && opts->backend == "mediacodec" && opts->codec != "aac") {
+    LOGE("backend=mediacodec only encodes aac");
+    ret = AVERROR(EINVAL);
+  }
+  if (ret >= 0 && opts->codec == "opus") {
+    ret = check_opus_options(opts);
+  } else if (ret >= 0 && opts->codec == "flac") {
+    ret = check_flac_options(opts);
+  }
+  return ret < 0 ? ret : 0;
+}
+
+int parse_variant_options(const char *shared, const char *variant, EncodeOptions *opts, std::string *combined) {
+  // what one rung of a ladder may change, everything else is the shared input processing.
+  static const char *const keys[] = {"codec", "backend", "bitrate", "sample_rate", "resample", "channels",
+                                     "layout", "profile", "latency", "frame_duration", "complexity", "dtx",
+                                     "fec"};
+  AVDictionary *dict = nullptr;
+  int ret = parse_dict(variant, &dict);
+  const AVDictionaryEntry *e = nullptr;
+  while (ret >= 0 && (e = av_dict_iterate(dict, e))) {
+    auto same = [e](const char *key) { return !strcmp(key, e->key); };
+    if (std::none_of(std::begin(keys), std::end(keys), same)) {
+      LOGE("option %s is shared by every ladder output, it can't be set per output", e->key);
+      ret = AVERROR(EINVAL);
+    }
+  }
+  av_dict_free(&dict);
+  if (ret < 0) {
+    return ret;
+  }
+
+  // the variant comes last, its keys override the shared ones.
+  *combined = shared;
+  if (*variant) {
+    *combined += combined->empty() ? "" : ":";
+    *combined += variant;
+  }
+  ret = parse_encode_options(combined->c_str(), opts);
+  if (ret >= 0 && opts->codec == "flac") {
+    LOGE("codec=flac can't be a ladder output");
+    ret = AVERROR(EINVAL);
+  }
+  return ret;
+}
+
+int parse_decode_options(const char *str, DecodeOptions *opts) {
+  AVDictionary *dict = nullptr;
+  int ret = parse_dict(str, &dict);
+  const AVDictionaryEntry *e = nullptr;
+  while (ret >= 0 && (e = av_dict_iterate(dict, e))) {
+    ret = parse_dsp_option(e->key, e->value, &opts->dsp);
+    if (ret != 0) {
+      continue;
+    }
+    if (!strcmp(e->key, "sample_rate")) {
+      ret = parse_int(e->key, e->value, &opts->sample_rate);
+      if (ret == 0 && (opts->sample_rate < 0 || opts->sample_rate > 384000)) {
+        LOGE("option sample_rate must be in [0, 384000], got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "resample")) {
+      ret = parse_resample_quality(e->key, e->value, &opts->resample_quality);
+    } else if (!strcmp(e->key, "threads")) {
+      ret = parse_int(e->key, e->value, &opts->threads);
+      if (ret == 0 && opts->threads < 0) {
+        LOGE("option threads must be >= 0, got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else if (!strcmp(e->key, "dither")) {
+      ret = parse_bool(e->key, e->value, &opts->dither);
+    } else if (!strcmp(e->key, "loudness")) {
+      opts->loudness = e->value;
+    } else if (!strcmp(e->key, "peaks")) {
+      opts->peaks = e->value;
+    } else if (!strcmp(e->key, "spectrum")) {
+      opts->spectrum = e->value;
+    } else if (!strcmp(e->key, "spectrum_size")) {
+      ret = parse_int(e->key, e->value, &opts->spectrum_size);
+      int n = opts->spectrum_size;
+      if (ret == 0 && (n < 64 || n > 16384 || (n & (n - 1)))) {
+        LOGE("option spectrum_size must be a power of two in [64, 16384], got %s", e->value);
+        ret = AVERROR(EINVAL);
+      }
+    } else {
+      LOGE("unknown decode option '%s'", e->key);
+      ret = AVERROR(EINVAL);
+    }
+  }
+  av_dict_free(&dict);
+  return ret < 0 ? ret : 0;
+}
@@ -0,0 +1,129 @@
+#ifndef AUDIO_ENCODER_OPTIONS_H
+#define AUDIO_ENCODER_OPTIONS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Options handed down from Kotlin as one "key=value:key=value" string, the same
+ * syntax ffmpeg uses for filter options. Unknown keys are rejected so a typo
+ * doesn't silently change nothing.
+ */
+
+// gain / fade-in / soft clip, shared by the pre-encode and post-decode stages.
+struct DspOptions {
+  float gain_db = 0.0f;
+  int fade_in_ms = 0;
+  // soft clip knee in (0, 1), 0 disables.
+  float soft_clip = 0.0f;
+
+  bool enabled() const {
+    return gain_db != 0.0f || fade_in_ms > 0 || soft_clip > 0.0f;
+  }
+};
+
+// silence trimming ahead of the encoder.
+struct SilenceOptions {
+  // "silence=-50": windows whose level stays under this (dBFS) are silent, 0 disables trimming.
+  float threshold_db = 0.0f;
+  // "silence_hangover=200": audio kept around sound so decays and breaths aren't cut (ms).
+  int hangover_ms = 200;
+  // "silence_gap=500": internal silences longer than this are shortened to it (ms), 0 keeps them.
+  int max_gap_ms = 0;
+  // "silence_peak=1": compare the window peak instead of its RMS.
+  bool peak = false;
+
+  bool enabled() const {
+    return threshold_db < 0.0f;
+  }
+};
+
+struct EncodeOptions {
+  // "codec=aac" (default), "codec=opus", the container follows the output file extension,
+  // or "codec=flac", a lossless archive of the source as is (no pre-encode processing).
+  std::string codec = "aac";
+  // "backend=mediacodec" encodes aac with the device's MediaCodec encoder (Android 9+, .aac / .m4a),
+  // "ffmpeg" (default) with libavcodec.
+  std::string backend = "ffmpeg";
+  // 0 keeps the codec default: aac 96 kb/s 44.1 kHz stereo, opus 24 kb/s 48 kHz mono.
+  int bitrate = 0;
+  int sample_rate = 0;
+  int channels = 0;
+  // "resample=fast|medium|high": quality of the rate conversion to the encoder's rate (ResampleQuality).
+  int resample_quality = 1;
+  // "auto_rate=1": outputs without a sample_rate are encoded at 16, 24 or 32 kHz when the measured
+  // bandwidth of the input fits, narrowband speech doesn't need 44.1 kHz.
+  bool auto_rate = false;
+  // "in_layout=5.1": channel layout of the input (mono, stereo, 5.1, 7.1, ...), stereo when empty.
+  // "layout=..." is the encoded layout, overriding channels. The input is remixed to it before the
+  // pre-encode stages, with "matrix=1,0,0.7|0,1,0.7" (out x in, rows split by '|') when given,
+  // swresample's default down / upmix otherwise.
+  std::string in_layout;
+  std::string layout;
+  std::vector<float> matrix;
+  // stereo input whose side signal stays this far (dB) under its mid is encoded as mono at half
+  // the bitrate, unless channels / layout / matrix pin the layout. 0 disables the check.
+  float dual_mono_db = -60.0f;
+  // aac: "profile=lc|he|hev2|ld|eld", auto (default) picks one from the bitrate and "latency",
+  // the delay budget in ms (0 = none). Everything but lc needs libfdk_aac, ld / eld an .m4a output.
+  std::string profile = "auto";
+  int latency_ms = 0;
+  // opus: frame length in ms (2.5, 5, 10, 20, 40, 60), complexity 0..10 (-1 = encoder default),
+  // discontinuous transmission in silence and in-band forward error correction.
+  float frame_duration = 20.0f;
+  int complexity = -1;
+  bool dtx = false;
+  bool fec = false;
+  // flac: compression level 0..12, frames encoded on this many threads (0 = one per core).
+  int compression_level = 5;
+  int threads = 0;
+
+  DspOptions dsp;
+  SilenceOptions silence;
+  // extra PCM assets mixed under the input, same layout as the input (remixed with it): "mix=a.pcm|b.pcm".
+  std::vector<std::string> mix;
+  // per mix input gain in dB: "mix_gain=-12|-18", missing entries default to 0.
+  std::vector<float> mix_gain_db;
+  // two-pass loudness normalization: "normalize=-16" sets the target in LUFS,
+  // "true_peak=-1" the limiter ceiling in dBTP.
+  bool normalize = false;
+  float target_lufs = -16.0f;
+  float true_peak = -1.0f;
+  // min/max waveform pyramid of the encoded audio, written here.
+  std::string peaks;
+  // directory of finished encodes keyed by a digest of input + options, "cache_size" is its budget in MB.
+  std::string cache;
+  int64_t cache_size_mb = 256;
+};
+
+struct DecodeOptions {
+  DspOptions dsp;
+  // output rate, 0 keeps the decoded one; "resample" as for encoding.
+  int sample_rate = 0;
+  int resample_quality = 1;
+  // "threads=4": a raw .aac (ADTS) input is decoded on this many threads, 0 = one per core.
+  int threads = 1;
+  // TPDF dither when reducing float output to S16.
+  bool dither = false;
+  // EBU R128 loudness / true peak / ReplayGain measured on the decoded audio, written as JSON here.
+  std::string loudness;
+  // min/max waveform pyramid of the decoded audio, written here.
+  std::string peaks;
+  // spectrogram of the decoded audio, written here; "spectrum_size" is the FFT length, a power of two.
+  std::string spectrum;
+  int spectrum_size = 2048;
+};
+
+int parse_encode_options(const char *str, EncodeOptions *opts);
+
+/**
+ * One output of an ABR ladder: the shared options with the variant's on top.
+ * The variant may only set codec / format keys, the input processing is done
+ * once for all outputs. `combined` receives the merged option string.
+ */
+int parse_variant_options(const char *shared, const char *variant, EncodeOptions *opts, std::string *combined);
+
+int parse_decode_options(const char *str, DecodeOptions *opts);
+
+#endif //AUDIO_ENCODER_OPTIONS_H
@@ -0,0 +1,117 @@
+#include "packet_sink.h"
+#include "base.h"
+
+#include <string.h>
+
+int PacketSink::write(const uint8_t *data, int size, int64_t pts_us) {
+  uint8_t *dst = begin_packet(size);
+  if (!dst) {
+    return -1;
+  }
+  memcpy(dst, data, (size_t)size);
+  return end_packet(size, pts_us);
+}
+
+AsyncFileWriter::AsyncFileWriter() : chunks_(CHUNK_COUNT) {
+  for (Chunk &chunk : chunks_) {
+    chunk.data.resize(CHUNK_SIZE);
+    free_.push_back(&chunk);
+  }
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  close();
+}
+
+int AsyncFileWriter::open(const char *path) {
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    LOGE("open output file %s failed.", path);
+    return -1;
+  }
+  current_ = free_.back();
+  free_.pop_back();
+  thread_ = std::thread(&AsyncFileWriter::run, this);
+  return 0;
+}
+
+uint8_t *AsyncFileWriter::begin_packet(int size) {
+  if (!current_ || size < 0) {
+    return nullptr;
+  }
+  if (current_->data.size() - current_->fill < (size_t)size) {
+    if (current_->fill > 0 && submit() < 0) {
+      return nullptr;
+    }
+    if (current_->data.size() < (size_t)size) {
+      current_->data.resize((size_t)size);
+    }
+  }
+  return current_->data.data() + current_->fill;
+}
+
+int AsyncFileWriter::end_packet(int size, int64_t pts_us) {
+  current_->fill += (size_t)size;
+  return 0;
+}
+
+int AsyncFileWriter::submit() {
+  std::unique_lock<std::mutex> lock(lock_);
+  full_.push_back(current_);
+  current_ = nullptr;
+  wake_.notify_all();
+  done_.wait(lock, [this] { return !free_.empty() || error_ < 0; });
+  if (error_ < 0) {
+    return error_;
+  }
+  current_ = free_.back();
+  free_.pop_back();
+  current_->fill = 0;
+  return 0;
+}
+
+void AsyncFileWriter::run() {
+  for (;;) {
+    Chunk *chunk;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      wake_.wait(lock, [this] { return !full_.empty() || stop_; });
+      if (full_.empty()) {
+        return;
+      }
+      chunk = full_.front();
+      full_.pop_front();
+    }
+    size_t n = fwrite(chunk->data.data(), 1, chunk->fill, file_);
+    std::lock_guard<std::mutex> lock(lock_);
+    if (n != chunk->fill && error_ == 0) {
+      LOGE("write failed after %lld bytes", (long long)(written_ + n));
+      error_ = -1;
+    }
+    written_ += n;
+    free_.push_back(chunk);
+    done_.notify_all();
+  }
+}
+
+int64_t AsyncFileWriter::close() {
+  if (!file_) {
+    return error_ < 0 ? error_ : written_;
+  }
+  {
+    // the writer thread finishes what is queued before it sees stop_.
+    std::lock_guard<std::mutex> lock(lock_);
+    if (current_ && current_->fill > 0) {
+      full_.push_back(current_);
+    }
+    current_ = nullptr;
+    stop_ = true;
+    wake_.notify_all();
+  }
+  thread_.join();
+  if (fclose(file_) != 0 && error_ == 0) {
+    error_ = -1;
+  }
+  file_ = nullptr;
+  return error_ < 0 ? error_ : written_;
+}
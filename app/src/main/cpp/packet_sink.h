@@ -0,0 +1,87 @@
+#ifndef AUDIO_ENCODER_PACKET_SINK_H
+#define AUDIO_ENCODER_PACKET_SINK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Destination of MediaCodec output buffers handed over from Kotlin: bytes are
+ * taken from the direct ByteBuffer in native code, the JVM heap never sees them.
+ *
+ * A packet is written in place: begin_packet() hands out room for it,
+ * end_packet() commits what was actually filled in, so a producer (the ADTS
+ * packetizer) can build it right in the sink.
+ */
+class PacketSink {
+ public:
+  virtual ~PacketSink() = default;
+
+  /** Room for up to `size` bytes of the next packet, null on error. */
+  virtual uint8_t *begin_packet(int size) = 0;
+
+  /** The packet started by begin_packet() is `size` bytes. Returns < 0 on error. */
+  virtual int end_packet(int size, int64_t pts_us) = 0;
+
+  /** Flushes and releases the destination, returns the bytes written or < 0 on error. */
+  virtual int64_t close() = 0;
+
+  /** begin_packet() + copy + end_packet(). */
+  int write(const uint8_t *data, int size, int64_t pts_us);
+};
+
+/**
+ * File writer with the writes on its own thread: packets are appended to a
+ * chunk, full chunks are written out in the background while the next one
+ * fills. With every chunk in flight the producer waits, so memory stays at
+ * CHUNK_COUNT * CHUNK_SIZE however slow the storage is.
+ */
+class AsyncFileWriter : public PacketSink {
+ public:
+  static const int CHUNK_SIZE = 256 * 1024;
+  static const int CHUNK_COUNT = 4;
+
+  AsyncFileWriter();
+
+  ~AsyncFileWriter() override;
+
+  int open(const char *path);
+
+  uint8_t *begin_packet(int size) override;
+
+  int end_packet(int size, int64_t pts_us) override;
+
+  int64_t close() override;
+
+ private:
+  struct Chunk {
+    std::vector<uint8_t> data;
+    size_t fill = 0;
+  };
+
+  void run();
+  // hands the current chunk to the writer thread and waits for a free one.
+  int submit();
+
+  FILE *file_ = nullptr;
+  std::vector<Chunk> chunks_;
+  // being filled, a packet bigger than CHUNK_SIZE grows it.
+  Chunk *current_ = nullptr;
+  int64_t written_ = 0;
+
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::deque<Chunk *> full_;
+  std::vector<Chunk *> free_;
+  int error_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+#endif //AUDIO_ENCODER_PACKET_SINK_H
@@ -0,0 +1,879 @@
+#include "pcm_dsp.h"
+#include "base.h"
+
+extern "C" {
+#include "libavutil/cpu.h"
+}
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define S16_SCALE 32768.0f
+#define S16_MIN (-32768.0f)
+#define S16_MAX 32767.0f
+
+static inline float clip_s16(float v) {
+  return v < S16_MIN ? S16_MIN : (v > S16_MAX ? S16_MAX : v);
+}
+
+static inline uint32_t lcg_next(uint32_t s) {
+  return s * 1664525u + 1013904223u;
+}
+
+// uniform noise in [-0.5, 0.5) from the top 24 bits of the generator.
+static inline float lcg_uniform(uint32_t s) {
+  return (float)(s >> 8) * (1.0f / 16777216.0f) - 0.5f;
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* scalar reference                                                                               */
+/* ---------------------------------------------------------------------------------------------- */
+
+static void gain_c(float *dst, float gain, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] *= gain;
+  }
+}
+
+static void gain_ramp_c(float *dst, float start, float step, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] *= start + (float)i * step;
+  }
+}
+
+static void mix_c(float *dst, const float *const *src, const float *gains, int nb_src, int n) {
+  for (int i = 0; i < n; i++) {
+    float acc = src[0][i] * gains[0];
+    for (int k = 1; k < nb_src; k++) {
+      acc += src[k][i] * gains[k];
+    }
+    dst[i] = acc;
+  }
+}
+
+static void matrix_c(float *const *dst, const float *const *src, const float *m, int out_ch, int in_ch, int n) {
+  for (int o = 0; o < out_ch; o++) {
+    const float *row = m + o * in_ch;
+    for (int i = 0; i < n; i++) {
+      float acc = src[0][i] * row[0];
+      for (int k = 1; k < in_ch; k++) {
+        acc += src[k][i] * row[k];
+      }
+      dst[o][i] = acc;
+    }
+  }
+}
+
+// samples [i, n) of outputs [o, o + count), the tails the vector loops leave.
+static void matrix_tail(float *const *dst, const float *const *src, const float *m, int o, int count, int in_ch,
+                        int i, int n) {
+  for (int c = o; c < o + count; c++) {
+    const float *row = m + c * in_ch;
+    for (int j = i; j < n; j++) {
+      float acc = src[0][j] * row[0];
+      for (int k = 1; k < in_ch; k++) {
+        acc += src[k][j] * row[k];
+      }
+      dst[c][j] = acc;
+    }
+  }
+}
+
+static float dot_c(const float *a, const float *b, int n) {
+  float acc = 0.0f;
+  for (int i = 0; i < n; i++) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+static void soft_clip_c(float *dst, float knee, int n) {
+  const float inv_range = 1.0f / (1.0f - knee);
+  for (int i = 0; i < n; i++) {
+    float x = dst[i];
+    float a = fabsf(x);
+    if (a > knee) {
+      float over = a - knee;
+      a = knee + over / (1.0f + over * inv_range);
+      dst[i] = copysignf(a, x);
+    }
+  }
+}
+
+static void s16_to_float_planar_c(float *const *dst, const int16_t *src, int channels, int n) {
+  for (int i = 0; i < n; i++) {
+    for (int c = 0; c < channels; c++) {
+      dst[c][i] = (float)*src++ * (1.0f / S16_SCALE);
+    }
+  }
+}
+
+static void float_planar_to_s16_c(int16_t *dst, const float *const *src, int channels, int n) {
+  for (int i = 0; i < n; i++) {
+    for (int c = 0; c < channels; c++) {
+      *dst++ = (int16_t)lrintf(clip_s16(src[c][i] * S16_SCALE));
+    }
+  }
+}
+
+static void float_planar_to_s16_dither_c(int16_t *dst, const float *const *src, int channels, int n,
+                                         uint32_t *seed) {
+  uint32_t s = *seed;
+  for (int i = 0; i < n; i++) {
+    for (int c = 0; c < channels; c++) {
+      s = lcg_next(s);
+      float noise = lcg_uniform(s);
+      s = lcg_next(s);
+      noise += lcg_uniform(s);
+      *dst++ = (int16_t)lrintf(clip_s16(src[c][i] * S16_SCALE + noise));
+    }
+  }
+  *seed = s;
+}
+
+static void interleave_c(float *dst, const float *const *src, int channels, int n) {
+  for (int i = 0; i < n; i++) {
+    for (int c = 0; c < channels; c++) {
+      *dst++ = src[c][i];
+    }
+  }
+}
+
+static void deinterleave_c(float *const *dst, const float *src, int channels, int n) {
+  for (int i = 0; i < n; i++) {
+    for (int c = 0; c < channels; c++) {
+      dst[c][i] = *src++;
+    }
+  }
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* NEON                                                                                           */
+/* ---------------------------------------------------------------------------------------------- */
+
+#if HAVE_NEON
+static void gain_neon(float *dst, float gain, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(dst + i), gain));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vld1q_f32(dst + i + 4), gain));
+  }
+  gain_c(dst + i, gain, n - i);
+}
+
+static void gain_ramp_neon(float *dst, float start, float step, int n) {
+  static const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+  float32x4_t idx = vld1q_f32(lanes);
+  const float32x4_t base = vdupq_n_f32(start);
+  const float32x4_t four = vdupq_n_f32(4.0f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t g = vmlaq_n_f32(base, idx, step);
+    vst1q_f32(dst + i, vmulq_f32(vld1q_f32(dst + i), g));
+    idx = vaddq_f32(idx, four);
+  }
+  gain_ramp_c(dst + i, start + (float)i * step, step, n - i);
+}
+
+static void mix_neon(float *dst, const float *const *src, const float *gains, int nb_src, int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t acc = vmulq_n_f32(vld1q_f32(src[0] + i), gains[0]);
+    for (int k = 1; k < nb_src; k++) {
+      acc = vmlaq_n_f32(acc, vld1q_f32(src[k] + i), gains[k]);
+    }
+    vst1q_f32(dst + i, acc);
+  }
+  for (; i < n; i++) {
+    float acc = src[0][i] * gains[0];
+    for (int k = 1; k < nb_src; k++) {
+      acc += src[k][i] * gains[k];
+    }
+    dst[i] = acc;
+  }
+}
+
+static void matrix_neon(float *const *dst, const float *const *src, const float *m, int out_ch, int in_ch, int n) {
+  int o = 0;
+  for (; o + 2 <= out_ch; o += 2) {
+    const float *r0 = m + o * in_ch;
+    const float *r1 = r0 + in_ch;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+      float32x4_t x = vld1q_f32(src[0] + i);
+      float32x4_t a0 = vmulq_n_f32(x, r0[0]);
+      float32x4_t a1 = vmulq_n_f32(x, r1[0]);
+      for (int k = 1; k < in_ch; k++) {
+        x = vld1q_f32(src[k] + i);
+        a0 = vmlaq_n_f32(a0, x, r0[k]);
+        a1 = vmlaq_n_f32(a1, x, r1[k]);
+      }
+      vst1q_f32(dst[o] + i, a0);
+      vst1q_f32(dst[o + 1] + i, a1);
+    }
+    matrix_tail(dst, src, m, o, 2, in_ch, i, n);
+  }
+  if (o < out_ch) {
+    mix_neon(dst[o], src, m + o * in_ch, in_ch, n);
+  }
+}
+
+static float dot_neon(const float *a, const float *b, int n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  return vaddvq_f32(vaddq_f32(acc0, acc1)) + dot_c(a + i, b + i, n - i);
+}
+
+static void soft_clip_neon(float *dst, float knee, int n) {
+  const float32x4_t vknee = vdupq_n_f32(knee);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float inv_range = 1.0f / (1.0f - knee);
+  const uint32x4_t sign = vdupq_n_u32(0x80000000u);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t x = vld1q_f32(dst + i);
+    float32x4_t a = vabsq_f32(x);
+    float32x4_t over = vmaxq_f32(vsubq_f32(a, vknee), zero);
+    float32x4_t y = vaddq_f32(vminq_f32(a, vknee), vdivq_f32(over, vmlaq_n_f32(one, over, inv_range)));
+    uint32x4_t bits = vorrq_u32(vreinterpretq_u32_f32(y), vandq_u32(vreinterpretq_u32_f32(x), sign));
+    vst1q_f32(dst + i, vreinterpretq_f32_u32(bits));
+  }
+  soft_clip_c(dst + i, knee, n - i);
+}
+
+static inline float32x4_t s16_low_to_f32(int16x8_t v) {
+  return vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / S16_SCALE);
+}
+
+static inline float32x4_t s16_high_to_f32(int16x8_t v) {
+  return vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / S16_SCALE);
+}
+
+static void s16_to_float_planar_neon(float *const *dst, const int16_t *src, int channels, int n) {
+  int i = 0;
+  if (channels == 1) {
+    for (; i + 8 <= n; i += 8) {
+      int16x8_t v = vld1q_s16(src + i);
+      vst1q_f32(dst[0] + i, s16_low_to_f32(v));
+      vst1q_f32(dst[0] + i + 4, s16_high_to_f32(v));
+    }
+  } else if (channels == 2) {
+    for (; i + 8 <= n; i += 8) {
+      int16x8x2_t v = vld2q_s16(src + i * 2);
+      vst1q_f32(dst[0] + i, s16_low_to_f32(v.val[0]));
+      vst1q_f32(dst[0] + i + 4, s16_high_to_f32(v.val[0]));
+      vst1q_f32(dst[1] + i, s16_low_to_f32(v.val[1]));
+      vst1q_f32(dst[1] + i + 4, s16_high_to_f32(v.val[1]));
+    }
+  }
+  if (i == 0) {
+    s16_to_float_planar_c(dst, src, channels, n);
+    return;
+  }
+  float *tail[2];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = dst[c] + i;
+  }
+  s16_to_float_planar_c(tail, src + i * channels, channels, n - i);
+}
+
+static inline int16x4_t f32_to_s16(float32x4_t v) {
+  v = vmulq_n_f32(v, S16_SCALE);
+  return vqmovn_s32(vcvtnq_s32_f32(v));
+}
+
+static void float_planar_to_s16_neon(int16_t *dst, const float *const *src, int channels, int n) {
+  int i = 0;
+  if (channels == 1) {
+    for (; i + 8 <= n; i += 8) {
+      vst1q_s16(dst + i, vcombine_s16(f32_to_s16(vld1q_f32(src[0] + i)),
+                                      f32_to_s16(vld1q_f32(src[0] + i + 4))));
+    }
+  } else if (channels == 2) {
+    for (; i + 8 <= n; i += 8) {
+      int16x8x2_t v;
+      v.val[0] = vcombine_s16(f32_to_s16(vld1q_f32(src[0] + i)), f32_to_s16(vld1q_f32(src[0] + i + 4)));
+      v.val[1] = vcombine_s16(f32_to_s16(vld1q_f32(src[1] + i)), f32_to_s16(vld1q_f32(src[1] + i + 4)));
+      vst2q_s16(dst + i * 2, v);
+    }
+  }
+  if (i == 0) {
+    float_planar_to_s16_c(dst, src, channels, n);
+    return;
+  }
+  const float *tail[2];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = src[c] + i;
+  }
+  float_planar_to_s16_c(dst + i * channels, tail, channels, n - i);
+}
+
+static inline float32x4_t lcg_uniform_neon(uint32x4_t *state) {
+  *state = vmlaq_n_u32(vdupq_n_u32(1013904223u), *state, 1664525u);
+  float32x4_t u = vcvtq_f32_u32(vshrq_n_u32(*state, 8));
+  return vsubq_f32(vmulq_n_f32(u, 1.0f / 16777216.0f), vdupq_n_f32(0.5f));
+}
+
+static inline int16x4_t f32_to_s16_dither(float32x4_t v, uint32x4_t *state) {
+  float32x4_t noise = vaddq_f32(lcg_uniform_neon(state), lcg_uniform_neon(state));
+  v = vmlaq_n_f32(noise, v, S16_SCALE);
+  return vqmovn_s32(vcvtnq_s32_f32(v));
+}
+
+static void float_planar_to_s16_dither_neon(int16_t *dst, const float *const *src, int channels, int n,
+                                            uint32_t *seed) {
+  if (channels > 2) {
+    float_planar_to_s16_dither_c(dst, src, channels, n, seed);
+    return;
+  }
+  uint32_t lanes[4] = {*seed, *seed ^ 0x9e3779b9u, *seed ^ 0x7f4a7c15u, *seed ^ 0xf39cc060u};
+  uint32x4_t state = vld1q_u32(lanes);
+  int i = 0;
+  if (channels == 1) {
+    for (; i + 4 <= n; i += 4) {
+      vst1_s16(dst + i, f32_to_s16_dither(vld1q_f32(src[0] + i), &state));
+    }
+  } else {
+    for (; i + 4 <= n; i += 4) {
+      int16x4x2_t v;
+      v.val[0] = f32_to_s16_dither(vld1q_f32(src[0] + i), &state);
+      v.val[1] = f32_to_s16_dither(vld1q_f32(src[1] + i), &state);
+      vst2_s16(dst + i * 2, v);
+    }
+  }
+  *seed = vgetq_lane_u32(state, 0);
+  const float *tail[2] = {src[0] + i, channels == 2 ? src[1] + i : nullptr};
+  float_planar_to_s16_dither_c(dst + i * channels, tail, channels, n - i, seed);
+}
+
+static void interleave_neon(float *dst, const float *const *src, int channels, int n) {
+  int i = 0;
+  if (channels == 2) {
+    for (; i + 4 <= n; i += 4) {
+      float32x4x2_t v = {{vld1q_f32(src[0] + i), vld1q_f32(src[1] + i)}};
+      vst2q_f32(dst + i * 2, v);
+    }
+  } else if (channels == 3) {
+    for (; i + 4 <= n; i += 4) {
+      float32x4x3_t v = {{vld1q_f32(src[0] + i), vld1q_f32(src[1] + i), vld1q_f32(src[2] + i)}};
+      vst3q_f32(dst + i * 3, v);
+    }
+  } else if (channels == 4) {
+    for (; i + 4 <= n; i += 4) {
+      float32x4x4_t v = {{vld1q_f32(src[0] + i), vld1q_f32(src[1] + i),
+                          vld1q_f32(src[2] + i), vld1q_f32(src[3] + i)}};
+      vst4q_f32(dst + i * 4, v);
+    }
+  }
+  if (i == 0) {
+    interleave_c(dst, src, channels, n);
+    return;
+  }
+  const float *tail[4];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = src[c] + i;
+  }
+  interleave_c(dst + i * channels, tail, channels, n - i);
+}
+
+static void deinterleave_neon(float *const *dst, const float *src, int channels, int n) {
+  int i = 0;
+  if (channels == 2) {
+    for (; i + 4 <= n; i += 4) {
+      float32x4x2_t v = vld2q_f32(src + i * 2);
+      vst1q_f32(dst[0] + i, v.val[0]);
+      vst1q_f32(dst[1] + i, v.val[1]);
+    }
+  } else if (channels == 3) {
+    for (; i + 4 <= n; i += 4) {
+      float32x4x3_t v = vld3q_f32(src + i * 3);
+      for (int c = 0; c < 3; c++) {
+        vst1q_f32(dst[c] + i, v.val[c]);
+      }
+    }
+  } else if (channels == 4) {
+    for (; i + 4 <= n; i += 4) {
+      float32x4x4_t v = vld4q_f32(src + i * 4);
+      for (int c = 0; c < 4; c++) {
+        vst1q_f32(dst[c] + i, v.val[c]);
+      }
+    }
+  }
+  if (i == 0) {
+    deinterleave_c(dst, src, channels, n);
+    return;
+  }
+  float *tail[4];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = dst[c] + i;
+  }
+  deinterleave_c(tail, src + i * channels, channels, n - i);
+}
+#endif
+
+/* ---------------------------------------------------------------------------------------------- */
+/* SSE2 / AVX2                                                                                    */
+/* ---------------------------------------------------------------------------------------------- */
+
+#if HAVE_X86
+static void gain_sse2(float *dst, float gain, int n) {
+  const __m128 g = _mm_set1_ps(gain);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), g));
+  }
+  gain_c(dst + i, gain, n - i);
+}
+
+static void gain_ramp_sse2(float *dst, float start, float step, int n) {
+  __m128 idx = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  const __m128 base = _mm_set1_ps(start);
+  const __m128 vstep = _mm_set1_ps(step);
+  const __m128 four = _mm_set1_ps(4.0f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 g = _mm_add_ps(base, _mm_mul_ps(idx, vstep));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), g));
+    idx = _mm_add_ps(idx, four);
+  }
+  gain_ramp_c(dst + i, start + (float)i * step, step, n - i);
+}
+
+static void mix_sse2(float *dst, const float *const *src, const float *gains, int nb_src, int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 acc = _mm_mul_ps(_mm_loadu_ps(src[0] + i), _mm_set1_ps(gains[0]));
+    for (int k = 1; k < nb_src; k++) {
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src[k] + i), _mm_set1_ps(gains[k])));
+    }
+    _mm_storeu_ps(dst + i, acc);
+  }
+  for (; i < n; i++) {
+    float acc = src[0][i] * gains[0];
+    for (int k = 1; k < nb_src; k++) {
+      acc += src[k][i] * gains[k];
+    }
+    dst[i] = acc;
+  }
+}
+
+static void matrix_sse2(float *const *dst, const float *const *src, const float *m, int out_ch, int in_ch, int n) {
+  int o = 0;
+  for (; o + 2 <= out_ch; o += 2) {
+    const float *r0 = m + o * in_ch;
+    const float *r1 = r0 + in_ch;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m128 x = _mm_loadu_ps(src[0] + i);
+      __m128 a0 = _mm_mul_ps(x, _mm_set1_ps(r0[0]));
+      __m128 a1 = _mm_mul_ps(x, _mm_set1_ps(r1[0]));
+      for (int k = 1; k < in_ch; k++) {
+        x = _mm_loadu_ps(src[k] + i);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(x, _mm_set1_ps(r0[k])));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(x, _mm_set1_ps(r1[k])));
+      }
+      _mm_storeu_ps(dst[o] + i, a0);
+      _mm_storeu_ps(dst[o + 1] + i, a1);
+    }
+    matrix_tail(dst, src, m, o, 2, in_ch, i, n);
+  }
+  if (o < out_ch) {
+    mix_sse2(dst[o], src, m + o * in_ch, in_ch, n);
+  }
+}
+
+static float dot_sse2(const float *a, const float *b, int n) {
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  __m128 acc = _mm_add_ps(acc0, acc1);
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+  return _mm_cvtss_f32(acc) + dot_c(a + i, b + i, n - i);
+}
+
+static void soft_clip_sse2(float *dst, float knee, int n) {
+  const __m128 vknee = _mm_set1_ps(knee);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 inv_range = _mm_set1_ps(1.0f / (1.0f - knee));
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_loadu_ps(dst + i);
+    __m128 a = _mm_andnot_ps(sign, x);
+    __m128 over = _mm_max_ps(_mm_sub_ps(a, vknee), _mm_setzero_ps());
+    __m128 y = _mm_add_ps(_mm_min_ps(a, vknee),
+                          _mm_div_ps(over, _mm_add_ps(one, _mm_mul_ps(over, inv_range))));
+    _mm_storeu_ps(dst + i, _mm_or_ps(y, _mm_and_ps(x, sign)));
+  }
+  soft_clip_c(dst + i, knee, n - i);
+}
+
+static void s16_to_float_planar_sse2(float *const *dst, const int16_t *src, int channels, int n) {
+  const __m128 scale = _mm_set1_ps(1.0f / S16_SCALE);
+  int i = 0;
+  if (channels == 1) {
+    for (; i + 8 <= n; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+      __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+      _mm_storeu_ps(dst[0] + i, _mm_mul_ps(lo, scale));
+      _mm_storeu_ps(dst[0] + i + 4, _mm_mul_ps(hi, scale));
+    }
+  } else if (channels == 2) {
+    for (; i + 4 <= n; i += 4) {
+      // L0 R0 L1 R1 L2 R2 L3 R3
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+      __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+      _mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), scale));
+      _mm_storeu_ps(dst[1] + i, _mm_mul_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)), scale));
+    }
+  }
+  if (i == 0) {
+    s16_to_float_planar_c(dst, src, channels, n);
+    return;
+  }
+  float *tail[2];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = dst[c] + i;
+  }
+  s16_to_float_planar_c(tail, src + i * channels, channels, n - i);
+}
+
+static inline __m128i f32_to_s32_sse2(__m128 v) {
+  v = _mm_mul_ps(v, _mm_set1_ps(S16_SCALE));
+  v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(S16_MIN)), _mm_set1_ps(S16_MAX));
+  return _mm_cvtps_epi32(v);
+}
+
+static void float_planar_to_s16_sse2(int16_t *dst, const float *const *src, int channels, int n) {
+  int i = 0;
+  if (channels == 1) {
+    for (; i + 8 <= n; i += 8) {
+      __m128i v = _mm_packs_epi32(f32_to_s32_sse2(_mm_loadu_ps(src[0] + i)),
+                                  f32_to_s32_sse2(_mm_loadu_ps(src[0] + i + 4)));
+      _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+  } else if (channels == 2) {
+    for (; i + 8 <= n; i += 8) {
+      __m128i l = _mm_packs_epi32(f32_to_s32_sse2(_mm_loadu_ps(src[0] + i)),
+                                  f32_to_s32_sse2(_mm_loadu_ps(src[0] + i + 4)));
+      __m128i r = _mm_packs_epi32(f32_to_s32_sse2(_mm_loadu_ps(src[1] + i)),
+                                  f32_to_s32_sse2(_mm_loadu_ps(src[1] + i + 4)));
+      _mm_storeu_si128((__m128i *)(dst + i * 2), _mm_unpacklo_epi16(l, r));
+      _mm_storeu_si128((__m128i *)(dst + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+    }
+  }
+  if (i == 0) {
+    float_planar_to_s16_c(dst, src, channels, n);
+    return;
+  }
+  const float *tail[2];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = src[c] + i;
+  }
+  float_planar_to_s16_c(dst + i * channels, tail, channels, n - i);
+}
+
+static inline __m128 lcg_uniform_sse2(__m128i *state) {
+  // 32-bit lane multiply without SSE4.1: even and odd lanes separately.
+  const __m128i mul = _mm_set1_epi32(1664525);
+  __m128i even = _mm_mul_epu32(*state, mul);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(*state, 32), mul);
+  __m128i prod = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                    _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+  *state = _mm_add_epi32(prod, _mm_set1_epi32(1013904223));
+  __m128 u = _mm_cvtepi32_ps(_mm_srli_epi32(*state, 8));
+  return _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(1.0f / 16777216.0f)), _mm_set1_ps(0.5f));
+}
+
+static inline __m128i f32_to_s32_dither_sse2(__m128 v, __m128i *state) {
+  __m128 noise = _mm_add_ps(lcg_uniform_sse2(state), lcg_uniform_sse2(state));
+  v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(S16_SCALE)), noise);
+  v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(S16_MIN)), _mm_set1_ps(S16_MAX));
+  return _mm_cvtps_epi32(v);
+}
+
+static void float_planar_to_s16_dither_sse2(int16_t *dst, const float *const *src, int channels, int n,
+                                            uint32_t *seed) {
+  if (channels > 2) {
+    float_planar_to_s16_dither_c(dst, src, channels, n, seed);
+    return;
+  }
+  __m128i state = _mm_setr_epi32((int)*seed, (int)(*seed ^ 0x9e3779b9u),
+                                 (int)(*seed ^ 0x7f4a7c15u), (int)(*seed ^ 0xf39cc060u));
+  int i = 0;
+  if (channels == 1) {
+    for (; i + 8 <= n; i += 8) {
+      __m128i v = _mm_packs_epi32(f32_to_s32_dither_sse2(_mm_loadu_ps(src[0] + i), &state),
+                                  f32_to_s32_dither_sse2(_mm_loadu_ps(src[0] + i + 4), &state));
+      _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+  } else {
+    for (; i + 8 <= n; i += 8) {
+      __m128i l = _mm_packs_epi32(f32_to_s32_dither_sse2(_mm_loadu_ps(src[0] + i), &state),
+                                  f32_to_s32_dither_sse2(_mm_loadu_ps(src[0] + i + 4), &state));
+      __m128i r = _mm_packs_epi32(f32_to_s32_dither_sse2(_mm_loadu_ps(src[1] + i), &state),
+                                  f32_to_s32_dither_sse2(_mm_loadu_ps(src[1] + i + 4), &state));
+      _mm_storeu_si128((__m128i *)(dst + i * 2), _mm_unpacklo_epi16(l, r));
+      _mm_storeu_si128((__m128i *)(dst + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+    }
+  }
+  *seed = (uint32_t)_mm_cvtsi128_si32(state);
+  const float *tail[2] = {src[0] + i, channels == 2 ? src[1] + i : nullptr};
+  float_planar_to_s16_dither_c(dst + i * channels, tail, channels, n - i, seed);
+}
+
+static void interleave_sse2(float *dst, const float *const *src, int channels, int n) {
+  int i = 0;
+  if (channels == 2) {
+    for (; i + 4 <= n; i += 4) {
+      __m128 l = _mm_loadu_ps(src[0] + i);
+      __m128 r = _mm_loadu_ps(src[1] + i);
+      _mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+      _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+    }
+  } else if (channels == 4) {
+    for (; i + 4 <= n; i += 4) {
+      __m128 r0 = _mm_loadu_ps(src[0] + i);
+      __m128 r1 = _mm_loadu_ps(src[1] + i);
+      __m128 r2 = _mm_loadu_ps(src[2] + i);
+      __m128 r3 = _mm_loadu_ps(src[3] + i);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(dst + i * 4, r0);
+      _mm_storeu_ps(dst + i * 4 + 4, r1);
+      _mm_storeu_ps(dst + i * 4 + 8, r2);
+      _mm_storeu_ps(dst + i * 4 + 12, r3);
+    }
+  }
+  if (i == 0) {
+    interleave_c(dst, src, channels, n);
+    return;
+  }
+  const float *tail[4];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = src[c] + i;
+  }
+  interleave_c(dst + i * channels, tail, channels, n - i);
+}
+
+static void deinterleave_sse2(float *const *dst, const float *src, int channels, int n) {
+  int i = 0;
+  if (channels == 2) {
+    for (; i + 4 <= n; i += 4) {
+      __m128 a = _mm_loadu_ps(src + i * 2);
+      __m128 b = _mm_loadu_ps(src + i * 2 + 4);
+      _mm_storeu_ps(dst[0] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(dst[1] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+  } else if (channels == 4) {
+    for (; i + 4 <= n; i += 4) {
+      __m128 r0 = _mm_loadu_ps(src + i * 4);
+      __m128 r1 = _mm_loadu_ps(src + i * 4 + 4);
+      __m128 r2 = _mm_loadu_ps(src + i * 4 + 8);
+      __m128 r3 = _mm_loadu_ps(src + i * 4 + 12);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(dst[0] + i, r0);
+      _mm_storeu_ps(dst[1] + i, r1);
+      _mm_storeu_ps(dst[2] + i, r2);
+      _mm_storeu_ps(dst[3] + i, r3);
+    }
+  }
+  if (i == 0) {
+    deinterleave_c(dst, src, channels, n);
+    return;
+  }
+  float *tail[4];
+  for (int c = 0; c < channels; c++) {
+    tail[c] = dst[c] + i;
+  }
+  deinterleave_c(tail, src + i * channels, channels, n - i);
+}
+
+TARGET_AVX2 static void gain_avx2(float *dst, float gain, int n) {
+  const __m256 g = _mm256_set1_ps(gain);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(dst + i), g));
+  }
+  gain_c(dst + i, gain, n - i);
+}
+
+TARGET_AVX2 static void gain_ramp_avx2(float *dst, float start, float step, int n) {
+  __m256 idx = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  const __m256 base = _mm256_set1_ps(start);
+  const __m256 vstep = _mm256_set1_ps(step);
+  const __m256 eight = _mm256_set1_ps(8.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 g = _mm256_add_ps(base, _mm256_mul_ps(idx, vstep));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(dst + i), g));
+    idx = _mm256_add_ps(idx, eight);
+  }
+  gain_ramp_c(dst + i, start + (float)i * step, step, n - i);
+}
+
+TARGET_AVX2 static void mix_avx2(float *dst, const float *const *src, const float *gains, int nb_src, int n) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 acc = _mm256_mul_ps(_mm256_loadu_ps(src[0] + i), _mm256_set1_ps(gains[0]));
+    for (int k = 1; k < nb_src; k++) {
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(src[k] + i), _mm256_set1_ps(gains[k])));
+    }
+    _mm256_storeu_ps(dst + i, acc);
+  }
+  for (; i < n; i++) {
+    float acc = src[0][i] * gains[0];
+    for (int k = 1; k < nb_src; k++) {
+      acc += src[k][i] * gains[k];
+    }
+    dst[i] = acc;
+  }
+}
+
+TARGET_AVX2 static void matrix_avx2(float *const *dst, const float *const *src, const float *m, int out_ch, int in_ch,
+                                    int n) {
+  int o = 0;
+  for (; o + 2 <= out_ch; o += 2) {
+    const float *r0 = m + o * in_ch;
+    const float *r1 = r0 + in_ch;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+      __m256 x = _mm256_loadu_ps(src[0] + i);
+      __m256 a0 = _mm256_mul_ps(x, _mm256_set1_ps(r0[0]));
+      __m256 a1 = _mm256_mul_ps(x, _mm256_set1_ps(r1[0]));
+      for (int k = 1; k < in_ch; k++) {
+        x = _mm256_loadu_ps(src[k] + i);
+        a0 = _mm256_add_ps(a0, _mm256_mul_ps(x, _mm256_set1_ps(r0[k])));
+        a1 = _mm256_add_ps(a1, _mm256_mul_ps(x, _mm256_set1_ps(r1[k])));
+      }
+      _mm256_storeu_ps(dst[o] + i, a0);
+      _mm256_storeu_ps(dst[o + 1] + i, a1);
+    }
+    matrix_tail(dst, src, m, o, 2, in_ch, i, n);
+  }
+  if (o < out_ch) {
+    mix_avx2(dst[o], src, m + o * in_ch, in_ch, n);
+  }
+}
+
+TARGET_AVX2 static float dot_avx2(const float *a, const float *b, int n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+  }
+  __m256 acc8 = _mm256_add_ps(acc0, acc1);
+  __m128 acc = _mm_add_ps(_mm256_castps256_ps128(acc8), _mm256_extractf128_ps(acc8, 1));
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+  return _mm_cvtss_f32(acc) + dot_c(a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static void soft_clip_avx2(float *dst, float knee, int n) {
+  const __m256 vknee = _mm256_set1_ps(knee);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 inv_range = _mm256_set1_ps(1.0f / (1.0f - knee));
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_loadu_ps(dst + i);
+    __m256 a = _mm256_andnot_ps(sign, x);
+    __m256 over = _mm256_max_ps(_mm256_sub_ps(a, vknee), _mm256_setzero_ps());
+    __m256 y = _mm256_add_ps(_mm256_min_ps(a, vknee),
+                             _mm256_div_ps(over, _mm256_add_ps(one, _mm256_mul_ps(over, inv_range))));
+    _mm256_storeu_ps(dst + i, _mm256_or_ps(y, _mm256_and_ps(x, sign)));
+  }
+  soft_clip_c(dst + i, knee, n - i);
+}
+#endif
+
+/* ---------------------------------------------------------------------------------------------- */
+/* dispatch                                                                                       */
+/* ---------------------------------------------------------------------------------------------- */
+
+static const PcmDsp dsp_c = {
+    gain_c,
+    gain_ramp_c,
+    mix_c,
+    matrix_c,
+    dot_c,
+    soft_clip_c,
+    s16_to_float_planar_c,
+    float_planar_to_s16_c,
+    float_planar_to_s16_dither_c,
+    interleave_c,
+    deinterleave_c,
+};
+
+static PcmDsp pcm_dsp_init() {
+  PcmDsp dsp = dsp_c;
+  int flags = av_get_cpu_flags();
+#if HAVE_NEON
+  if (flags & AV_CPU_FLAG_NEON) {
+    dsp.gain = gain_neon;
+    dsp.gain_ramp = gain_ramp_neon;
+    dsp.mix = mix_neon;
+    dsp.matrix = matrix_neon;
+    dsp.dot = dot_neon;
+    dsp.soft_clip = soft_clip_neon;
+    dsp.s16_to_float_planar = s16_to_float_planar_neon;
+    dsp.float_planar_to_s16 = float_planar_to_s16_neon;
+    dsp.float_planar_to_s16_dither = float_planar_to_s16_dither_neon;
+    dsp.interleave = interleave_neon;
+    dsp.deinterleave = deinterleave_neon;
+  }
+#elif HAVE_X86
+  if (flags & AV_CPU_FLAG_SSE2) {
+    dsp.gain = gain_sse2;
+    dsp.gain_ramp = gain_ramp_sse2;
+    dsp.mix = mix_sse2;
+    dsp.matrix = matrix_sse2;
+    dsp.dot = dot_sse2;
+    dsp.soft_clip = soft_clip_sse2;
+    dsp.s16_to_float_planar = s16_to_float_planar_sse2;
+    dsp.float_planar_to_s16 = float_planar_to_s16_sse2;
+    dsp.float_planar_to_s16_dither = float_planar_to_s16_dither_sse2;
+    dsp.interleave = interleave_sse2;
+    dsp.deinterleave = deinterleave_sse2;
+  }
+  if (flags & AV_CPU_FLAG_AVX2) {
+    dsp.gain = gain_avx2;
+    dsp.gain_ramp = gain_ramp_avx2;
+    dsp.mix = mix_avx2;
+    dsp.matrix = matrix_avx2;
+    dsp.dot = dot_avx2;
+    dsp.soft_clip = soft_clip_avx2;
+  }
+#endif
+  LOGI("pcm dsp initialized, cpu flags: 0x%x", flags);
+  return dsp;
+}
+
+const PcmDsp *pcm_dsp_get() {
+  static const PcmDsp dsp = pcm_dsp_init();
+  return &dsp;
+}
+
+const PcmDsp *pcm_dsp_get_c() {
+  return &dsp_c;
+}
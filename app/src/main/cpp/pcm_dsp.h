@@ -0,0 +1,55 @@
+#ifndef AUDIO_ENCODER_PCM_DSP_H
+#define AUDIO_ENCODER_PCM_DSP_H
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * Vectorized PCM kernels used around the codec: before encode() and after decode().
+ *
+ * Every kernel has a scalar reference version; NEON (arm64), SSE2 and AVX2 (x86)
+ * versions are picked once at runtime from av_get_cpu_flags(). Float samples are
+ * normalized to [-1, 1), S16 samples are always interleaved, float buffers may be
+ * planar (one pointer per channel) or interleaved as named.
+ */
+struct PcmDsp {
+  /** dst[i] *= gain */
+  void (*gain)(float *dst, float gain, int n);
+  /** dst[i] *= start + i * step, a linear gain ramp (fades, gain changes). */
+  void (*gain_ramp)(float *dst, float start, float step, int n);
+  /** dst[i] = sum(src[k][i] * gains[k]) for k < nb_src, dst may alias src[0]. */
+  void (*mix)(float *dst, const float *const *src, const float *gains, int nb_src, int n);
+  /**
+   * dst[o][i] = sum(m[o * in_ch + k] * src[k][i]) for k < in_ch: a channel matrix, row-major
+   * out_ch x in_ch. Outputs are computed in pairs, each input sample is loaded once per pair.
+   * dst must not alias src.
+   */
+  void (*matrix)(float *const *dst, const float *const *src, const float *m, int out_ch, int in_ch, int n);
+  /** sum(a[i] * b[i]), one output sample of a FIR filter. */
+  float (*dot)(const float *a, const float *b, int n);
+  /** Leaves |x| <= knee untouched and bends everything above smoothly towards 1.0. */
+  void (*soft_clip)(float *dst, float knee, int n);
+  /** Interleaved S16 -> planar float. */
+  void (*s16_to_float_planar)(float *const *dst, const int16_t *src, int channels, int n);
+  /** Planar float -> interleaved S16, rounded and saturated. */
+  void (*float_planar_to_s16)(int16_t *dst, const float *const *src, int channels, int n);
+  /** Same as float_planar_to_s16 with +-1 LSB TPDF dither, seed carries the noise state. */
+  void (*float_planar_to_s16_dither)(int16_t *dst, const float *const *src, int channels, int n,
+                                     uint32_t *seed);
+  /** Planar float -> interleaved float. */
+  void (*interleave)(float *dst, const float *const *src, int channels, int n);
+  /** Interleaved float -> planar float. */
+  void (*deinterleave)(float *const *dst, const float *src, int channels, int n);
+};
+
+/** Kernels for the running cpu, resolved on first call. */
+const PcmDsp *pcm_dsp_get();
+
+/** Scalar reference kernels, handy when checking a SIMD version. */
+const PcmDsp *pcm_dsp_get_c();
+
+static inline float db_to_gain(float db) {
+  return powf(10.0f, db / 20.0f);
+}
+
+#endif //AUDIO_ENCODER_PCM_DSP_H
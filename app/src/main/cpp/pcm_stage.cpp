@@ -0,0 +1,118 @@
+#include "pcm_stage.h"
+#include "channel_matrix.h"
+
+extern "C" {
+#include "libavutil/common.h"
+}
+
+int PcmChain::process(float *const *planes, int channels, int nb_samples) {
+  for (auto &stage : stages_) {
+    int ret = stage->process(planes, channels, nb_samples);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  return 0;
+}
+
+int PcmChain::finish() {
+  int ret = 0;
+  for (auto &stage : stages_) {
+    int r = stage->finish();
+    if (r < 0 && ret == 0) {
+      ret = r;
+    }
+  }
+  return ret;
+}
+
+int PcmChain::latency() const {
+  int latency = 0;
+  for (auto &stage : stages_) {
+    latency += stage->latency();
+  }
+  return latency;
+}
+
+DspStage::DspStage(const DspOptions &opts, int sample_rate)
+    : dsp_(pcm_dsp_get()),
+      gain_(db_to_gain(opts.gain_db)),
+      soft_clip_(opts.soft_clip),
+      fade_samples_((int64_t)opts.fade_in_ms * sample_rate / 1000) {
+}
+
+void DspStage::add_mix_input(const int16_t *data, int64_t nb_samples, float gain_db, const ChannelMatrix *remix) {
+  inputs_.push_back(MixInput{data, nb_samples, 0, db_to_gain(gain_db), remix, {}});
+}
+
+int DspStage::process(float *const *planes, int channels, int nb_samples) {
+  // gain, ramping up from silence over the first fade_samples_.
+  int done = 0;
+  if (pos_ < fade_samples_) {
+    done = (int)FFMIN(fade_samples_ - pos_, (int64_t)nb_samples);
+    float step = gain_ / (float)fade_samples_;
+    for (int c = 0; c < channels; c++) {
+      dsp_->gain_ramp(planes[c], step * (float)pos_, step, done);
+    }
+  }
+  if (done < nb_samples && gain_ != 1.0f) {
+    for (int c = 0; c < channels; c++) {
+      dsp_->gain(planes[c] + done, gain_, nb_samples - done);
+    }
+  }
+  pos_ += nb_samples;
+
+  // every live input is converted once, then each channel is a single N-input mix.
+  std::vector<float *> &tmp = tmp_;
+  std::vector<const float *> &src = src_;
+  std::vector<float> &gains = gains_;
+  tmp.resize((size_t)channels);
+  for (MixInput &in : inputs_) {
+    int n = (int)FFMIN(in.nb_samples - in.pos, (int64_t)nb_samples);
+    if (n <= 0) {
+      continue;
+    }
+    in.scratch.assign((size_t)nb_samples * channels, 0.0f);
+    for (int c = 0; c < channels; c++) {
+      tmp[c] = in.scratch.data() + (size_t)c * nb_samples;
+    }
+    if (in.remix) {
+      const int in_channels = in.remix->in_channels();
+      raw_.resize((size_t)nb_samples * in_channels);
+      raw_planes_.resize(in_channels);
+      for (int c = 0; c < in_channels; c++) {
+        raw_planes_[c] = raw_.data() + (size_t)c * nb_samples;
+      }
+      dsp_->s16_to_float_planar(raw_planes_.data(), in.data + in.pos * in_channels, in_channels, n);
+      in.remix->process(tmp.data(), raw_planes_.data(), n);
+    } else {
+      dsp_->s16_to_float_planar(tmp.data(), in.data + in.pos * channels, channels, n);
+    }
+    in.pos += n;
+  }
+  for (int c = 0; c < channels && !inputs_.empty(); c++) {
+    src.assign(1, planes[c]);
+    gains.assign(1, 1.0f);
+    for (MixInput &in : inputs_) {
+      if (!in.scratch.empty()) {
+        src.push_back(in.scratch.data() + (size_t)c * nb_samples);
+        gains.push_back(in.gain);
+      }
+    }
+    if (src.size() > 1) {
+      dsp_->mix(planes[c], src.data(), gains.data(), (int)src.size(), nb_samples);
+    }
+  }
+  for (MixInput &in : inputs_) {
+    if (in.pos >= in.nb_samples) {
+      in.scratch.clear();
+    }
+  }
+
+  if (soft_clip_ > 0.0f) {
+    for (int c = 0; c < channels; c++) {
+      dsp_->soft_clip(planes[c], soft_clip_, nb_samples);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef AUDIO_ENCODER_PCM_STAGE_H
+#define AUDIO_ENCODER_PCM_STAGE_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "options.h"
+#include "pcm_dsp.h"
+
+class ChannelMatrix;
+
+/**
+ * One in-place step over planar float audio. The encoder runs its chain right
+ * before encode(), the decoder right after a frame leaves the codec.
+ */
+class PcmStage {
+ public:
+  virtual ~PcmStage() = default;
+
+  virtual int process(float *const *planes, int channels, int nb_samples) = 0;
+
+  /** Called once after the last block, analyzers flush their results here. */
+  virtual int finish() { return 0; }
+
+  /** Samples the output lags the input by (lookahead), the caller drops and flushes them. */
+  virtual int latency() const { return 0; }
+};
+
+class PcmChain {
+ public:
+  void add(std::unique_ptr<PcmStage> stage) { stages_.push_back(std::move(stage)); }
+
+  bool empty() const { return stages_.empty(); }
+
+  int process(float *const *planes, int channels, int nb_samples);
+
+  int finish();
+
+  int latency() const;
+
+ private:
+  std::vector<std::unique_ptr<PcmStage>> stages_;
+};
+
+/**
+ * Gain with an optional fade-in ramp, N background inputs mixed under the signal
+ * and a soft clipper, in that order.
+ */
+class DspStage : public PcmStage {
+ public:
+  DspStage(const DspOptions &opts, int sample_rate);
+
+  /**
+   * Mixes interleaved S16 data with the stream's channel count under the signal,
+   * or with the input layout of `remix`, which takes it to the stream's.
+   * The data isn't copied and, like `remix`, must outlive the stage.
+   */
+  void add_mix_input(const int16_t *data, int64_t nb_samples, float gain_db, const ChannelMatrix *remix = nullptr);
+
+  int process(float *const *planes, int channels, int nb_samples) override;
+
+ private:
+  struct MixInput {
+    const int16_t *data;
+    int64_t nb_samples;
+    int64_t pos;
+    float gain;
+    const ChannelMatrix *remix;
+    std::vector<float> scratch;
+  };
+
+  const PcmDsp *dsp_;
+  float gain_;
+  float soft_clip_;
+  int64_t fade_samples_;
+  int64_t pos_ = 0;
+  std::vector<MixInput> inputs_;
+  // per block scratch, kept to avoid reallocating on every frame.
+  std::vector<float *> tmp_;
+  // a remixed input before its matrix.
+  std::vector<float *> raw_planes_;
+  std::vector<float> raw_;
+  std::vector<const float *> src_;
+  std::vector<float> gains_;
+};
+
+#endif //AUDIO_ENCODER_PCM_STAGE_H
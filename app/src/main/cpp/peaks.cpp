@@ -0,0 +1,123 @@
+#include "peaks.h"
+#include "base.h"
+#include "simd.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#define FINEST_BUCKET 256
+#define LEVEL_FACTOR 4
+#define NB_LEVELS 3
+
+static void min_max(const float *x, int n, float *mn, float *mx) {
+  int i = 0;
+  float lo = *mn;
+  float hi = *mx;
+  if (n >= 4) {
+    f32x4 vlo = f32x4_set1(lo);
+    f32x4 vhi = f32x4_set1(hi);
+    for (; i + 4 <= n; i += 4) {
+      f32x4 v = f32x4_load(x + i);
+      vlo = f32x4_min(vlo, v);
+      vhi = f32x4_max(vhi, v);
+    }
+    lo = f32x4_hmin(vlo);
+    hi = f32x4_hmax(vhi);
+  }
+  for (; i < n; i++) {
+    lo = std::min(lo, x[i]);
+    hi = std::max(hi, x[i]);
+  }
+  *mn = lo;
+  *mx = hi;
+}
+
+static int16_t to_s16(float v) {
+  return (int16_t)lrintf(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+}
+
+PeakStage::PeakStage(int sample_rate, int channels, const std::string &path, int64_t skip)
+    : sample_rate_(sample_rate), channels_(channels), path_(path), skip_(skip), levels_(NB_LEVELS) {
+  int bucket = FINEST_BUCKET;
+  for (Level &level : levels_) {
+    level.bucket_samples = bucket;
+    level.min.assign(channels, 1.0f);
+    level.max.assign(channels, -1.0f);
+    bucket *= LEVEL_FACTOR;
+  }
+}
+
+// appends the open bucket of `level` and folds it into the level above.
+void PeakStage::close_bucket(size_t level) {
+  Level &l = levels_[level];
+  Level *up = level + 1 < levels_.size() ? &levels_[level + 1] : nullptr;
+  for (int ch = 0; ch < channels_; ch++) {
+    l.data.push_back(to_s16(l.min[ch]));
+    l.data.push_back(to_s16(l.max[ch]));
+    if (up) {
+      up->min[ch] = std::min(up->min[ch], l.min[ch]);
+      up->max[ch] = std::max(up->max[ch], l.max[ch]);
+    }
+    l.min[ch] = 1.0f;
+    l.max[ch] = -1.0f;
+  }
+  l.fill = 0;
+  if (up && ++up->fill == LEVEL_FACTOR) {
+    close_bucket(level + 1);
+  }
+}
+
+int PeakStage::process(float *const *planes, int channels, int nb_samples) {
+  int offset = (int)std::min<int64_t>(skip_, nb_samples);
+  skip_ -= offset;
+  nb_samples_ += nb_samples - offset;
+
+  Level &finest = levels_[0];
+  while (offset < nb_samples) {
+    int n = std::min(nb_samples - offset, finest.bucket_samples - finest.fill);
+    for (int ch = 0; ch < channels; ch++) {
+      min_max(planes[ch] + offset, n, &finest.min[ch], &finest.max[ch]);
+    }
+    finest.fill += n;
+    offset += n;
+    if (finest.fill == finest.bucket_samples) {
+      close_bucket(0);
+    }
+  }
+  return 0;
+}
+
+int PeakStage::finish() {
+  // close partial buckets bottom up, each one counts as a child of the level above.
+  for (size_t i = 0; i < levels_.size(); i++) {
+    if (levels_[i].fill > 0) {
+      close_bucket(i);
+    }
+  }
+
+  FILE *file = fopen(path_.c_str(), "wb");
+  if (!file) {
+    LOGE("can't open peaks output %s", path_.c_str());
+    return -1;
+  }
+  uint32_t rate = sample_rate_;
+  uint16_t channels = channels_;
+  uint16_t levels = levels_.size();
+  fwrite("PKS1", 1, 4, file);
+  fwrite(&rate, sizeof(rate), 1, file);
+  fwrite(&channels, sizeof(channels), 1, file);
+  fwrite(&levels, sizeof(levels), 1, file);
+  fwrite(&nb_samples_, sizeof(nb_samples_), 1, file);
+  for (const Level &l : levels_) {
+    uint32_t header[2] = {(uint32_t)l.bucket_samples, (uint32_t)(l.data.size() / (2 * channels_))};
+    fwrite(header, sizeof(header), 1, file);
+  }
+  for (const Level &l : levels_) {
+    fwrite(l.data.data(), sizeof(int16_t), l.data.size(), file);
+  }
+  int ret = ferror(file) ? -1 : 0;
+  fclose(file);
+  LOGI("peaks: %lld samples written to %s", (long long)nb_samples_, path_.c_str());
+  return ret;
+}
@@ -0,0 +1,57 @@
+#ifndef AUDIO_ENCODER_PEAKS_H
+#define AUDIO_ENCODER_PEAKS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "pcm_stage.h"
+
+/**
+ * Min/max waveform pyramid for thumbnails, written on finish() so the UI never
+ * has to decode a file again to draw it.
+ *
+ * Levels are 256, 1024 and 4096 sample buckets; the finest one is computed from
+ * the samples, each coarser one from four buckets of the level below. File
+ * layout, little endian:
+ *
+ *   char     magic[4]      "PKS1"
+ *   uint32_t sample_rate
+ *   uint16_t channels
+ *   uint16_t levels
+ *   int64_t  nb_samples    per channel
+ *   levels x { uint32_t bucket_samples; uint32_t nb_buckets; }
+ *   levels x nb_buckets x channels x { int16_t min; int16_t max; }
+ *
+ * The last bucket of a level may be partial.
+ */
+class PeakStage : public PcmStage {
+ public:
+  /** The first `skip` samples are the delay line of earlier stages and aren't counted. */
+  PeakStage(int sample_rate, int channels, const std::string &path, int64_t skip = 0);
+
+  int process(float *const *planes, int channels, int nb_samples) override;
+
+  int finish() override;
+
+ private:
+  struct Level {
+    int bucket_samples;
+    // samples (finest level) or child buckets in the open bucket.
+    int fill = 0;
+    std::vector<float> min;
+    std::vector<float> max;
+    std::vector<int16_t> data;
+  };
+
+  void close_bucket(size_t level);
+
+  int sample_rate_;
+  int channels_;
+  std::string path_;
+  int64_t skip_;
+  int64_t nb_samples_ = 0;
+  std::vector<Level> levels_;
+};
+
+#endif //AUDIO_ENCODER_PEAKS_H
@@ -0,0 +1,183 @@
+#include "probe_cache.h"
+#include "base.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavutil/error.h"
+}
+
+#define PROBE_CACHE_ENTRIES 64
+// audio needs a few packets to fill in its parameters, the defaults (5 MB, 5 s) are sized for video.
+#define PROBE_SIZE (256 * 1024)
+#define ANALYZE_DURATION (AV_TIME_BASE / 2)
+#define DEFAULT_PROBE_SIZE 5000000
+#define DEFAULT_ANALYZE_DURATION (5 * AV_TIME_BASE)
+
+namespace {
+
+struct ProbeEntry {
+  std::string key;
+  // short name of the input format, for av_find_input_format().
+  std::string format;
+  int stream_index;
+  int64_t duration;
+  AVCodecParameters *par;
+  uint64_t last_use;
+};
+
+struct ProbeCache {
+  std::mutex lock;
+  std::vector<ProbeEntry> entries;
+  uint64_t clock = 0;
+
+  ~ProbeCache() {
+    for (ProbeEntry &e : entries) {
+      avcodec_parameters_free(&e.par);
+    }
+  }
+};
+
+ProbeCache &probe_cache() {
+  static ProbeCache cache;
+  return cache;
+}
+
+}
+
+// empty when the file can't be stat()ed, it is then neither looked up nor stored.
+static std::string probe_key(const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return "";
+  }
+  char id[64];
+  snprintf(id, sizeof(id), "\n%lld %lld.%09ld", (long long)st.st_size, (long long)st.st_mtim.tv_sec,
+           (long)st.st_mtim.tv_nsec);
+  return path + std::string(id);
+}
+
+static bool cache_find(const std::string &key, ProbeEntry *out, AVCodecParameters *par) {
+  ProbeCache &cache = probe_cache();
+  std::lock_guard<std::mutex> guard(cache.lock);
+  for (ProbeEntry &e : cache.entries) {
+    if (e.key == key) {
+      e.last_use = ++cache.clock;
+      out->format = e.format;
+      out->stream_index = e.stream_index;
+      out->duration = e.duration;
+      return avcodec_parameters_copy(par, e.par) >= 0;
+    }
+  }
+  return false;
+}
+
+static void cache_store(const std::string &key, const AVFormatContext *ctx, int stream_index) {
+  ProbeEntry entry;
+  entry.key = key;
+  entry.format = ctx->iformat->name;
+  entry.format = entry.format.substr(0, entry.format.find(','));
+  entry.stream_index = stream_index;
+  entry.duration = ctx->duration;
+  entry.par = avcodec_parameters_alloc();
+  if (!entry.par || avcodec_parameters_copy(entry.par, ctx->streams[stream_index]->codecpar) < 0) {
+    avcodec_parameters_free(&entry.par);
+    return;
+  }
+
+  ProbeCache &cache = probe_cache();
+  std::lock_guard<std::mutex> guard(cache.lock);
+  entry.last_use = ++cache.clock;
+  for (ProbeEntry &e : cache.entries) {
+    if (e.key == key) {
+      avcodec_parameters_free(&e.par);
+      e = entry;
+      return;
+    }
+  }
+  if (cache.entries.size() >= PROBE_CACHE_ENTRIES) {
+    auto oldest = cache.entries.begin();
+    for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+      if (it->last_use < oldest->last_use) {
+        oldest = it;
+      }
+    }
+    avcodec_parameters_free(&oldest->par);
+    cache.entries.erase(oldest);
+  }
+  cache.entries.push_back(entry);
+}
+
+static int find_audio_stream(const AVFormatContext *ctx) {
+  for (unsigned i = 0; i < ctx->nb_streams; i++) {
+    if (ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+static bool parameters_complete(const AVCodecParameters *par) {
+  return par->sample_rate > 0 && par->ch_layout.nb_channels > 0 && par->format >= 0;
+}
+
+int open_audio_input(const char *path, AVFormatContext **ctx, int *stream_index, AVCodecParameters *par) {
+  const std::string key = probe_key(path);
+  ProbeEntry hit;
+  if (!key.empty() && cache_find(key, &hit, par)) {
+    int ret = avformat_open_input(ctx, path, av_find_input_format(hit.format.c_str()), nullptr);
+    if (ret >= 0 && hit.stream_index < (int)(*ctx)->nb_streams &&
+        (*ctx)->streams[hit.stream_index]->codecpar->codec_id == par->codec_id) {
+      if ((*ctx)->duration == AV_NOPTS_VALUE) {
+        (*ctx)->duration = hit.duration;
+      }
+      *stream_index = hit.stream_index;
+      return 0;
+    }
+    // rewritten in place under the same size and mtime, probed again below.
+    LOGW("probe cache: %s changed, probing again", path);
+    avformat_close_input(ctx);
+  }
+
+  // 打开输入文件
+  int ret = avformat_open_input(ctx, path, nullptr, nullptr);
+  if (ret < 0) {
+    LOGE("avformat_open_input failed: %s", av_err2str(ret));
+    return ret;
+  }
+
+  // 获取流信息
+  (*ctx)->probesize = PROBE_SIZE;
+  (*ctx)->max_analyze_duration = ANALYZE_DURATION;
+  ret = avformat_find_stream_info(*ctx, nullptr);
+  int index = ret >= 0 ? find_audio_stream(*ctx) : -1;
+  if (ret >= 0 && index >= 0 && !parameters_complete((*ctx)->streams[index]->codecpar)) {
+    (*ctx)->probesize = DEFAULT_PROBE_SIZE;
+    (*ctx)->max_analyze_duration = DEFAULT_ANALYZE_DURATION;
+    ret = avformat_find_stream_info(*ctx, nullptr);
+  }
+  if (ret < 0) {
+    LOGE("avformat_find_stream_info failed: %s", av_err2str(ret));
+    return ret;
+  }
+
+  // 查找音频流
+  index = find_audio_stream(*ctx);
+  if (index < 0) {
+    LOGE("can't find stream_index");
+    return AVERROR_STREAM_NOT_FOUND;
+  }
+  ret = avcodec_parameters_copy(par, (*ctx)->streams[index]->codecpar);
+  if (ret < 0) {
+    return ret;
+  }
+  if (!key.empty()) {
+    cache_store(key, *ctx, index);
+  }
+  *stream_index = index;
+  return 0;
+}
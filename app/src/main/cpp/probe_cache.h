@@ -0,0 +1,23 @@
+#ifndef AUDIO_ENCODER_PROBE_CACHE_H
+#define AUDIO_ENCODER_PROBE_CACHE_H
+
+extern "C" {
+#include "libavcodec/codec_par.h"
+#include "libavformat/avformat.h"
+}
+
+/**
+ * Opens `path` with libavformat and finds its first audio stream, whose
+ * decoder parameters are copied into `par`.
+ *
+ * avformat_find_stream_info() reads and decodes ahead just to learn the
+ * stream parameters, so its results are kept in a process-wide cache keyed by
+ * path, size and mtime. Reopening a known file forces the cached format and
+ * skips the probe; an unknown one is probed with limits sized for audio,
+ * raised to FFmpeg's defaults only when they leave the parameters incomplete.
+ *
+ * Returns 0 or a negative AVERROR, `*ctx` is closed by the caller either way.
+ */
+int open_audio_input(const char *path, AVFormatContext **ctx, int *stream_index, AVCodecParameters *par);
+
+#endif //AUDIO_ENCODER_PROBE_CACHE_H
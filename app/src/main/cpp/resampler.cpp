@@ -0,0 +1,171 @@
+#include "resampler.h"
+#include "base.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+// ratios beyond this many phases (44100 -> 44101) aren't worth a table.
+#define MAX_PHASES 1024
+
+static int gcd(int a, int b) {
+  while (b) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 50; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12) {
+      break;
+    }
+  }
+  return sum;
+}
+
+static std::shared_ptr<FilterBank> build_bank(int in_rate, int out_rate, ResampleQuality quality) {
+  static const int base_taps[] = {16, 32, 64};
+  static const double betas[] = {6.0, 9.0, 11.0};
+  static const double passbands[] = {0.90, 0.94, 0.97};
+
+  auto bank = std::make_shared<FilterBank>();
+  const int g = gcd(in_rate, out_rate);
+  bank->in_rate = in_rate;
+  bank->out_rate = out_rate;
+  bank->quality = quality;
+  bank->phases = out_rate / g;
+  bank->step = in_rate / g;
+  // downsampling stretches the filter by the ratio to keep the transition band the same, taps in multiples of 8.
+  const double ratio = std::min(1.0, (double)bank->phases / bank->step);
+  const int taps = (int)ceil(base_taps[quality] / ratio);
+  bank->taps = (taps + 7) & ~7;
+
+  const int taps_half = bank->taps / 2;
+  const double cutoff = 0.5 * ratio * passbands[quality];
+  const double beta = betas[quality];
+  const double i0_beta = bessel_i0(beta);
+  bank->coeffs.resize((size_t)bank->phases * bank->taps);
+  for (int p = 0; p < bank->phases; p++) {
+    float *h = bank->coeffs.data() + (size_t)p * bank->taps;
+    double sum = 0.0;
+    for (int k = 0; k < bank->taps; k++) {
+      // distance of tap k to the output instant, in input samples.
+      double x = k - (taps_half - 1) - (double)p / bank->phases;
+      double arg = 2.0 * cutoff * x;
+      double sinc = fabs(arg) < 1e-12 ? 1.0 : sin(M_PI * arg) / (M_PI * arg);
+      double w = x / taps_half;
+      double window = fabs(w) >= 1.0 ? 0.0 : bessel_i0(beta * sqrt(1.0 - w * w)) / i0_beta;
+      double v = 2.0 * cutoff * sinc * window;
+      h[k] = (float)v;
+      sum += v;
+    }
+    // unity gain at DC in every phase, no ripple from the phase pattern.
+    for (int k = 0; k < bank->taps; k++) {
+      h[k] = (float)(h[k] / sum);
+    }
+  }
+  return bank;
+}
+
+std::shared_ptr<const FilterBank> filter_bank_get(int in_rate, int out_rate, ResampleQuality quality) {
+  static std::mutex lock;
+  static std::map<std::tuple<int, int, int>, std::shared_ptr<const FilterBank>> banks;
+  if (in_rate <= 0 || out_rate <= 0 || out_rate / gcd(in_rate, out_rate) > MAX_PHASES) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  std::shared_ptr<const FilterBank> &bank = banks[std::make_tuple(in_rate, out_rate, (int)quality)];
+  if (!bank) {
+    bank = build_bank(in_rate, out_rate, quality);
+    LOGI("resampler: %d -> %d Hz bank, %d phases x %d taps", in_rate, out_rate, bank->phases, bank->taps);
+  }
+  return bank;
+}
+
+void filter_bank_warm() {
+  static const int pairs[][2] = {{44100, 48000}, {48000, 44100}, {44100, 16000}, {48000, 24000}};
+  for (const auto &pair : pairs) {
+    filter_bank_get(pair[0], pair[1], RESAMPLE_MEDIUM);
+  }
+}
+
+std::unique_ptr<Resampler> Resampler::create(int in_rate, int out_rate, int channels, ResampleQuality quality) {
+  std::shared_ptr<const FilterBank> bank = filter_bank_get(in_rate, out_rate, quality);
+  if (!bank) {
+    return nullptr;
+  }
+  return std::unique_ptr<Resampler>(new Resampler(std::move(bank), channels));
+}
+
+Resampler::Resampler(std::shared_ptr<const FilterBank> bank, int channels)
+    : dsp_(pcm_dsp_get()),
+      bank_(std::move(bank)),
+      channels_(channels),
+      // zeros in front of input sample 0, where the first output is centered.
+      history_(channels, std::vector<float>(bank_->taps / 2 - 1, 0.0f)),
+      out_planes_(channels) {
+}
+
+int Resampler::run(int64_t max_out) {
+  const FilterBank &bank = *bank_;
+  const int avail = (int)history_[0].size();
+  // enough room for every output the buffered input allows.
+  const int cap = (int)std::max<int64_t>(0, std::min<int64_t>(max_out,
+      ((int64_t)(avail - pos_) * bank.phases) / bank.step + 1));
+  if ((int)out_.size() < cap * channels_) {
+    out_.resize((size_t)cap * channels_);
+  }
+  for (int ch = 0; ch < channels_; ch++) {
+    out_planes_[ch] = out_.data() + (size_t)ch * cap;
+  }
+
+  int n = 0;
+  while (n < cap && pos_ + bank.taps <= avail) {
+    const float *h = bank.coeffs.data() + (size_t)phase_ * bank.taps;
+    for (int ch = 0; ch < channels_; ch++) {
+      out_planes_[ch][n] = dsp_->dot(history_[ch].data() + pos_, h, bank.taps);
+    }
+    n++;
+    phase_ += bank.step;
+    pos_ += phase_ / bank.phases;
+    phase_ %= bank.phases;
+  }
+  // drop what no later output reaches.
+  const int drop = std::min(pos_, avail);
+  if (drop > 0) {
+    for (std::vector<float> &h : history_) {
+      h.erase(h.begin(), h.begin() + drop);
+    }
+    pos_ -= drop;
+  }
+  out_count_ += n;
+  return n;
+}
+
+int Resampler::process(const float *const *planes, int nb_samples) {
+  for (int ch = 0; ch < channels_; ch++) {
+    history_[ch].insert(history_[ch].end(), planes[ch], planes[ch] + nb_samples);
+  }
+  in_count_ += nb_samples;
+  return run(INT64_MAX);
+}
+
+int Resampler::flush() {
+  // the right half of the filter past the last input, then stop at the exact output length.
+  for (std::vector<float> &h : history_) {
+    h.insert(h.end(), bank_->taps, 0.0f);
+  }
+  const int64_t total = (in_count_ * bank_->phases + bank_->step - 1) / bank_->step;
+  return run(total - out_count_);
+}
@@ -0,0 +1,84 @@
+#ifndef AUDIO_ENCODER_RESAMPLER_H
+#define AUDIO_ENCODER_RESAMPLER_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "pcm_dsp.h"
+
+enum ResampleQuality {
+  // 16 taps per zero crossing span, ~-60 dB stopband, for previews.
+  RESAMPLE_FAST = 0,
+  // 32 taps, ~-90 dB, the default.
+  RESAMPLE_MEDIUM = 1,
+  // 64 taps, ~-110 dB, a wider passband.
+  RESAMPLE_HIGH = 2,
+};
+
+/**
+ * Polyphase windowed sinc (Kaiser) filter for one in -> out rate ratio and
+ * quality: `phases` sets of `taps` coefficients, phase p holding the filter
+ * at a fractional offset of p / phases input samples. Immutable once built,
+ * shared by every Resampler with the same ratio.
+ */
+struct FilterBank {
+  int in_rate;
+  int out_rate;
+  ResampleQuality quality;
+  // the reduced ratio out / in = phases / step.
+  int phases;
+  int step;
+  int taps;
+  std::vector<float> coeffs;
+};
+
+/**
+ * The filter bank for a ratio, built on first use and kept for the life of the
+ * process. Null when the reduced ratio needs more phases than is reasonable
+ * (an odd rate pair), the caller falls back to swresample then.
+ */
+std::shared_ptr<const FilterBank> filter_bank_get(int in_rate, int out_rate, ResampleQuality quality);
+
+/** Builds the banks of the ratios this app converts between all the time, so sessions start without it. */
+void filter_bank_warm();
+
+/**
+ * Streaming rate conversion of planar float on a shared FilterBank and the
+ * PcmDsp dot kernel. Output sample 0 is aligned with input sample 0, flush()
+ * returns the tail so the output has exactly in * out_rate / in_rate samples.
+ */
+class Resampler {
+ public:
+  /** Null when filter_bank_get() has no bank for the ratio. */
+  static std::unique_ptr<Resampler> create(int in_rate, int out_rate, int channels, ResampleQuality quality);
+
+  /** Converts `nb_samples`, the result is in output() until the next call. Returns its length. */
+  int process(const float *const *planes, int nb_samples);
+
+  /** Same as process() for the end of the input. */
+  int flush();
+
+  /** Owned by the resampler, callers may process it in place. */
+  float *const *output() { return out_planes_.data(); }
+
+ private:
+  Resampler(std::shared_ptr<const FilterBank> bank, int channels);
+
+  int run(int64_t max_out);
+
+  const PcmDsp *dsp_;
+  std::shared_ptr<const FilterBank> bank_;
+  int channels_;
+  // per channel input still needed, the filter's left half ahead of the next output.
+  std::vector<std::vector<float>> history_;
+  // position of the next output: its first tap in history_ and its phase.
+  int pos_ = 0;
+  int phase_ = 0;
+  int64_t in_count_ = 0;
+  int64_t out_count_ = 0;
+  std::vector<float> out_;
+  std::vector<float *> out_planes_;
+};
+
+#endif //AUDIO_ENCODER_RESAMPLER_H
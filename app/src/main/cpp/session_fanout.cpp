@@ -0,0 +1,130 @@
+#include "session_fanout.h"
+#include "base.h"
+
+SessionFanOut::SessionFanOut(const std::vector<EncoderSession *> &sessions, int channels, int block_size)
+    : channels_(channels), block_size_(block_size) {
+  for (EncoderSession *session : sessions) {
+    Lane lane;
+    lane.session = session;
+    lanes_.push_back(lane);
+  }
+  // every queue full plus the one being filled.
+  const int nb_blocks = lanes_.size() > 1 ? QUEUE_DEPTH + 1 : 1;
+  for (int i = 0; i < nb_blocks; i++) {
+    auto block = std::make_shared<Block>();
+    block->data.resize((size_t)channels * block_size);
+    blocks_.push_back(block);
+  }
+  if (lanes_.size() > 1) {
+    workers_ = std::make_unique<WorkerPool>((int)lanes_.size());
+    for (Lane &lane : lanes_) {
+      Lane *l = &lane;
+      workers_->submit([this, l] { run(l); });
+    }
+  }
+}
+
+SessionFanOut::~SessionFanOut() {
+  if (!finished_) {
+    finish();
+  }
+}
+
+std::shared_ptr<SessionFanOut::Block> SessionFanOut::acquire() {
+  // inline, the one block is free again as soon as write() returns.
+  if (!workers_) {
+    return blocks_[0];
+  }
+  std::unique_lock<std::mutex> lock(lock_);
+  for (;;) {
+    for (const std::shared_ptr<Block> &block : blocks_) {
+      // only blocks_ itself holds it.
+      if (block.use_count() == 1) {
+        return block;
+      }
+    }
+    freed_.wait(lock);
+  }
+}
+
+int SessionFanOut::write_block(EncoderSession *session, const Block &block, int offset, int nb_samples) const {
+  std::vector<const float *> planes(channels_);
+  for (int ch = 0; ch < channels_; ch++) {
+    planes[ch] = block.data.data() + (size_t)ch * block_size_ + offset;
+  }
+  return session->write(planes.data(), nb_samples);
+}
+
+int SessionFanOut::write(const std::shared_ptr<Block> &block, int offset, int nb_samples) {
+  if (!workers_) {
+    Lane &lane = lanes_[0];
+    if (lane.result >= 0) {
+      lane.result = write_block(lane.session, *block, offset, nb_samples);
+    }
+    return lane.result;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  int alive = 0;
+  for (Lane &lane : lanes_) {
+    if (lane.result >= 0) {
+      lane.queue.push_back(Item{block, offset, nb_samples});
+      alive++;
+    }
+  }
+  queued_.notify_all();
+  return alive > 0 ? 0 : lanes_[0].result;
+}
+
+void SessionFanOut::run(Lane *lane) {
+  for (;;) {
+    Item item;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      queued_.wait(lock, [lane] { return !lane->queue.empty(); });
+      item = std::move(lane->queue.front());
+      lane->queue.pop_front();
+    }
+    if (item.nb_samples < 0) {
+      int ret = lane->result >= 0 ? lane->session->finish() : lane->result;
+      std::lock_guard<std::mutex> lock(lock_);
+      lane->result = ret;
+      return;
+    }
+    int ret = 0;
+    if (lane->result >= 0) {
+      ret = write_block(lane->session, *item.block, item.offset, item.nb_samples);
+      if (ret < 0) {
+        LOGE("fan-out: an output failed, ret: %d, the others go on", ret);
+      }
+    }
+    // the block goes back to acquire() once every lane has let go of it.
+    item.block.reset();
+    std::lock_guard<std::mutex> lock(lock_);
+    if (ret < 0) {
+      lane->result = ret;
+    }
+    freed_.notify_all();
+  }
+}
+
+std::vector<int> SessionFanOut::finish() {
+  finished_ = true;
+  std::vector<int> results;
+  if (!workers_) {
+    Lane &lane = lanes_[0];
+    results.push_back(lane.result >= 0 ? lane.session->finish() : lane.result);
+    return results;
+  }
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (Lane &lane : lanes_) {
+      lane.queue.push_back(Item{nullptr, 0, -1});
+    }
+    queued_.notify_all();
+  }
+  workers_->wait();
+  for (const Lane &lane : lanes_) {
+    results.push_back(lane.result);
+  }
+  return results;
+}
@@ -0,0 +1,80 @@
+#ifndef AUDIO_ENCODER_SESSION_FANOUT_H
+#define AUDIO_ENCODER_SESSION_FANOUT_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "encoder_session.h"
+#include "worker_pool.h"
+
+/**
+ * One producer feeding several EncoderSessions (an ABR ladder): the input is
+ * read, converted and run through the stage chain once, every session encodes
+ * the same blocks on its own thread.
+ *
+ * Blocks are shared, not copied: each session's queue holds a reference, a
+ * block is handed out again by acquire() once every session is done with it.
+ * The fixed set of blocks bounds how far the slowest session can fall behind.
+ * A single session is fed inline, without threads.
+ */
+class SessionFanOut {
+ public:
+  /** Planar float, `channels` planes of `block_size` samples. */
+  struct Block {
+    std::vector<float> data;
+  };
+
+  // blocks in flight per session before acquire() waits.
+  static const int QUEUE_DEPTH = 8;
+
+  SessionFanOut(const std::vector<EncoderSession *> &sessions, int channels, int block_size);
+
+  ~SessionFanOut();
+
+  /** A block no session holds anymore, waits for one. */
+  std::shared_ptr<Block> acquire();
+
+  /**
+   * Queues samples [offset, offset + nb_samples) of `block` to every session.
+   * Returns < 0 only once every session has failed, a failed session just
+   * drops what it gets.
+   */
+  int write(const std::shared_ptr<Block> &block, int offset, int nb_samples);
+
+  /** Lets every session encode what is queued, finishes it and returns its result, in session order. */
+  std::vector<int> finish();
+
+ private:
+  struct Item {
+    std::shared_ptr<Block> block;
+    int offset;
+    // -1 ends the lane.
+    int nb_samples;
+  };
+
+  struct Lane {
+    EncoderSession *session;
+    std::deque<Item> queue;
+    int result = 0;
+  };
+
+  void run(Lane *lane);
+  int write_block(EncoderSession *session, const Block &block, int offset, int nb_samples) const;
+
+  int channels_;
+  int block_size_;
+  std::vector<Lane> lanes_;
+  std::vector<std::shared_ptr<Block>> blocks_;
+  bool finished_ = false;
+
+  std::mutex lock_;
+  // an item was queued / a block or queue slot was freed.
+  std::condition_variable queued_;
+  std::condition_variable freed_;
+  std::unique_ptr<WorkerPool> workers_;
+};
+
+#endif //AUDIO_ENCODER_SESSION_FANOUT_H
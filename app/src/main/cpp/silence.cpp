@@ -0,0 +1,113 @@
+#include "silence.h"
+#include "base.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define WINDOW_MS 10
+
+// peak |x| and sum of squares of n samples.
+static void s16_stats(const int16_t *x, int n, int *peak, uint64_t *sumsq) {
+  int i = 0;
+  int max = 0;
+  uint64_t sum = 0;
+#if defined(__aarch64__)
+  int16x8_t vmax = vdupq_n_s16(0);
+  uint64x2_t vsum = vdupq_n_u64(0);
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t v = vld1q_s16(x + i);
+    vmax = vmaxq_s16(vmax, vqabsq_s16(v));
+    // each square is at most 2^30, two of them still fit an unsigned 32 bit lane.
+    uint32x4_t sq = vaddq_u32(vreinterpretq_u32_s32(vmull_s16(vget_low_s16(v), vget_low_s16(v))),
+                              vreinterpretq_u32_s32(vmull_s16(vget_high_s16(v), vget_high_s16(v))));
+    vsum = vpadalq_u32(vsum, sq);
+  }
+  max = vmaxvq_s16(vmax);
+  sum = vgetq_lane_u64(vsum, 0) + vgetq_lane_u64(vsum, 1);
+#elif defined(__SSE2__)
+  __m128i vmax = _mm_setzero_si128();
+  __m128i vsum = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+    vmax = _mm_max_epi16(vmax, _mm_max_epi16(v, _mm_subs_epi16(zero, v)));
+    // pairs of squares fit an unsigned 32 bit lane, widen before accumulating.
+    __m128i sq = _mm_madd_epi16(v, v);
+    vsum = _mm_add_epi64(vsum, _mm_unpacklo_epi32(sq, zero));
+    vsum = _mm_add_epi64(vsum, _mm_unpackhi_epi32(sq, zero));
+  }
+  int16_t lanes16[8];
+  _mm_storeu_si128((__m128i *)lanes16, vmax);
+  for (int k = 0; k < 8; k++) {
+    max = std::max(max, (int)lanes16[k]);
+  }
+  uint64_t lanes64[2];
+  _mm_storeu_si128((__m128i *)lanes64, vsum);
+  sum = lanes64[0] + lanes64[1];
+#endif
+  for (; i < n; i++) {
+    int v = x[i];
+    max = std::max(max, std::abs(v));
+    sum += (uint64_t)(v * v);
+  }
+  *peak = max;
+  *sumsq = sum;
+}
+
+std::vector<PcmRange> detect_sound(const int16_t *pcm, int64_t nb_samples, int channels, int sample_rate,
+                                   const SilenceOptions &opts) {
+  const int window = std::max(1, sample_rate * WINDOW_MS / 1000);
+  const double threshold = pow(10.0, opts.threshold_db / 20.0) * 32768.0;
+  const int64_t hangover = (int64_t)opts.hangover_ms * sample_rate / 1000;
+  const int64_t max_gap = (int64_t)opts.max_gap_ms * sample_rate / 1000;
+
+  // runs of active windows, padded by the hangover on both sides and merged.
+  std::vector<PcmRange> ranges;
+  for (int64_t pos = 0; pos < nb_samples; pos += window) {
+    int n = (int)std::min<int64_t>(window, nb_samples - pos);
+    int peak;
+    uint64_t sumsq;
+    s16_stats(pcm + pos * channels, n * channels, &peak, &sumsq);
+    double level = opts.peak ? peak : sqrt((double)sumsq / ((double)n * channels));
+    if (level < threshold) {
+      continue;
+    }
+    PcmRange r = {std::max<int64_t>(0, pos - hangover), std::min(nb_samples, pos + n + hangover)};
+    if (!ranges.empty() && r.start <= ranges.back().end) {
+      ranges.back().end = r.end;
+    } else {
+      ranges.push_back(r);
+    }
+  }
+
+  if (ranges.empty()) {
+    LOGW("input is silent below %.1f dB.", opts.threshold_db);
+    return ranges;
+  }
+
+  if (max_gap <= 0) {
+    // head / tail trim only.
+    PcmRange all = {ranges.front().start, ranges.back().end};
+    return std::vector<PcmRange>(1, all);
+  }
+
+  // keep max_gap of every longer silence, half on each side of the cut.
+  std::vector<PcmRange> kept(1, ranges[0]);
+  for (size_t i = 1; i < ranges.size(); i++) {
+    PcmRange &last = kept.back();
+    if (ranges[i].start - last.end <= max_gap) {
+      last.end = ranges[i].end;
+    } else {
+      last.end += max_gap / 2;
+      kept.push_back(PcmRange{ranges[i].start - (max_gap - max_gap / 2), ranges[i].end});
+    }
+  }
+  return kept;
+}
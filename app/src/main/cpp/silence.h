@@ -0,0 +1,26 @@
+#ifndef AUDIO_ENCODER_SILENCE_H
+#define AUDIO_ENCODER_SILENCE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "options.h"
+
+/** A span of interleaved input, in samples per channel, end exclusive. */
+struct PcmRange {
+  int64_t start;
+  int64_t end;
+};
+
+/**
+ * Splits interleaved S16 input into the ranges worth encoding.
+ *
+ * The input is cut into 10 ms windows whose RMS (or peak) is compared against the
+ * threshold. Leading and trailing silence is dropped, keeping `hangover_ms` around
+ * the first and last active window; with `max_gap_ms` set, internal silences longer
+ * than that are shortened to it. Returns no ranges when everything is silent.
+ */
+std::vector<PcmRange> detect_sound(const int16_t *pcm, int64_t nb_samples, int channels, int sample_rate,
+                                   const SilenceOptions &opts);
+
+#endif //AUDIO_ENCODER_SILENCE_H
@@ -0,0 +1,107 @@
+#ifndef AUDIO_ENCODER_SIMD_H
+#define AUDIO_ENCODER_SIMD_H
+
+/**
+ * A 4 x float vector over NEON (arm64), SSE2 (x86) or plain C.
+ *
+ * For analysis kernels that only need the baseline instruction set of each ABI, so
+ * they don't need a runtime dispatch table like PcmDsp. Lanes are typically
+ * channels (IIR filters) or polyphase phases (oversampling).
+ */
+
+#include <math.h>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+typedef float32x4_t f32x4;
+
+static inline f32x4 f32x4_load(const float *p) { return vld1q_f32(p); }
+static inline void f32x4_store(float *p, f32x4 v) { vst1q_f32(p, v); }
+static inline f32x4 f32x4_set1(float v) { return vdupq_n_f32(v); }
+static inline f32x4 f32x4_set(float a, float b, float c, float d) {
+  float tmp[4] = {a, b, c, d};
+  return vld1q_f32(tmp);
+}
+static inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return vaddq_f32(a, b); }
+static inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return vsubq_f32(a, b); }
+static inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return vmulq_f32(a, b); }
+/** acc + a * b */
+static inline f32x4 f32x4_mla(f32x4 acc, f32x4 a, f32x4 b) { return vmlaq_f32(acc, a, b); }
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return vminq_f32(a, b); }
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return vmaxq_f32(a, b); }
+static inline f32x4 f32x4_abs(f32x4 a) { return vabsq_f32(a); }
+static inline float f32x4_hsum(f32x4 a) { return vaddvq_f32(a); }
+static inline float f32x4_hmax(f32x4 a) { return vmaxvq_f32(a); }
+static inline float f32x4_hmin(f32x4 a) { return vminvq_f32(a); }
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128 f32x4;
+
+static inline f32x4 f32x4_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void f32x4_store(float *p, f32x4 v) { _mm_storeu_ps(p, v); }
+static inline f32x4 f32x4_set1(float v) { return _mm_set1_ps(v); }
+static inline f32x4 f32x4_set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+static inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+static inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return _mm_sub_ps(a, b); }
+static inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+static inline f32x4 f32x4_mla(f32x4 acc, f32x4 a, f32x4 b) { return _mm_add_ps(acc, _mm_mul_ps(a, b)); }
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return _mm_min_ps(a, b); }
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return _mm_max_ps(a, b); }
+static inline f32x4 f32x4_abs(f32x4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline float f32x4_hsum(f32x4 a) {
+  a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+  a = _mm_add_ss(a, _mm_shuffle_ps(a, a, 1));
+  return _mm_cvtss_f32(a);
+}
+static inline float f32x4_hmax(f32x4 a) {
+  a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+  a = _mm_max_ss(a, _mm_shuffle_ps(a, a, 1));
+  return _mm_cvtss_f32(a);
+}
+static inline float f32x4_hmin(f32x4 a) {
+  a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+  a = _mm_min_ss(a, _mm_shuffle_ps(a, a, 1));
+  return _mm_cvtss_f32(a);
+}
+
+#else
+
+struct f32x4 {
+  float v[4];
+};
+
+static inline f32x4 f32x4_load(const float *p) { return f32x4{{p[0], p[1], p[2], p[3]}}; }
+static inline void f32x4_store(float *p, f32x4 a) {
+  for (int i = 0; i < 4; i++) p[i] = a.v[i];
+}
+static inline f32x4 f32x4_set1(float v) { return f32x4{{v, v, v, v}}; }
+static inline f32x4 f32x4_set(float a, float b, float c, float d) { return f32x4{{a, b, c, d}}; }
+#define F32X4_MAP2(name, expr) \
+  static inline f32x4 name(f32x4 a, f32x4 b) { \
+    f32x4 r; \
+    for (int i = 0; i < 4; i++) r.v[i] = (expr); \
+    return r; \
+  }
+F32X4_MAP2(f32x4_add, a.v[i] + b.v[i])
+F32X4_MAP2(f32x4_sub, a.v[i] - b.v[i])
+F32X4_MAP2(f32x4_mul, a.v[i] * b.v[i])
+F32X4_MAP2(f32x4_min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+F32X4_MAP2(f32x4_max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+#undef F32X4_MAP2
+static inline f32x4 f32x4_mla(f32x4 acc, f32x4 a, f32x4 b) { return f32x4_add(acc, f32x4_mul(a, b)); }
+static inline f32x4 f32x4_abs(f32x4 a) {
+  for (int i = 0; i < 4; i++) a.v[i] = fabsf(a.v[i]);
+  return a;
+}
+static inline float f32x4_hsum(f32x4 a) { return a.v[0] + a.v[1] + a.v[2] + a.v[3]; }
+static inline float f32x4_hmax(f32x4 a) { return fmaxf(fmaxf(a.v[0], a.v[1]), fmaxf(a.v[2], a.v[3])); }
+static inline float f32x4_hmin(f32x4 a) { return fminf(fminf(a.v[0], a.v[1]), fminf(a.v[2], a.v[3])); }
+
+#endif
+
+static inline f32x4 f32x4_zero() { return f32x4_set1(0.0f); }
+
+#endif //AUDIO_ENCODER_SIMD_H
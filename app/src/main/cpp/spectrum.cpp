@@ -0,0 +1,158 @@
+#include "spectrum.h"
+#include "base.h"
+#include "simd.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+extern "C" {
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+}
+
+#define FLOOR_DB (-120)
+
+WindowedFft::~WindowedFft() {
+  av_tx_uninit(&tx_);
+  av_freep(&in_);
+  av_freep(&out_);
+}
+
+int WindowedFft::init(int size) {
+  float scale = 1.0f;
+  int ret = av_tx_init(&tx_, &tx_fn_, AV_TX_FLOAT_RDFT, 0, size, &scale, 0);
+  if (ret < 0) {
+    LOGE("av_tx_init failed, reason: %s", av_err2str(ret));
+    return ret;
+  }
+  size_ = size;
+  in_ = (float *)av_malloc(size * sizeof(float));
+  out_ = (AVComplexFloat *)av_malloc(bins() * sizeof(AVComplexFloat));
+  if (!in_ || !out_) {
+    return AVERROR(ENOMEM);
+  }
+  // periodic Hann, 50% overlap sums to a constant.
+  window_.resize(size);
+  for (int i = 0; i < size; i++) {
+    window_[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / size);
+  }
+  return 0;
+}
+
+const AVComplexFloat *WindowedFft::transform(const float *in) {
+  int i = 0;
+  for (; i + 4 <= size_; i += 4) {
+    f32x4_store(in_ + i, f32x4_mul(f32x4_load(in + i), f32x4_load(window_.data() + i)));
+  }
+  for (; i < size_; i++) {
+    in_[i] = in[i] * window_[i];
+  }
+  tx_fn_(tx_, out_, in_, sizeof(float));
+  return out_;
+}
+
+SpectrumStage::SpectrumStage(int sample_rate, const std::string &path, int fft_size)
+    : dsp_(pcm_dsp_get()),
+      sample_rate_(sample_rate),
+      path_(path),
+      fft_size_(fft_size),
+      hop_(fft_size / 2),
+      bins_(fft_size / 2 + 1),
+      frame_(fft_size, 0.0f),
+      row_(fft_size / 2 + 1) {
+}
+
+SpectrumStage::~SpectrumStage() {
+  if (file_) {
+    fclose(file_);
+  }
+}
+
+// lazily on the first block, a constructor can't report failure.
+int SpectrumStage::open() {
+  int ret = fft_.init(fft_size_);
+  if (ret < 0) {
+    return ret;
+  }
+
+  file_ = fopen(path_.c_str(), "wb");
+  if (!file_) {
+    LOGE("can't open spectrum output %s", path_.c_str());
+    return -1;
+  }
+  uint32_t rate = sample_rate_;
+  uint16_t header[4] = {(uint16_t)fft_size_, (uint16_t)hop_, (uint16_t)bins_, (uint16_t)(int16_t)FLOOR_DB};
+  fwrite("SPC1", 1, 4, file_);
+  fwrite(&rate, sizeof(rate), 1, file_);
+  fwrite(header, sizeof(header), 1, file_);
+  fwrite(&nb_frames_, sizeof(nb_frames_), 1, file_);
+  return 0;
+}
+
+int SpectrumStage::write_frame() {
+  const AVComplexFloat *out = fft_.transform(frame_.data());
+
+  // Hann's coherent gain is 1/2 and a real sine splits over +-f: full scale peaks at fft_size / 4.
+  const float norm = 4.0f / fft_size_;
+  const float to_code = 255.0f / -FLOOR_DB;
+  for (int k = 0; k < bins_; k++) {
+    float power = (out[k].re * out[k].re + out[k].im * out[k].im) * norm * norm;
+    float db = 10.0f * log10f(power + 1e-30f);
+    row_[k] = (uint8_t)lrintf(std::max(0.0f, std::min(255.0f, (db - FLOOR_DB) * to_code)));
+  }
+  if (fwrite(row_.data(), 1, row_.size(), file_) != row_.size()) {
+    LOGE("write spectrum frame failed.");
+    return -1;
+  }
+  nb_frames_++;
+  return 0;
+}
+
+int SpectrumStage::process(float *const *planes, int channels, int nb_samples) {
+  if (error_ < 0) {
+    return 0;
+  }
+  if (!file_ && (error_ = open()) < 0) {
+    // analysis only: the audio itself goes on.
+    return 0;
+  }
+  if ((int)mono_.size() < nb_samples) {
+    mono_.resize(nb_samples);
+  }
+  gains_.assign(channels, 1.0f / channels);
+  dsp_->mix(mono_.data(), planes, gains_.data(), channels, nb_samples);
+
+  int offset = 0;
+  while (offset < nb_samples) {
+    int n = std::min(nb_samples - offset, fft_size_ - fill_);
+    memcpy(frame_.data() + fill_, mono_.data() + offset, n * sizeof(float));
+    fill_ += n;
+    offset += n;
+    if (fill_ == fft_size_) {
+      if ((error_ = write_frame()) < 0) {
+        return 0;
+      }
+      memmove(frame_.data(), frame_.data() + hop_, (fft_size_ - hop_) * sizeof(float));
+      fill_ = fft_size_ - hop_;
+    }
+  }
+  return 0;
+}
+
+int SpectrumStage::finish() {
+  if (!file_) {
+    return error_;
+  }
+  // the tail that didn't fill a whole frame is zero padded into one last frame.
+  if (error_ == 0 && fill_ > fft_size_ - hop_) {
+    memset(frame_.data() + fill_, 0, (fft_size_ - fill_) * sizeof(float));
+    error_ = write_frame();
+  }
+  fseek(file_, 16, SEEK_SET);
+  fwrite(&nb_frames_, sizeof(nb_frames_), 1, file_);
+  fclose(file_);
+  file_ = nullptr;
+  LOGI("spectrum: %u frames of %d bins written to %s", nb_frames_, bins_, path_.c_str());
+  return error_;
+}
@@ -0,0 +1,98 @@
+#ifndef AUDIO_ENCODER_SPECTRUM_H
+#define AUDIO_ENCODER_SPECTRUM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "pcm_dsp.h"
+#include "pcm_stage.h"
+
+extern "C" {
+#include "libavutil/tx.h"
+}
+
+/**
+ * Periodic Hann window plus forward real FFT (av_tx) of `size` points, with
+ * the buffers reused from frame to frame. Shared by SpectrumStage and
+ * detect_bandwidth().
+ */
+class WindowedFft {
+ public:
+  WindowedFft() = default;
+  WindowedFft(const WindowedFft &) = delete;
+  WindowedFft &operator=(const WindowedFft &) = delete;
+
+  ~WindowedFft();
+
+  /** Returns 0 or a negative AVERROR. */
+  int init(int size);
+
+  /** Windows `size` samples of `in` and returns their size / 2 + 1 bins, valid until the next call. */
+  const AVComplexFloat *transform(const float *in);
+
+  int bins() const { return size_ / 2 + 1; }
+
+ private:
+  int size_ = 0;
+  AVTXContext *tx_ = nullptr;
+  av_tx_fn tx_fn_ = nullptr;
+  // av_malloc'ed so av_tx gets the alignment its SIMD code wants.
+  float *in_ = nullptr;
+  AVComplexFloat *out_ = nullptr;
+  std::vector<float> window_;
+};
+
+/**
+ * Spectrogram of the mono downmix, one Hann windowed real FFT (av_tx) every
+ * fft_size / 2 samples. Frames are streamed to the file as they are computed.
+ *
+ * File layout, little endian:
+ *
+ *   char     magic[4]      "SPC1"
+ *   uint32_t sample_rate
+ *   uint16_t fft_size
+ *   uint16_t hop
+ *   uint16_t bins          fft_size / 2 + 1
+ *   int16_t  floor_db      value 0, 255 is 0 dBFS
+ *   uint32_t nb_frames     filled in on finish()
+ *   nb_frames x bins x uint8_t magnitude
+ *
+ * A full scale sine reads 0 dBFS in its bin.
+ */
+class SpectrumStage : public PcmStage {
+ public:
+  SpectrumStage(int sample_rate, const std::string &path, int fft_size);
+
+  ~SpectrumStage() override;
+
+  int process(float *const *planes, int channels, int nb_samples) override;
+
+  int finish() override;
+
+ private:
+  int open();
+  int write_frame();
+
+  const PcmDsp *dsp_;
+  int sample_rate_;
+  std::string path_;
+  int fft_size_;
+  int hop_;
+  int bins_;
+
+  WindowedFft fft_;
+  // last fft_size_ downmixed samples, fill_ of them valid.
+  std::vector<float> frame_;
+  int fill_ = 0;
+  std::vector<float> mono_;
+  std::vector<float> gains_;
+  std::vector<uint8_t> row_;
+
+  FILE *file_ = nullptr;
+  uint32_t nb_frames_ = 0;
+  int error_ = 0;
+};
+
+#endif //AUDIO_ENCODER_SPECTRUM_H
@@ -0,0 +1,57 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(int threads) {
+  if (threads <= 0) {
+    threads = (int)std::thread::hardware_concurrency();
+  }
+  if (threads <= 0) {
+    threads = 1;
+  }
+  for (int i = 0; i < threads; i++) {
+    threads_.emplace_back(&WorkerPool::run, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &t : threads_) {
+    t.join();
+  }
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    tasks_.push_back(std::move(task));
+    pending_++;
+  }
+  wake_.notify_one();
+}
+
+void WorkerPool::wait() {
+  std::unique_lock<std::mutex> guard(lock_);
+  idle_.wait(guard, [this] { return pending_ == 0; });
+}
+
+void WorkerPool::run() {
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    wake_.wait(guard, [this] { return stop_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      return;
+    }
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    guard.unlock();
+    task();
+    guard.lock();
+    if (--pending_ == 0) {
+      idle_.notify_all();
+    }
+  }
+}
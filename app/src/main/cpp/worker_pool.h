@@ -0,0 +1,43 @@
+#ifndef AUDIO_ENCODER_WORKER_POOL_H
+#define AUDIO_ENCODER_WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads running submitted tasks in FIFO order. Tasks report
+ * their results through whatever they capture; wait() returns once everything
+ * submitted so far has run.
+ */
+class WorkerPool {
+ public:
+  /** 0 threads: one per core. */
+  explicit WorkerPool(int threads = 0);
+
+  /** Finishes the queued tasks, then joins. */
+  ~WorkerPool();
+
+  int size() const { return (int)threads_.size(); }
+
+  void submit(std::function<void()> task);
+
+  void wait();
+
+ private:
+  void run();
+
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::deque<std::function<void()>> tasks_;
+  // queued + running.
+  int pending_ = 0;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+#endif //AUDIO_ENCODER_WORKER_POOL_H
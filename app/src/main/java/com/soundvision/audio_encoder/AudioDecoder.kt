@@ -5,7 +5,6 @@ import android.media.MediaExtractor
 import android.media.MediaFormat
 import android.util.Log
 import java.io.File
-import java.io.FileOutputStream
 import java.io.IOException
 
 class AudioDecoder {
@@ -15,7 +14,7 @@ class AudioDecoder {
     fun convertAacToPcm() {
         var extractor: MediaExtractor? = null
         var decoder: MediaCodec? = null
-        var pcmOut: FileOutputStream? = null
+        var pcmOut: PacketSink? = null
 
         try {
 
@@ -51,7 +50,8 @@ class AudioDecoder {
 
             // 4. 准备输出文件
             val pcmFilePath = context!!.filesDir.path + File.separator + "convert.pcm"
-            pcmOut = FileOutputStream(pcmFilePath)
+            // PCM goes from the codec's buffers to the file natively, on a writer thread.
+            pcmOut = PacketSink.file(pcmFilePath)
 
             val info = MediaCodec.BufferInfo()
             var sawInputEOS = false
@@ -95,12 +95,7 @@ class AudioDecoder {
 
                     if (info.size > 0) {
                         val outputBuffer = decoder.getOutputBuffer(outputBufferIndex)
-                        outputBuffer!!.position(info.offset)
-                        outputBuffer.limit(info.offset + info.size)
-
-                        val pcmData = ByteArray(info.size)
-                        outputBuffer[pcmData]
-                        pcmOut.write(pcmData)
+                        pcmOut.write(outputBuffer!!, info.offset, info.size, info.presentationTimeUs)
                     }
 
                     decoder.releaseOutputBuffer(outputBufferIndex, false)
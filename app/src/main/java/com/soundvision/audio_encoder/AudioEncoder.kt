@@ -5,7 +5,8 @@ import android.media.MediaCodecInfo
 import android.media.MediaFormat
 import android.util.Log
 import java.io.File
-import java.io.FileOutputStream
+import java.io.IOException
+import java.nio.ByteBuffer
 
 class AudioEncoder {
     private val TAG = "PcmToAacConverter"
@@ -33,7 +34,9 @@ class AudioEncoder {
         mediaCodec.start()
 
         val bufferInfo = MediaCodec.BufferInfo()
-        val aacOutputStream = FileOutputStream(aacFile)
+        // frames are built and written natively, straight from the codec's output buffers.
+        val aacSink = PacketSink.file(aacFile.path)
+        var adts = 0L
 
         val buffer = ByteArray(MAX_INPUT_SIZE)
         var isEndOfStream = false
@@ -67,15 +70,17 @@ class AudioEncoder {
                         position(bufferInfo.offset)
                         limit(bufferInfo.offset + bufferInfo.size)
 
-                        // add acc header.
-                        if (bufferInfo.size > 0 && (bufferInfo.flags and MediaCodec.BUFFER_FLAG_CODEC_CONFIG) == 0) {
-                            val adtsHeader = ByteArray(7)
-                            addADTStoPacket(adtsHeader, bufferInfo.size + adtsHeader.size)
-                            aacOutputStream.write(adtsHeader)
-
-                            val data = ByteArray(bufferInfo.size)
-                            get(data)
-                            aacOutputStream.write(data)
+                        if ((bufferInfo.flags and MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0) {
+                            // AudioSpecificConfig: the ADTS header fields of the stream the codec actually produces.
+                            nativeAdtsClose(adts)
+                            adts = nativeAdtsOpen(this, bufferInfo.offset, bufferInfo.size)
+                        } else if (bufferInfo.size > 0) {
+                            // add acc header.
+                            val frameSize = nativeAdtsWrite(adts, this, bufferInfo.offset, bufferInfo.size,
+                                bufferInfo.presentationTimeUs, aacSink.handle)
+                            if (frameSize < 0) {
+                                throw IllegalStateException("ADTS framing failed")
+                            }
                         }
 
                         // release output buffer.
@@ -88,31 +93,28 @@ class AudioEncoder {
             Log.e(TAG, "转换过程中出错: ${e.message}")
             e.printStackTrace()
         } finally {
-            // 关闭资源
-            inputStream?.close()
-            aacOutputStream.close()
-
-            // 停止并释放编码器
+            // 停止并释放编码器, first: a failing close below must not leak it.
             mediaCodec.stop()
             mediaCodec.release()
 
+            // 关闭资源
+            nativeAdtsClose(adts)
+            try {
+                aacSink.close()
+            } catch (e: IOException) {
+                Log.e(TAG, "Error closing output file", e)
+            }
+            inputStream?.close()
+
             Log.i(TAG, "PCM 转 AAC 完成")
         }
     }
 
-    // 添加ADTS头到AAC包
-    private fun addADTStoPacket(packet: ByteArray, packetLen: Int) {
-        val profile = 2  // AAC LC
-        val freqIdx = 4  // 44.1KHz
-        val chanCfg = CHANNEL_COUNT  // CPE
-
-        // 填充ADTS头
-        packet[0] = 0xFF.toByte()
-        packet[1] = 0xF9.toByte()
-        packet[2] = ((profile - 1 shl 6) + (freqIdx shl 2) + (chanCfg shr 2)).toByte()
-        packet[3] = ((chanCfg and 3 shl 6) + (packetLen shr 11)).toByte()
-        packet[4] = ((packetLen and 0x7FF) shr 3).toByte()
-        packet[5] = (((packetLen and 7) shl 5) + 0x1F).toByte()
-        packet[6] = 0xFC.toByte()
-    }
-}
\ No newline at end of file
+    /** ADTS packetizer for the codec's AudioSpecificConfig in [csd], 0 when ADTS can't describe the stream. */
+    private external fun nativeAdtsOpen(csd: ByteBuffer, offset: Int, size: Int): Long
+
+    /** Writes header + [src] payload ([src] is direct) as one packet into [sink], returns the frame size or -1. */
+    private external fun nativeAdtsWrite(adts: Long, src: ByteBuffer, offset: Int, size: Int, ptsUs: Long, sink: Long): Int
+
+    private external fun nativeAdtsClose(adts: Long)
+}
@@ -3,7 +3,10 @@ package com.soundvision.audio_encoder
 import android.content.res.AssetManager
 import androidx.appcompat.app.AppCompatActivity
 import android.os.Bundle
+import android.os.SystemClock
+import android.util.Log
 import android.view.View
+import androidx.annotation.VisibleForTesting
 import com.soundvision.audio_encoder.databinding.ActivityMainBinding
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
@@ -25,14 +28,90 @@ class MainActivity : AppCompatActivity() {
 
         // Example of a call to a native method
         context = application
+
+        // load the codec stack once the first frame is up, off the main thread.
+        binding.root.post {
+            CoroutineScope(Dispatchers.Default).launch {
+                nativePrewarm()
+            }
+        }
     }
 
-    private external fun nativeEncode(assetManager: AssetManager, dest: String): Int
-    private external fun nativeDecode(src: String, dest: String):Int
+    /**
+     * [options] is a "key=value:key=value" string, "" keeps the defaults.
+     * Codec: codec (aac or opus, the container follows the extension of [dest]: .aac, .m4a, .ogg / .opus, .webm),
+     * bitrate (b/s), sample_rate, channels (1 or 2); defaults are aac 96k 44.1 kHz stereo, opus 24k 48 kHz mono.
+     * resample (fast, medium, high; default medium): quality of the conversion to the encoder's rate.
+     * auto_rate (1 = outputs without sample_rate drop to 16, 24 or 32 kHz when the measured bandwidth fits).
+     * Channels: in_layout (layout of the input, mono, stereo, 5.1, 7.1, ...; default stereo), layout (encoded
+     * layout, overrides channels), matrix (out x in remix coefficients, "1,0,0.7|0,1,0.7"; default downmix
+     * otherwise). The input is remixed before the pre-encode stage, which then runs on the encoded channels.
+     * dual_mono (dB, default -60): stereo input whose L - R stays that far under L + R is encoded as mono at
+     * half the bitrate unless channels / layout / matrix are given; 0 turns the check off.
+     * backend (ffmpeg, the default, or mediacodec: AAC with the device's own encoder, Android 9+, .aac / .m4a only).
+     * AAC only: profile (lc, he, hev2, ld, eld; default auto picks from bitrate and latency, the delay budget in ms),
+     * anything but lc needs FFmpeg built with libfdk_aac, ld / eld an .m4a output.
+     * Opus only: frame_duration (ms, 2.5..60, default 20), complexity (0..10), dtx (1 = on), fec (1 = on).
+     * codec=flac writes a lossless .flac of the source, encoded on all cores: compression_level (0..12, default 5),
+     * threads (0 = one per core); no processing or format options.
+     * Pre-encode stage: gain (dB), fade_in (ms), soft_clip (knee 0..1),
+     * mix (assets mixed under the input, "a.pcm|b.pcm"), mix_gain (dB, "-12|-18"),
+     * normalize (target LUFS, two-pass loudness normalization), true_peak (limiter ceiling dBTP, default -1).
+     * Silence trimming: silence (threshold dBFS, e.g. -50), silence_hangover (ms kept around sound, default 200),
+     * silence_gap (internal silences longer than this many ms are shortened to it), silence_peak (1 = peak, not RMS).
+     * peaks (path, 256/1024/4096 sample min/max waveform pyramid of the encoded audio),
+     * cache (directory of earlier encodes reused for identical input + options, skipped with peaks),
+     * cache_size (MB kept in the cache, least recently used evicted first, default 256).
+     */
+    @VisibleForTesting(otherwise = VisibleForTesting.PRIVATE)
+    external fun nativeEncode(assetManager: AssetManager, dest: String, options: String): Int
+
+    /**
+     * ABR ladder: reads and processes the input once and encodes it into every [dests] entry, each output on
+     * its own thread. [options] are shared by all outputs as for [nativeEncode]; [variants] has one entry per
+     * output with only codec, backend, bitrate, sample_rate, resample, channels, layout, profile, latency and the opus keys,
+     * e.g. "bitrate=32000:profile=he". codec=flac is not allowed. Returns 0 when every output was written,
+     * -n when n of them failed.
+     */
+    private external fun nativeEncodeLadder(
+        assetManager: AssetManager,
+        dests: Array<String>,
+        options: String,
+        variants: Array<String>
+    ): Int
+
+    /**
+     * sample_rate (output rate, default the decoded one), resample (quality as for [nativeEncode]).
+     * threads (a raw .aac is split at ADTS frames and decoded on this many threads, 0 = one per core; default 1).
+     * Post-decode stage: gain, fade_in, soft_clip as for [nativeEncode],
+     * dither (1 = TPDF dither on the float to S16 reduction),
+     * loudness (path, EBU R128 integrated / range / true peak and ReplayGain written there as JSON).
+     * peaks (path, waveform pyramid as for [nativeEncode]),
+     * spectrum (path, spectrogram of 8 bit dB magnitudes), spectrum_size (FFT length, default 2048).
+     */
+    private external fun nativeDecode(src: String, dest: String, options: String): Int
+
+    /**
+     * Duration, format and bitrate of every file in [paths] from its headers alone, several files at a time.
+     * Returns 4 values per path: duration (ms), sample rate, channels, average bitrate (b/s); all -1 when the
+     * file couldn't be read. WAV, FLAC, Ogg, MP4 / M4A and ADTS are parsed natively, other formats are opened
+     * with FFmpeg. The rate of an HE-AAC .aac is its core rate, half the decoded one.
+     */
+    private external fun nativeScan(paths: Array<String>): LongArray
+
+    /**
+     * Loads the FFmpeg backed core library and opens the first encoder, otherwise
+     * both happen on the first [nativeEncode] / [nativeDecode] call.
+     */
+    private external fun nativePrewarm(): Boolean
+
     companion object {
         // Used to load the 'audio_encoder' library on application startup.
+        // It is only the JNI shim, the codec stack is loaded lazily.
         init {
+            val start = SystemClock.elapsedRealtimeNanos()
             System.loadLibrary("audio_encoder")
+            Log.i("MainActivity", "audio_encoder loaded in ${(SystemClock.elapsedRealtimeNanos() - start) / 1000} us")
         }
     }
 
@@ -51,7 +130,7 @@ class MainActivity : AppCompatActivity() {
     fun nativeToAAC(view: View) {
         CoroutineScope (Dispatchers.Default).launch {
             val file = File(application.filesDir, "native_haidao.aac")
-            nativeEncode(assets, file.path)
+            nativeEncode(assets, file.path, "")
         }
     }
 
@@ -59,7 +138,7 @@ class MainActivity : AppCompatActivity() {
         CoroutineScope (Dispatchers.Default).launch {
             val src = File(application.filesDir, "native_haidao.aac")
             val dest = File(application.filesDir, "native_haidao.pcm")
-            nativeDecode(src.path, dest.path)
+            nativeDecode(src.path, dest.path, "")
         }
     }
 
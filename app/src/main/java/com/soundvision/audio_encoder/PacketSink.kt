@@ -0,0 +1,59 @@
+package com.soundvision.audio_encoder
+
+import java.io.Closeable
+import java.io.IOException
+import java.nio.ByteBuffer
+
+/**
+ * Native destination for MediaCodec output: [write] takes the direct buffer from
+ * `getOutputBuffer` as is, the bytes are read in native code and never copied
+ * onto the Java heap.
+ *
+ * [file] writes on a background thread.
+ */
+class PacketSink private constructor(handle: Long) : Closeable {
+    internal var handle: Long = handle
+        private set
+
+    /** [buffer] must be direct, [offset] / [size] as in `MediaCodec.BufferInfo`. */
+    fun write(buffer: ByteBuffer, offset: Int, size: Int, presentationTimeUs: Long) {
+        if (nativeWrite(handle, buffer, offset, size, presentationTimeUs) < 0) {
+            throw IOException("packet sink write failed")
+        }
+    }
+
+    /** Returns the bytes written. */
+    fun closeAndCount(): Long {
+        val bytes = nativeClose(handle)
+        handle = 0
+        if (bytes < 0) {
+            throw IOException("packet sink close failed")
+        }
+        return bytes
+    }
+
+    override fun close() {
+        if (handle != 0L) {
+            closeAndCount()
+        }
+    }
+
+    companion object {
+        fun file(path: String): PacketSink {
+            val handle = nativeOpenFile(path)
+            if (handle == 0L) {
+                throw IOException("can't open $path")
+            }
+            return PacketSink(handle)
+        }
+
+        @JvmStatic
+        private external fun nativeOpenFile(path: String): Long
+
+        @JvmStatic
+        private external fun nativeWrite(handle: Long, buffer: ByteBuffer, offset: Int, size: Int, ptsUs: Long): Int
+
+        @JvmStatic
+        private external fun nativeClose(handle: Long): Long
+    }
+}
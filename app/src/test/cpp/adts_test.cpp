@@ -0,0 +1,167 @@
+#include "adts.h"
+#include "test.h"
+
+#include <string.h>
+#include <vector>
+
+static void test_config() {
+  AdtsConfig config;
+  // AAC LC, 44.1 kHz, stereo.
+  const uint8_t lc[] = {0x12, 0x10};
+  CHECK_EQ(adts_config_from_asc(lc, sizeof(lc), &config), 0);
+  CHECK_EQ(config.object_type, 2);
+  CHECK_EQ(config.sample_rate_index, 4);
+  CHECK_EQ(config.channel_config, 2);
+
+  // explicit HE-AAC: SBR, 22.05 kHz core, 44.1 kHz out, then LC. ADTS carries the core.
+  const uint8_t he[] = {0x2B, 0x92, 0x08, 0x00};
+  CHECK_EQ(adts_config_from_asc(he, sizeof(he), &config), 0);
+  CHECK_EQ(config.object_type, 2);
+  CHECK_EQ(config.sample_rate_index, 7);
+  CHECK_EQ(config.channel_config, 2);
+
+  CHECK_EQ(adts_config_from_asc(lc, 1, &config), -1);
+  // object type 23 (ER AAC LD) has no ADTS profile.
+  const uint8_t ld[] = {0xBA, 0x10};
+  CHECK_EQ(adts_config_from_asc(ld, sizeof(ld), &config), -1);
+
+  CHECK_EQ(adts_config_make(2, 48000, 8, &config), 0);
+  CHECK_EQ(config.sample_rate_index, 3);
+  CHECK_EQ(config.channel_config, 7);
+  CHECK_EQ(adts_config_make(2, 44000, 2, &config), -1);
+  CHECK_EQ(adts_config_make(2, 44100, 7, &config), -1);
+  CHECK_EQ(adts_config_make(5, 44100, 2, &config), -1);
+}
+
+static void test_header_round_trip() {
+  const int rates[] = {96000, 48000, 44100, 22050, 8000, 7350};
+  for (int object_type = 1; object_type <= 4; object_type++) {
+    for (int rate : rates) {
+      for (int channels : {1, 2, 6, 8}) {
+        AdtsConfig config;
+        CHECK_EQ(adts_config_make(object_type, rate, channels, &config), 0);
+        for (int payload : {1, 371, ADTS_MAX_FRAME_SIZE - ADTS_HEADER_SIZE}) {
+          std::vector<uint8_t> frame(ADTS_HEADER_SIZE + payload, 0x5A);
+          adts_write_header(config, payload, frame.data());
+          AdtsHeader header;
+          CHECK_EQ(adts_parse_header(frame.data(), (int64_t)frame.size(), &header), (int)frame.size());
+          CHECK_EQ(header.object_type, object_type);
+          CHECK_EQ(header.sample_rate, rate);
+          CHECK_EQ(header.channel_config, channels == 8 ? 7 : channels);
+          CHECK_EQ(header.frame_length, (int)frame.size());
+          CHECK_EQ(header.header_size, ADTS_HEADER_SIZE);
+          CHECK_EQ(header.blocks, 1);
+          // the frame must fit in what is left of the input.
+          CHECK_EQ(adts_parse_header(frame.data(), (int64_t)frame.size() - 1, &header), -1);
+        }
+      }
+    }
+  }
+  // a frame with no payload is no frame.
+  AdtsConfig config;
+  adts_config_make(2, 44100, 2, &config);
+  uint8_t empty[ADTS_HEADER_SIZE];
+  adts_write_header(config, 0, empty);
+  AdtsHeader header;
+  CHECK_EQ(adts_parse_header(empty, sizeof(empty), &header), -1);
+  const uint8_t not_adts[ADTS_HEADER_SIZE] = {0xFF, 0xFB, 0x90, 0x64, 0, 0, 0};
+  CHECK_EQ(adts_parse_header(not_adts, sizeof(not_adts), &header), -1);
+}
+
+static void test_packetizer() {
+  AdtsConfig config;
+  adts_config_make(2, 44100, 2, &config);
+  AdtsPacketizer packetizer(config);
+  std::vector<uint8_t> payload(300);
+  for (size_t i = 0; i < payload.size(); i++) {
+    payload[i] = (uint8_t)i;
+  }
+  int size = 0;
+  const uint8_t *frame = packetizer.packetize(payload.data(), (int)payload.size(), &size);
+  CHECK(frame != nullptr);
+  CHECK_EQ(size, ADTS_HEADER_SIZE + (int)payload.size());
+  CHECK(!memcmp(frame + ADTS_HEADER_SIZE, payload.data(), payload.size()));
+  uint8_t header[ADTS_HEADER_SIZE];
+  adts_write_header(config, (int)payload.size(), header);
+  CHECK(!memcmp(frame, header, sizeof(header)));
+
+  std::vector<uint8_t> dst(ADTS_HEADER_SIZE + payload.size());
+  CHECK_EQ(packetizer.write(payload.data(), (int)payload.size(), dst.data(), (int)dst.size()), (int)dst.size());
+  CHECK_EQ(packetizer.write(payload.data(), (int)payload.size(), dst.data(), (int)dst.size() - 1), -1);
+  std::vector<uint8_t> big(ADTS_MAX_FRAME_SIZE);
+  CHECK(packetizer.packetize(big.data(), (int)big.size(), &size) == nullptr);
+}
+
+static void test_find_sync() {
+  // every offset and tail length, so the SIMD body and the scalar tail both get to find it.
+  for (int size = 2; size <= 80; size++) {
+    for (int at = 0; at + 2 <= size; at++) {
+      std::vector<uint8_t> data(size, 0xFF);
+      for (int i = 0; i < size; i++) {
+        // 0xFF pairs that aren't a sync: 0xFF 0xFF has layer 3.
+        data[i] = i < at ? 0xFF : 0x00;
+      }
+      data[at] = 0xFF;
+      data[at + 1] = 0xF1;
+      if (at > 0) {
+        data[at - 1] = 0x12;
+      }
+      CHECK_EQ(adts_find_sync(data.data(), size), at);
+    }
+    std::vector<uint8_t> none(size, 0xFF);
+    CHECK_EQ(adts_find_sync(none.data(), size), size);
+  }
+}
+
+static std::vector<uint8_t> id3_tag(int body, bool footer) {
+  std::vector<uint8_t> tag(ID3V2_HEADER_SIZE + body + (footer ? ID3V2_HEADER_SIZE : 0), 0xFF);
+  memcpy(tag.data(), "ID3\x04\x00", 5);
+  tag[5] = footer ? 0x10 : 0x00;
+  // syncsafe, 7 bits per byte.
+  tag[6] = (uint8_t)((body >> 21) & 0x7F);
+  tag[7] = (uint8_t)((body >> 14) & 0x7F);
+  tag[8] = (uint8_t)((body >> 7) & 0x7F);
+  tag[9] = (uint8_t)(body & 0x7F);
+  return tag;
+}
+
+static void test_index_frames() {
+  AdtsConfig config;
+  adts_config_make(2, 48000, 2, &config);
+  // an ID3 tag full of sync words, frames, then garbage between two frames.
+  std::vector<uint8_t> data = id3_tag(200, true);
+  CHECK_EQ(id3v2_tag_size(data.data(), (int64_t)data.size()), 220);
+  CHECK_EQ(id3v2_tag_size(data.data(), 9), 0);
+  std::vector<AdtsFrame> expect;
+  for (int i = 0; i < 20; i++) {
+    if (i == 10) {
+      const uint8_t garbage[] = {0xFF, 0xF1, 0x00, 0x13, 0x37};
+      data.insert(data.end(), garbage, garbage + sizeof(garbage));
+    }
+    const int payload = 100 + i * 7;
+    std::vector<uint8_t> frame(ADTS_HEADER_SIZE + payload, 0xFF);
+    adts_write_header(config, payload, frame.data());
+    expect.push_back(AdtsFrame{(int64_t)data.size(), (int)frame.size()});
+    data.insert(data.end(), frame.begin(), frame.end());
+  }
+
+  std::vector<AdtsFrame> frames;
+  CHECK_EQ(adts_index_frames(data.data(), (int64_t)data.size(), &frames), (int64_t)expect.size());
+  CHECK_EQ(frames.size(), expect.size());
+  for (size_t i = 0; i < frames.size() && i < expect.size(); i++) {
+    CHECK_EQ(frames[i].offset, expect[i].offset);
+    CHECK_EQ(frames[i].size, expect[i].size);
+  }
+
+  const uint8_t text[] = "no frames in here";
+  CHECK_EQ(adts_index_frames(text, sizeof(text), &frames), 0);
+}
+
+int main() {
+  test_config();
+  test_header_round_trip();
+  test_packetizer();
+  test_find_sync();
+  test_index_frames();
+  return test_result();
+}
@@ -0,0 +1,154 @@
+#include "flac_frame.h"
+#include "test.h"
+
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include "libavutil/error.h"
+}
+
+// bit by bit, MSB first, as the FLAC format spells them out: CRC-8 poly 0x07, CRC-16 poly 0x8005.
+static uint8_t crc8(const uint8_t *data, size_t n) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+  }
+  return crc;
+}
+
+static uint16_t crc16(const uint8_t *data, size_t n) {
+  uint16_t crc = 0;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= (uint16_t)(data[i] << 8);
+    for (int b = 0; b < 8; b++) {
+      crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+    }
+  }
+  return crc;
+}
+
+// FLAC's coded number back, 0 bytes when it isn't valid.
+static uint64_t read_utf8(const uint8_t *p, int *size) {
+  if (p[0] < 0x80) {
+    *size = 1;
+    return p[0];
+  }
+  int n = 0;
+  while (n < 8 && (p[0] & (0x80 >> n))) {
+    n++;
+  }
+  if (n < 2 || n > 7) {
+    *size = 0;
+    return 0;
+  }
+  uint64_t v = p[0] & (0x7F >> n);
+  for (int i = 1; i < n; i++) {
+    if ((p[i] & 0xC0) != 0x80) {
+      *size = 0;
+      return 0;
+    }
+    v = (v << 6) | (p[i] & 0x3F);
+  }
+  *size = n;
+  return v;
+}
+
+// a frame with valid CRCs: block size code `bs`, rate code `sr`, frame `number`, `body` bytes of subframe data.
+static std::vector<uint8_t> make_frame(int bs, int sr, uint64_t number, int body) {
+  std::vector<uint8_t> f = {0xFF, 0xF8, (uint8_t)(bs << 4 | sr), 0x18};
+  uint8_t buf[8];
+  int n = flac_put_utf8(buf, number);
+  f.insert(f.end(), buf, buf + n);
+  // explicit block size (8 / 16 bit) and rate (8 / 16 bit) after the number.
+  const int extra = (bs == 6 ? 1 : bs == 7 ? 2 : 0) + (sr == 12 ? 1 : sr == 13 || sr == 14 ? 2 : 0);
+  for (int i = 0; i < extra; i++) {
+    f.push_back((uint8_t)(0x21 + i));
+  }
+  f.push_back(crc8(f.data(), f.size()));
+  for (int i = 0; i < body; i++) {
+    f.push_back((uint8_t)(i * 37 + 11));
+  }
+  uint16_t crc = crc16(f.data(), f.size());
+  f.push_back((uint8_t)(crc >> 8));
+  f.push_back((uint8_t)crc);
+  return f;
+}
+
+static void check_frame(const uint8_t *f, int size, uint64_t number, const std::vector<uint8_t> &src, int extra) {
+  CHECK(!memcmp(f, src.data(), 4));
+  int n = 0;
+  CHECK(read_utf8(f + 4, &n) == number);
+  CHECK(n > 0);
+  int old = 0;
+  read_utf8(src.data() + 4, &old);
+  CHECK(!memcmp(f + 4 + n, src.data() + 4 + old, extra));
+  const int header = 4 + n + extra;
+  CHECK_EQ(f[header], crc8(f, header));
+  const int body = (int)src.size() - (4 + old + extra + 1) - 2;
+  CHECK_EQ(size, header + 1 + body + 2);
+  CHECK(!memcmp(f + header + 1, src.data() + 4 + old + extra + 1, body));
+  CHECK_EQ((f[size - 2] << 8) | f[size - 1], crc16(f, size - 2));
+}
+
+static void test_utf8() {
+  const uint64_t numbers[] = {0, 1, 0x7F, 0x80, 0x7FF, 0x800, 0xFFFF, 0x10000, 0x1FFFFF, 0x200000,
+                              0x3FFFFFF, 0x4000000, 0x7FFFFFFF, 0x80000000ULL, 0xFFFFFFFFFULL};
+  const int sizes[] = {1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7};
+  for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+    uint8_t buf[8];
+    CHECK_EQ(flac_put_utf8(buf, numbers[i]), sizes[i]);
+    int n = 0;
+    CHECK(read_utf8(buf, &n) == numbers[i]);
+    CHECK_EQ(n, sizes[i]);
+  }
+}
+
+static void test_renumber() {
+  const uint64_t numbers[] = {0, 5, 0x7F, 0x80, 0x12345, 0x7FFFFFFF, 0xFFFFFFFFFULL};
+  // fixed 4096 / 44.1 kHz, 8 bit explicit size / 8 bit rate, 16 bit size / 16 bit rate.
+  const int codes[][2] = {{12, 9}, {6, 12}, {7, 13}, {7, 14}};
+  for (const auto &code : codes) {
+    const int extra = (code[0] == 6 ? 1 : code[0] == 7 ? 2 : 0) + (code[1] == 12 ? 1 : 2 * (code[1] >= 13));
+    for (uint64_t from : numbers) {
+      const std::vector<uint8_t> src = make_frame(code[0], code[1], from, 57);
+      for (uint64_t to : numbers) {
+        std::vector<uint8_t> out(3, 0xAA);
+        int size = flac_renumber_frame(src.data(), (int)src.size(), to, &out);
+        CHECK_EQ(size, (int)out.size() - 3);
+        // appended, what was there stays.
+        CHECK(out[0] == 0xAA && out[1] == 0xAA && out[2] == 0xAA);
+        if (size > 0) {
+          check_frame(out.data() + 3, size, to, src, extra);
+        }
+        // renumbered as the number it had is the frame itself.
+        if (to == from) {
+          CHECK(std::vector<uint8_t>(out.begin() + 3, out.end()) == src);
+        }
+      }
+    }
+  }
+}
+
+static void test_invalid() {
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> frame = make_frame(12, 9, 3, 20);
+  frame[1] = 0xF0;
+  CHECK_EQ(flac_renumber_frame(frame.data(), (int)frame.size(), 0, &out), AVERROR_INVALIDDATA);
+  frame = make_frame(12, 9, 3, 20);
+  CHECK_EQ(flac_renumber_frame(frame.data(), 7, 0, &out), AVERROR_INVALIDDATA);
+  // a header that claims more than the frame has.
+  frame = make_frame(7, 14, 0xFFFFFFFFFULL, 0);
+  CHECK_EQ(flac_renumber_frame(frame.data(), 4 + 7 + 4, 0, &out), AVERROR_INVALIDDATA);
+  CHECK(out.empty());
+}
+
+int main() {
+  test_utf8();
+  test_renumber();
+  test_invalid();
+  return test_result();
+}
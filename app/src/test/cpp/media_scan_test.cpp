@@ -0,0 +1,245 @@
+#include "adts.h"
+#include "media_scan.h"
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavutil/error.h"
+}
+
+namespace {
+
+// builds a file's bytes.
+struct Bytes {
+  std::vector<uint8_t> data;
+
+  void put(const void *p, size_t n) {
+    data.insert(data.end(), (const uint8_t *)p, (const uint8_t *)p + n);
+  }
+  void str(const char *s) { put(s, strlen(s)); }
+  void u8(uint32_t v) { data.push_back((uint8_t)v); }
+  void le16(uint32_t v) { u8(v); u8(v >> 8); }
+  void le32(uint32_t v) { le16(v); le16(v >> 16); }
+  void le64(uint64_t v) { le32((uint32_t)v); le32((uint32_t)(v >> 32)); }
+  void be16(uint32_t v) { u8(v >> 8); u8(v); }
+  void be32(uint32_t v) { be16(v >> 16); be16(v); }
+  void zeros(size_t n) { data.insert(data.end(), n, 0); }
+
+  // an MP4 box around what `body` appends.
+  template <typename F>
+  void box(const char *type, F body) {
+    size_t at = data.size();
+    be32(0);
+    str(type);
+    body();
+    uint32_t size = (uint32_t)(data.size() - at);
+    for (int i = 0; i < 4; i++) {
+      data[at + i] = (uint8_t)(size >> (24 - 8 * i));
+    }
+  }
+};
+
+std::string dir;
+
+std::string write_file(const char *name, const Bytes &bytes) {
+  std::string path = dir + "/" + name;
+  FILE *f = fopen(path.c_str(), "wb");
+  fwrite(bytes.data.data(), 1, bytes.data.size(), f);
+  fclose(f);
+  return path;
+}
+
+}
+
+// 2 s of 44.1 kHz stereo S16, a LIST chunk before the data.
+static std::string make_wav() {
+  const uint32_t data = 44100 * 4 * 2;
+  Bytes b;
+  b.str("RIFF");
+  b.le32(4 + 8 + 16 + 8 + 5 + 1 + 8 + data);
+  b.str("WAVEfmt ");
+  b.le32(16);
+  b.le16(1);
+  b.le16(2);
+  b.le32(44100);
+  b.le32(44100 * 4);
+  b.le16(4);
+  b.le16(16);
+  // odd sized, padded to even.
+  b.str("LIST");
+  b.le32(5);
+  b.zeros(6);
+  b.str("data");
+  b.le32(data);
+  b.zeros(data);
+  return write_file("a.wav", b);
+}
+
+// STREAMINFO of 96000 samples at 48 kHz, 2 channels, 16 bit.
+static std::string make_flac() {
+  Bytes b;
+  b.str("fLaC");
+  b.u8(0x80);
+  b.u8(0);
+  b.u8(0);
+  b.u8(34);
+  b.be16(4096);
+  b.be16(4096);
+  b.zeros(6);
+  const uint64_t bits = (uint64_t)48000 << 44 | (uint64_t)1 << 41 | (uint64_t)15 << 36 | 96000;
+  b.be32((uint32_t)(bits >> 32));
+  b.be32((uint32_t)bits);
+  b.zeros(16);
+  b.zeros(100000 - b.data.size());
+  return write_file("b.flac", b);
+}
+
+static void ogg_page(Bytes *b, uint64_t granule, uint32_t sequence, const Bytes &packet) {
+  b->str("OggS");
+  b->u8(0);
+  b->u8(sequence == 0 ? 2 : 0);
+  b->le64(granule);
+  b->le32(0x1234);
+  b->le32(sequence);
+  // checksum, not looked at.
+  b->le32(0);
+  b->u8(1);
+  b->u8((uint32_t)packet.data.size());
+  b->put(packet.data.data(), packet.data.size());
+}
+
+// 3 s of Opus: the last granule counts 48 kHz samples plus the pre-skip.
+static std::string make_opus() {
+  Bytes head;
+  head.str("OpusHead");
+  head.u8(1);
+  head.u8(2);
+  head.le16(312);
+  head.le32(44100);
+  head.le16(0);
+  head.u8(0);
+  Bytes audio;
+  audio.zeros(200);
+  Bytes b;
+  ogg_page(&b, 0, 0, head);
+  for (uint32_t i = 1; i <= 150; i++) {
+    ogg_page(&b, 312 + 960 * i, i, audio);
+  }
+  return write_file("c.opus", b);
+}
+
+// 4 s of 44.1 kHz stereo AAC in an MP4, mdat ahead of moov.
+static std::string make_m4a() {
+  Bytes b;
+  b.box("ftyp", [&] { b.str("M4A "); b.be32(0); b.str("isomM4A "); });
+  b.box("mdat", [&] { b.zeros(64000); });
+  b.box("moov", [&] {
+    b.box("trak", [&] {
+      b.box("mdia", [&] {
+        b.box("mdhd", [&] {
+          b.zeros(12);
+          b.be32(44100);
+          b.be32(44100 * 4);
+          b.zeros(4);
+        });
+        b.box("hdlr", [&] { b.zeros(8); b.str("soun"); b.zeros(13); });
+        b.box("minf", [&] {
+          b.box("stbl", [&] {
+            b.box("stsd", [&] {
+              b.zeros(4);
+              b.be32(1);
+              b.box("mp4a", [&] {
+                b.zeros(16);
+                b.be16(2);
+                b.be16(16);
+                b.zeros(4);
+                b.be32(44100u << 16);
+              });
+            });
+          });
+        });
+      });
+    });
+  });
+  return write_file("d.m4a", b);
+}
+
+// ~100 s of 44.1 kHz stereo ADTS behind an ID3 tag, more than the scanner reads from the head.
+static std::string make_aac() {
+  Bytes b;
+  b.str("ID3");
+  b.u8(4);
+  b.zeros(3);
+  b.u8(0);
+  b.u8(1);
+  b.u8(0);
+  b.data.insert(b.data.end(), 128, 0xFF);
+  AdtsConfig config;
+  adts_config_make(2, 44100, 2, &config);
+  std::vector<uint8_t> frame(400);
+  adts_write_header(config, 400 - ADTS_HEADER_SIZE, frame.data());
+  for (int i = 0; i < 4307; i++) {
+    b.put(frame.data(), frame.size());
+  }
+  return write_file("e.aac", b);
+}
+
+static void check_result(const ScanResult &r, int64_t duration_ms, int sample_rate, int channels, int64_t bit_rate) {
+  CHECK_EQ(r.ret, 0);
+  CHECK_EQ(r.duration_ms, duration_ms);
+  CHECK_EQ(r.sample_rate, sample_rate);
+  CHECK_EQ(r.channels, channels);
+  CHECK_EQ(r.bit_rate, bit_rate);
+}
+
+int main() {
+  char tmp[] = "/tmp/media_scan_test.XXXXXX";
+  if (!mkdtemp(tmp)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  dir = tmp;
+
+  const std::vector<std::string> paths = {make_wav(), make_flac(), make_opus(), make_m4a(), make_aac()};
+  Bytes junk;
+  junk.str("neither a header nor audio");
+  const std::string unknown = write_file("f.bin", junk);
+  const std::string missing = dir + "/missing.wav";
+
+  for (int threads : {1, 4}) {
+    std::vector<std::string> all = paths;
+    all.push_back(unknown);
+    all.push_back(missing);
+    std::vector<ScanResult> results;
+    scan_files(all, threads, &results);
+    CHECK_EQ(results.size(), all.size());
+    if (results.size() != all.size()) {
+      break;
+    }
+    check_result(results[0], 2000, 44100, 2, 1411200);
+    check_result(results[1], 2000, 48000, 2, 100000 * 8 / 2);
+    check_result(results[2], 3000, 48000, 2, (int64_t)(27 + 1 + 19 + 150 * (27 + 1 + 200)) * 8 / 3);
+    check_result(results[3], 4000, 44100, 2, 64000 * 8 / 4);
+    // the header's rate and the frames' average (400 bytes per 1024 samples, rounded), extrapolated from the head.
+    check_result(results[4], 100008, 44100, 2, 137813);
+    CHECK(results[5].ret < 0);
+    CHECK_EQ(results[6].ret, AVERROR(ENOENT));
+  }
+
+  ScanResult r;
+  CHECK_EQ(scan_file(paths[0].c_str(), &r), 0);
+  CHECK_EQ(scan_file(missing.c_str(), &r), AVERROR(ENOENT));
+  CHECK_EQ(r.duration_ms, 0);
+
+  for (const std::string &path : paths) {
+    unlink(path.c_str());
+  }
+  unlink(unknown.c_str());
+  rmdir(tmp);
+  return test_result();
+}
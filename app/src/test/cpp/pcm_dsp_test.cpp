@@ -0,0 +1,274 @@
+#include "pcm_dsp.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// every kernel of pcm_dsp_get() against the scalar reference, at every length up to a few vectors past the
+// widest (8 floats, 16 with the unrolled loops), so each body and tail gets run.
+#define MAX_LEN 67
+#define MAX_CH 8
+
+static const PcmDsp *simd;
+static const PcmDsp *ref;
+
+static float rand_float(float range) {
+  return ((float)rand() / (float)RAND_MAX * 2.0f - 1.0f) * range;
+}
+
+static std::vector<float> random_floats(int n, float range) {
+  std::vector<float> v(n);
+  for (float &x : v) {
+    x = rand_float(range);
+  }
+  return v;
+}
+
+// reports the first sample off by more than `tol`, once per call.
+static void expect_close(const char *what, int n, const float *a, const float *b, int count, float tol) {
+  for (int i = 0; i < count; i++) {
+    if (!(fabsf(a[i] - b[i]) <= tol) || signbit(a[i]) != signbit(b[i])) {
+      fprintf(stderr, "%s, n=%d: sample %d is %.9g, reference %.9g\n", what, n, i, a[i], b[i]);
+      test_failures++;
+      return;
+    }
+  }
+}
+
+static void expect_equal(const char *what, int n, const int16_t *a, const int16_t *b, int count) {
+  for (int i = 0; i < count; i++) {
+    if (a[i] != b[i]) {
+      fprintf(stderr, "%s, n=%d: sample %d is %d, reference %d\n", what, n, i, a[i], b[i]);
+      test_failures++;
+      return;
+    }
+  }
+}
+
+// planar buffers of `channels` x `n`, with the pointer array kernels take.
+struct Planes {
+  std::vector<std::vector<float>> data;
+  std::vector<float *> ptrs;
+
+  Planes(int channels, int n, float range) {
+    for (int c = 0; c < channels; c++) {
+      data.push_back(random_floats(n, range));
+    }
+    for (std::vector<float> &plane : data) {
+      ptrs.push_back(plane.data());
+    }
+  }
+
+  const float *const *in() const {
+    return ptrs.data();
+  }
+};
+
+static void test_gain() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    std::vector<float> a = random_floats(n, 1.0f);
+    std::vector<float> b = a;
+    simd->gain(a.data(), 0.7f, n);
+    ref->gain(b.data(), 0.7f, n);
+    expect_close("gain", n, a.data(), b.data(), n, 0.0f);
+
+    a = random_floats(n, 1.0f);
+    b = a;
+    simd->gain_ramp(a.data(), 0.25f, 0.0123f, n);
+    ref->gain_ramp(b.data(), 0.25f, 0.0123f, n);
+    expect_close("gain_ramp", n, a.data(), b.data(), n, 1e-6f);
+  }
+}
+
+static void test_mix() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    for (int nb_src = 1; nb_src <= MAX_CH; nb_src++) {
+      Planes src(nb_src, n, 1.0f);
+      std::vector<float> gains = random_floats(nb_src, 1.0f);
+      std::vector<float> a(n), b(n);
+      simd->mix(a.data(), src.in(), gains.data(), nb_src, n);
+      ref->mix(b.data(), src.in(), gains.data(), nb_src, n);
+      expect_close("mix", n, a.data(), b.data(), n, 1e-5f);
+      // in place over the first source.
+      simd->mix(src.ptrs[0], src.in(), gains.data(), nb_src, n);
+      expect_close("mix in place", n, src.ptrs[0], b.data(), n, 1e-5f);
+    }
+  }
+}
+
+static void test_matrix() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    for (int out_ch = 1; out_ch <= MAX_CH; out_ch++) {
+      for (int in_ch = 1; in_ch <= MAX_CH; in_ch++) {
+        Planes src(in_ch, n, 1.0f);
+        std::vector<float> m = random_floats(out_ch * in_ch, 1.0f);
+        Planes a(out_ch, n, 0.0f);
+        Planes b(out_ch, n, 0.0f);
+        simd->matrix(a.ptrs.data(), src.in(), m.data(), out_ch, in_ch, n);
+        ref->matrix(b.ptrs.data(), src.in(), m.data(), out_ch, in_ch, n);
+        for (int o = 0; o < out_ch; o++) {
+          expect_close("matrix", n, a.ptrs[o], b.ptrs[o], n, 1e-5f);
+        }
+      }
+    }
+  }
+}
+
+static void test_dot() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    std::vector<float> a = random_floats(n, 1.0f);
+    std::vector<float> b = random_floats(n, 1.0f);
+    // summed in another order, so within a few ulps per term.
+    float x = simd->dot(a.data(), b.data(), n);
+    float y = ref->dot(a.data(), b.data(), n);
+    expect_close("dot", n, &x, &y, 1, 1e-6f * (float)(n + 1));
+  }
+}
+
+// both signs, zeros and samples right at the knee, well over full scale too.
+static void test_soft_clip() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    std::vector<float> a = random_floats(n, 4.0f);
+    for (int i = 0; i + 4 <= n; i += 9) {
+      a[i] = 0.0f;
+      a[i + 1] = -0.0f;
+      a[i + 2] = 0.8f;
+      a[i + 3] = -0.8f;
+    }
+    std::vector<float> b = a;
+    simd->soft_clip(a.data(), 0.8f, n);
+    ref->soft_clip(b.data(), 0.8f, n);
+    expect_close("soft_clip", n, a.data(), b.data(), n, 1e-6f);
+    for (int i = 0; i < n; i++) {
+      CHECK(fabsf(a[i]) < 1.0f);
+    }
+  }
+}
+
+static void test_s16() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    for (int channels = 1; channels <= MAX_CH; channels++) {
+      const int count = n * channels;
+      std::vector<int16_t> s16(count);
+      for (int16_t &s : s16) {
+        s = (int16_t)(rand() & 0xFFFF);
+      }
+      Planes a(channels, n, 0.0f);
+      Planes b(channels, n, 0.0f);
+      simd->s16_to_float_planar(a.ptrs.data(), s16.data(), channels, n);
+      ref->s16_to_float_planar(b.ptrs.data(), s16.data(), channels, n);
+      for (int c = 0; c < channels; c++) {
+        expect_close("s16_to_float_planar", n, a.ptrs[c], b.ptrs[c], n, 0.0f);
+      }
+
+      // past full scale on both sides, and ties: rounding and saturation must match exactly.
+      Planes src(channels, n, 1.5f);
+      for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < n; i += 5) {
+          src.ptrs[c][i] = (float)((rand() % 65536) - 32768) / 32768.0f + 0.5f / 32768.0f;
+        }
+      }
+      std::vector<int16_t> x(count), y(count);
+      simd->float_planar_to_s16(x.data(), src.in(), channels, n);
+      ref->float_planar_to_s16(y.data(), src.in(), channels, n);
+      expect_equal("float_planar_to_s16", n, x.data(), y.data(), count);
+    }
+  }
+}
+
+// the vector versions draw their noise from other lanes of the generator, so only its bounds are shared:
+// within 1 LSB of the plain conversion and saturated the same way.
+static void test_dither() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    for (int channels = 1; channels <= MAX_CH; channels++) {
+      const int count = n * channels;
+      Planes src(channels, n, 1.2f);
+      std::vector<int16_t> plain(count), x(count);
+      ref->float_planar_to_s16(plain.data(), src.in(), channels, n);
+      uint32_t seed = 12345;
+      simd->float_planar_to_s16_dither(x.data(), src.in(), channels, n, &seed);
+      for (int i = 0; i < count; i++) {
+        const float v = src.ptrs[i % channels][i / channels] * 32768.0f;
+        if (v >= 32768.0f || v < -32769.0f) {
+          CHECK_EQ(x[i], plain[i]);
+        } else {
+          CHECK(abs(x[i] - plain[i]) <= 1);
+        }
+      }
+      CHECK(n == 0 || seed != 12345);
+    }
+  }
+}
+
+// over a long run the noise is TPDF: zero mean, variance 1/6 + 1/12 for the rounding, and every
+// sample independent of its neighbours, the lanes of the vector generator included.
+static void test_dither_noise() {
+  const int n = 1 << 16;
+  for (int channels = 1; channels <= 2; channels++) {
+    Planes src(channels, n, 0.0f);
+    for (int c = 0; c < channels; c++) {
+      for (float &v : src.data[c]) {
+        v = 0.3f / 32768.0f;
+      }
+    }
+    std::vector<int16_t> x((size_t)n * channels);
+    uint32_t seed = 1;
+    simd->float_planar_to_s16_dither(x.data(), src.in(), channels, n, &seed);
+    double sum = 0.0, sq = 0.0;
+    for (size_t i = 0; i < x.size(); i++) {
+      const double e = x[i] - 0.3;
+      sum += e;
+      sq += e * e;
+    }
+    const double count = (double)x.size();
+    CHECK(fabs(sum / count) < 0.01);
+    CHECK(fabs(sq / count - 0.25) < 0.02);
+    for (int k = 1; k <= 8; k++) {
+      double corr = 0.0;
+      for (size_t i = k; i < x.size(); i++) {
+        corr += (x[i] - 0.3) * (x[i - k] - 0.3);
+      }
+      CHECK(fabs(corr / count) < 0.01);
+    }
+  }
+}
+
+static void test_interleave() {
+  for (int n = 0; n <= MAX_LEN; n++) {
+    for (int channels = 1; channels <= MAX_CH; channels++) {
+      const int count = n * channels;
+      Planes src(channels, n, 1.0f);
+      std::vector<float> a(count), b(count);
+      simd->interleave(a.data(), src.in(), channels, n);
+      ref->interleave(b.data(), src.in(), channels, n);
+      expect_close("interleave", n, a.data(), b.data(), count, 0.0f);
+
+      Planes x(channels, n, 0.0f);
+      Planes y(channels, n, 0.0f);
+      simd->deinterleave(x.ptrs.data(), a.data(), channels, n);
+      ref->deinterleave(y.ptrs.data(), a.data(), channels, n);
+      for (int c = 0; c < channels; c++) {
+        expect_close("deinterleave", n, x.ptrs[c], y.ptrs[c], n, 0.0f);
+        expect_close("deinterleave round trip", n, x.ptrs[c], src.ptrs[c], n, 0.0f);
+      }
+    }
+  }
+}
+
+int main() {
+  simd = pcm_dsp_get();
+  ref = pcm_dsp_get_c();
+  srand(26);
+  test_gain();
+  test_mix();
+  test_matrix();
+  test_dot();
+  test_soft_clip();
+  test_s16();
+  test_dither();
+  test_dither_noise();
+  test_interleave();
+  return test_result();
+}
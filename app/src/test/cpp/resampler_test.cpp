@@ -0,0 +1,68 @@
+#include "resampler.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// every converted stream has exactly ceil(in * out_rate / in_rate) samples, however the input is cut up.
+static void test_length() {
+  const int pairs[][2] = {{44100, 48000}, {48000, 44100}, {44100, 16000}, {48000, 24000},
+                          {16000, 48000}, {22050, 44100}, {48000, 32000}, {8000, 11025}};
+  const int lengths[] = {0, 1, 999, 44100, 100003};
+  for (const auto &pair : pairs) {
+    for (int quality = RESAMPLE_FAST; quality <= RESAMPLE_HIGH; quality++) {
+      for (int length : lengths) {
+        std::unique_ptr<Resampler> resampler = Resampler::create(pair[0], pair[1], 2, (ResampleQuality)quality);
+        CHECK(resampler != nullptr);
+        if (!resampler) {
+          continue;
+        }
+        std::vector<float> in(4096, 0.25f);
+        const float *planes[2] = {in.data(), in.data()};
+        int64_t out = 0;
+        srand(length);
+        for (int done = 0; done < length;) {
+          int n = std::min(length - done, 1 + rand() % 4096);
+          out += resampler->process(planes, n);
+          done += n;
+        }
+        out += resampler->flush();
+        const int64_t expect = ((int64_t)length * pair[1] + pair[0] - 1) / pair[0];
+        CHECK_EQ(out, expect);
+      }
+    }
+  }
+}
+
+// DC goes through at unity gain once the filter is past the start.
+static void test_dc_gain() {
+  std::unique_ptr<Resampler> resampler = Resampler::create(44100, 48000, 1, RESAMPLE_MEDIUM);
+  std::vector<float> in(44100, 0.5f);
+  const float *planes[1] = {in.data()};
+  std::vector<float> out;
+  int n = resampler->process(planes, (int)in.size());
+  out.insert(out.end(), resampler->output()[0], resampler->output()[0] + n);
+  n = resampler->flush();
+  out.insert(out.end(), resampler->output()[0], resampler->output()[0] + n);
+  CHECK_EQ(out.size(), 48000);
+  float worst = 0.0f;
+  for (size_t i = 1000; i + 1000 < out.size(); i++) {
+    worst = std::max(worst, fabsf(out[i] - 0.5f));
+  }
+  CHECK(worst < 1e-4f);
+}
+
+static void test_unsupported() {
+  // a reduced ratio with more phases than a bank holds.
+  CHECK(Resampler::create(44100, 47999, 2, RESAMPLE_MEDIUM) == nullptr);
+  CHECK(Resampler::create(0, 48000, 2, RESAMPLE_MEDIUM) == nullptr);
+}
+
+int main() {
+  test_length();
+  test_dc_gain();
+  test_unsupported();
+  return test_result();
+}
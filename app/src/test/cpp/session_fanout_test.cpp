@@ -0,0 +1,91 @@
+#include "session_fanout.h"
+#include "stub_session.h"
+#include "test.h"
+
+#include <memory>
+#include <vector>
+
+#define CHANNELS 2
+#define BLOCK 256
+
+// sample i of channel ch, so an output can be checked without keeping the input.
+static float sample(int64_t i, int ch) {
+  return (float)(i % 10007) + ch * 0.5f;
+}
+
+// `total` samples through a fan-out in blocks of uneven fill, the first `skip` of them dropped as a stage delay would.
+static std::vector<int> run(const std::vector<StubSession *> &stubs, int64_t total, int skip) {
+  std::vector<EncoderSession *> sessions(stubs.begin(), stubs.end());
+  SessionFanOut fanout(sessions, CHANNELS, BLOCK);
+  int64_t pos = 0;
+  for (int i = 0; pos < total; i++) {
+    std::shared_ptr<SessionFanOut::Block> block = fanout.acquire();
+    const int n = (int)std::min<int64_t>(total - pos, 1 + (i * 97) % BLOCK);
+    for (int ch = 0; ch < CHANNELS; ch++) {
+      for (int k = 0; k < n; k++) {
+        block->data[(size_t)ch * BLOCK + k] = sample(pos + k, ch);
+      }
+    }
+    const int drop = (int)std::min<int64_t>(std::max<int64_t>(skip - pos, 0), n);
+    if (fanout.write(block, drop, n - drop) < 0) {
+      break;
+    }
+    pos += n;
+  }
+  return fanout.finish();
+}
+
+static void check_samples(const StubSession &stub, int64_t skip, int64_t count) {
+  CHECK_EQ(stub.samples[0].size(), count);
+  int bad = 0;
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    for (size_t i = 0; i < stub.samples[ch].size(); i++) {
+      bad += stub.samples[ch][i] != sample(skip + (int64_t)i, ch);
+    }
+  }
+  CHECK_EQ(bad, 0);
+}
+
+static void test_single() {
+  StubSession stub(CHANNELS);
+  std::vector<int> results = run({&stub}, 100000, 300);
+  CHECK_EQ(results.size(), 1);
+  CHECK_EQ(results[0], 0);
+  CHECK(stub.finished);
+  check_samples(stub, 300, 100000 - 300);
+}
+
+// every session of a ladder gets the same samples in order, a failing one doesn't stop the rest.
+static void test_ladder() {
+  StubSession a(CHANNELS);
+  StubSession b(CHANNELS);
+  StubSession failing(CHANNELS, 5000);
+  StubSession c(CHANNELS);
+  std::vector<int> results = run({&a, &b, &failing, &c}, 200000, 0);
+  CHECK_EQ(results.size(), 4);
+  CHECK_EQ(results[0], 0);
+  CHECK_EQ(results[1], 0);
+  CHECK(results[2] < 0);
+  CHECK_EQ(results[3], 0);
+  CHECK(!failing.finished);
+  CHECK(failing.samples[0].size() <= 5000);
+  for (StubSession *stub : {&a, &b, &c}) {
+    CHECK(stub->finished);
+    check_samples(*stub, 0, 200000);
+  }
+}
+
+static void test_all_fail() {
+  StubSession a(CHANNELS, 0);
+  StubSession b(CHANNELS, 1000);
+  std::vector<int> results = run({&a, &b}, 50000, 0);
+  CHECK(results[0] < 0);
+  CHECK(results[1] < 0);
+}
+
+int main() {
+  test_single();
+  test_ladder();
+  test_all_fail();
+  return test_result();
+}
@@ -0,0 +1,16 @@
+#ifndef AUDIO_ENCODER_TEST_ANDROID_LOG_H
+#define AUDIO_ENCODER_TEST_ANDROID_LOG_H
+
+// host stand-in for the NDK header, base.h's LOG* macros end up in log_stub.cpp.
+
+enum {
+  ANDROID_LOG_DEBUG = 3,
+  ANDROID_LOG_INFO,
+  ANDROID_LOG_WARN,
+  ANDROID_LOG_ERROR,
+  ANDROID_LOG_FATAL,
+};
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt, ...);
+
+#endif //AUDIO_ENCODER_TEST_ANDROID_LOG_H
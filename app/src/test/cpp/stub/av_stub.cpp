@@ -0,0 +1,102 @@
+// The libavutil / libavformat functions the host-tested sources call, with
+// FFmpeg's semantics for the pure ones. There is no libavformat on the host:
+// open_audio_input() fails, so scan_file() reports unknown formats as errors.
+
+#include "probe_cache.h"
+
+#include <stdlib.h>
+#include <mutex>
+
+extern "C" {
+#include "libavutil/bswap.h"
+#include "libavutil/cpu.h"
+#include "libavutil/crc.h"
+#include "libavutil/error.h"
+#include "libavutil/mathematics.h"
+}
+
+// TEST_CPU_FLAGS masks what the host has, so a test can run the kernels of an older cpu.
+extern "C" int av_get_cpu_flags(void) {
+#if defined(__aarch64__)
+  int flags = AV_CPU_FLAG_NEON;
+#elif defined(__x86_64__)
+  int flags = AV_CPU_FLAG_SSE2 | (__builtin_cpu_supports("avx2") ? AV_CPU_FLAG_AVX2 : 0);
+#else
+  int flags = 0;
+#endif
+  const char *mask = getenv("TEST_CPU_FLAGS");
+  return mask ? flags & (int)strtol(mask, nullptr, 0) : flags;
+}
+
+// le, bits, poly of each AVCRCId, as in libavutil/crc.c.
+static const uint32_t crc_params[AV_CRC_MAX][3] = {
+    {0, 8, 0x07},
+    {0, 16, 0x8005},
+    {0, 16, 0x1021},
+    {0, 32, 0x04C11DB7},
+    {1, 32, 0xEDB88320},
+    {1, 16, 0xA001},
+    {0, 24, 0x864CFB},
+    {0, 8, 0x1D},
+};
+
+extern "C" const AVCRC *av_crc_get_table(AVCRCId crc_id) {
+  static AVCRC tables[AV_CRC_MAX][256];
+  static std::once_flag once;
+  std::call_once(once, [] {
+    for (int id = 0; id < AV_CRC_MAX; id++) {
+      const uint32_t le = crc_params[id][0];
+      const uint32_t bits = crc_params[id][1];
+      const uint32_t poly = crc_params[id][2];
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c;
+        if (le) {
+          c = i;
+          for (int j = 0; j < 8; j++) {
+            c = (c >> 1) ^ (poly & (-(c & 1)));
+          }
+        } else {
+          c = i << 24;
+          for (int j = 0; j < 8; j++) {
+            c = (c << 1) ^ ((poly << (32 - bits)) & (uint32_t)((int32_t)c >> 31));
+          }
+          c = av_bswap32(c);
+        }
+        tables[id][i] = c;
+      }
+    }
+  });
+  return crc_id >= 0 && crc_id < AV_CRC_MAX ? tables[crc_id] : nullptr;
+}
+
+extern "C" uint32_t av_crc(const AVCRC *ctx, uint32_t crc, const uint8_t *buffer, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    crc = ctx[(uint8_t)crc ^ buffer[i]] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+// rounded to nearest, halfway away from zero (AV_ROUND_NEAR_INF).
+extern "C" int64_t av_rescale(int64_t a, int64_t b, int64_t c) {
+  __int128 n = (__int128)a * b;
+  __int128 r = (n < 0 ? n - c / 2 : n + c / 2) / c;
+  return (int64_t)r;
+}
+
+extern "C" AVCodecParameters *avcodec_parameters_alloc(void) {
+  return (AVCodecParameters *)calloc(1, sizeof(AVCodecParameters));
+}
+
+extern "C" void avcodec_parameters_free(AVCodecParameters **par) {
+  free(*par);
+  *par = nullptr;
+}
+
+extern "C" void avformat_close_input(AVFormatContext **s) {
+  *s = nullptr;
+}
+
+int open_audio_input(const char * /*path*/, AVFormatContext ** /*ctx*/, int * /*stream_index*/,
+                     AVCodecParameters * /*par*/) {
+  return AVERROR_DEMUXER_NOT_FOUND;
+}
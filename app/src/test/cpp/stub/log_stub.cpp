@@ -0,0 +1,18 @@
+#include <android/log.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// warnings and errors only, the tests' own output stays readable.
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
+  if (prio < ANDROID_LOG_WARN) {
+    return 0;
+  }
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "%s: ", tag);
+  int n = vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+  return n;
+}
@@ -0,0 +1,55 @@
+#ifndef AUDIO_ENCODER_TEST_STUB_SESSION_H
+#define AUDIO_ENCODER_TEST_STUB_SESSION_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "encoder_session.h"
+
+/**
+ * Host backend of EncoderSession: keeps what it is fed instead of encoding it,
+ * so the code around the sessions runs without a codec. `fail_after` samples
+ * into the stream write() fails, -1 never.
+ */
+class StubSession : public EncoderSession {
+ public:
+  explicit StubSession(int channels, int64_t fail_after = -1)
+      : samples(channels), fail_after_(fail_after) {
+  }
+
+  std::string describe() const override {
+    return "stub";
+  }
+
+  int open(const char * /*path*/) override {
+    opened = true;
+    return 0;
+  }
+
+  int write(const float *const *planes, int nb_samples) override {
+    if (fail_after_ >= 0 && (int64_t)samples[0].size() + nb_samples > fail_after_) {
+      return -1;
+    }
+    for (size_t ch = 0; ch < samples.size(); ch++) {
+      samples[ch].insert(samples[ch].end(), planes[ch], planes[ch] + nb_samples);
+    }
+    writes++;
+    return 0;
+  }
+
+  int finish() override {
+    finished = true;
+    return 0;
+  }
+
+  // per channel, everything written so far.
+  std::vector<std::vector<float>> samples;
+  int writes = 0;
+  bool opened = false;
+  bool finished = false;
+
+ private:
+  int64_t fail_after_;
+};
+
+#endif //AUDIO_ENCODER_TEST_STUB_SESSION_H
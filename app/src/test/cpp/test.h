@@ -0,0 +1,35 @@
+#ifndef AUDIO_ENCODER_TEST_TEST_H
+#define AUDIO_ENCODER_TEST_TEST_H
+
+#include <stdio.h>
+
+// one test program per source file: checks count failures and go on, main() returns test_result().
+
+static int test_failures = 0;
+
+#define CHECK(cond)                                                              \
+  do {                                                                           \
+    if (!(cond)) {                                                               \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);   \
+      test_failures++;                                                           \
+    }                                                                            \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                                           \
+  do {                                                                                           \
+    long long va_ = (long long)(a);                                                              \
+    long long vb_ = (long long)(b);                                                              \
+    if (va_ != vb_) {                                                                            \
+      fprintf(stderr, "%s:%d: %s == %s failed: %lld vs %lld\n", __FILE__, __LINE__, #a, #b, va_, vb_); \
+      test_failures++;                                                                           \
+    }                                                                                            \
+  } while (0)
+
+static inline int test_result() {
+  if (test_failures) {
+    fprintf(stderr, "%d check(s) failed\n", test_failures);
+  }
+  return test_failures ? 1 : 0;
+}
+
+#endif //AUDIO_ENCODER_TEST_TEST_H